@@ -428,9 +428,11 @@ public:
 			node->getParents().push_back(g);
 			g->getChildren().push_back(node);
 			
-			// Add the rest of the children as dependers
+			// Add the rest of the children as dependers, leaving out the
+			// ones not being built (when building a single module).
 			for(size_t i=1; i<gate->getChildren()->size(); ++i) {
 				DFT::Nodes::Node* node = dft->getNode(gate->getChildren()->at(i)->getString());
+				if(!node) continue;
 				g->getDependers().push_back(node);
 				node->getTriggers().push_back(g);
 			}
@@ -28,6 +28,15 @@ namespace DFT {
 class ASTPrinter: public DFT::ASTVisitor<int,true> {
 private:
 	FileWriter out;
+
+	/**
+	 * Returns the location of the specified node, as printed after it.
+	 * Printing the locations allows comparing the ASTs produced by
+	 * the different parsers.
+	 */
+	static std::string location(DFT::AST::ASTNode* node) {
+		return " @" + node->getLocation().toString();
+	}
 public:
 
 	/**
@@ -62,7 +71,7 @@ public:
 	virtual int visitTopLevel(DFT::AST::ASTTopLevel* topLevel) {
 		int valid = true;
 		
-		out << out.applyprefix << "TopLevel \"" << topLevel->getTopNode()->getString() << "\"" << out.applypostfix;
+		out << out.applyprefix << "TopLevel \"" << topLevel->getTopNode()->getString() << "\"" << location(topLevel) << location(topLevel->getTopNode()) << out.applypostfix;
 		
 		valid = ASTVisitor<int,true>::visitTopLevel(topLevel) ? valid : false ;
 		
@@ -71,7 +80,7 @@ public:
 	virtual int visitBasicEvent(DFT::AST::ASTBasicEvent* basicEvent) {
 		int valid = true;
 		
-		out << out.applyprefix << "BasicEvent \"" << basicEvent->getName()->getString() << "\"" << out.applypostfix;
+		out << out.applyprefix << "BasicEvent \"" << basicEvent->getName()->getString() << "\"" << location(basicEvent) << location(basicEvent->getName()) << out.applypostfix;
 		out.indent();
 		valid = ASTVisitor<int,true>::visitBasicEvent(basicEvent) ? valid : false ;
 		out.outdent();
@@ -81,8 +90,11 @@ public:
 	virtual int visitGate(DFT::AST::ASTGate* gate) {
 		int valid = true;
 		
-		out << out.applyprefix << "Gate[" << gate->getGateType()->getString() << "] \"" << gate->getName()->getString() << "\"" << out.applypostfix;
+		out << out.applyprefix << "Gate[" << gate->getGateType()->getString() << "] \"" << gate->getName()->getString() << "\"" << location(gate) << location(gate->getName()) << location(gate->getGateType()) << out.applypostfix;
 		out.indent();
+		for(DFT::AST::ASTIdentifier* child: *gate->getChildren()) {
+			out << out.applyprefix << "\"" << child->getString() << "\"" << location(child) << out.applypostfix;
+		}
 		valid = ASTVisitor<int,true>::visitGate(gate) ? valid : false ;
 		out.outdent();
 		
@@ -109,7 +121,7 @@ public:
 
 		out << out.applyprefix << attribute->getString() << " = ";
 		valid = ASTVisitor<int,true>::visitAttrib(value) ? valid : false;
-		out << out.applypostfix;
+		out << location(attribute) << location(value) << out.applypostfix;
 
 		switch(attribute->getLabel()) {
 			case DFT::Nodes::BE::AttrLabelLambda:
@@ -139,7 +151,7 @@ public:
 	}
 	virtual int visitAttribFloat(DFT::AST::ASTAttribFloat* af) {
 		int valid = true;
-		out << af->getValue() << " (float)";
+		out << af->getValue() << " (float: " << af->origString << ")";
 		valid = ASTVisitor<int,true>::visitAttribFloat(af) ? valid : false;
 		return valid;
 	}
@@ -0,0 +1,93 @@
+/*
+ * Arena.cpp
+ *
+ * Part of dft2lnt library - a library containing read/write operations for DFT
+ * files in Galileo format and translating DFT specifications into Lotos NT.
+ *
+ * @author Enno Ruijters
+ */
+
+#include "Arena.h"
+#include <new>
+
+/* Every allocation is preceded by the arena it belongs to (NULL for the
+ * heap), padded to keep the node aligned.
+ */
+static const size_t HEADER = alignof(std::max_align_t);
+
+static thread_local DFT::Arena::Scope *currentScope = nullptr;
+
+static size_t roundUp(size_t size)
+{
+	return (size + HEADER - 1) / HEADER * HEADER;
+}
+
+DFT::Arena::Scope::Scope(Arena &arena)
+	:arena(&arena), outer(currentScope), next(nullptr), end(nullptr)
+{
+	currentScope = this;
+}
+
+DFT::Arena::Scope::~Scope()
+{
+	currentScope = outer;
+}
+
+char *DFT::Arena::newBlock(size_t size)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	blocks.emplace_back(new char[size]);
+	return blocks.back().get();
+}
+
+void DFT::Arena::adopt(Arena &other)
+{
+	std::lock(lock, other.lock);
+	std::lock_guard<std::mutex> guard(lock, std::adopt_lock);
+	std::lock_guard<std::mutex> otherGuard(other.lock, std::adopt_lock);
+	for (std::unique_ptr<char[]> &block : other.blocks)
+		blocks.push_back(std::move(block));
+	other.blocks.clear();
+}
+
+DFT::Arena *DFT::Arena::getCurrent()
+{
+	return currentScope ? currentScope->arena : nullptr;
+}
+
+void *DFT::Arena::allocate(size_t size)
+{
+	size = HEADER + roundUp(size);
+	Scope *scope = currentScope;
+	char *ret;
+	if (!scope) {
+		ret = static_cast<char *>(::operator new(size));
+		*reinterpret_cast<Arena **>(ret) = nullptr;
+		return ret + HEADER;
+	}
+	if ((size_t)(scope->end - scope->next) < size) {
+		/* Large nodes get a block of their own, so the current
+		 * block is not wasted.
+		 */
+		if (size > BLOCK_SIZE / 4) {
+			ret = scope->arena->newBlock(size);
+			*reinterpret_cast<Arena **>(ret) = scope->arena;
+			return ret + HEADER;
+		}
+		scope->next = scope->arena->newBlock(BLOCK_SIZE);
+		scope->end = scope->next + BLOCK_SIZE;
+	}
+	ret = scope->next;
+	scope->next += size;
+	*reinterpret_cast<Arena **>(ret) = scope->arena;
+	return ret + HEADER;
+}
+
+void DFT::Arena::deallocate(void *p)
+{
+	if (!p)
+		return;
+	char *start = static_cast<char *>(p) - HEADER;
+	if (!*reinterpret_cast<Arena **>(start))
+		::operator delete(start);
+}
@@ -0,0 +1,95 @@
+/*
+ * Arena.h
+ *
+ * Part of dft2lnt library - a library containing read/write operations for DFT
+ * files in Galileo format and translating DFT specifications into Lotos NT.
+ *
+ * @author Enno Ruijters
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace DFT {
+
+/**
+ * Monotonic allocator for the AST and DFT nodes, which are allocated in
+ * their millions for large DFTs. Nodes are allocated one after the
+ * other in large blocks, and the blocks are all released at once when
+ * the arena is destroyed. Deleting a node runs its destructor, but only
+ * returns its memory to the heap if it was not allocated in an arena.
+ *
+ * The classes using the arena allocate through allocate() and
+ * deallocate(), which use the arena of the innermost Scope of the
+ * calling thread, or the heap outside of any Scope. Every node
+ * allocated in an arena must be deleted (or abandoned) before the arena
+ * is destroyed.
+ */
+class Arena {
+public:
+	/**
+	 * Makes the calling thread allocate nodes in an arena until the
+	 * Scope is destroyed. Scopes of several threads may use the same
+	 * arena concurrently, each taking its own blocks.
+	 */
+	class Scope {
+	private:
+		Arena *arena;
+		Scope *outer;
+		char *next, *end;
+		friend class Arena;
+	public:
+		Scope(Arena &arena);
+		~Scope();
+
+		Scope(const Scope &) = delete;
+		Scope &operator=(const Scope &) = delete;
+	};
+
+private:
+	static const size_t BLOCK_SIZE = 1 << 20;
+
+	std::mutex lock;
+	std::vector<std::unique_ptr<char[]>> blocks;
+
+	char *newBlock(size_t size);
+
+public:
+	Arena() {}
+
+	Arena(const Arena &) = delete;
+	Arena &operator=(const Arena &) = delete;
+
+	/**
+	 * Takes over the blocks of another arena, so its nodes live as long
+	 * as this arena. No Scope may be using the other arena.
+	 */
+	void adopt(Arena &other);
+
+	/**
+	 * Returns the arena of the innermost Scope of the calling thread,
+	 * or NULL if there is none.
+	 */
+	static Arena *getCurrent();
+
+	/**
+	 * Allocates memory for a node of the specified size, in the
+	 * current arena if there is one.
+	 */
+	static void *allocate(size_t size);
+
+	/**
+	 * Frees the memory of a node allocated by allocate(), unless it
+	 * belongs to an arena.
+	 */
+	static void deallocate(void *p);
+};
+
+} // Namespace: DFT
+
+#endif // ARENA_H
@@ -8,6 +8,7 @@
  */
 
 #include "DFTree.h"
+#include "DFTreeGraph.h"
 #include "dftnodes/nodes.h"
 #include <unordered_set>
 
@@ -34,7 +35,10 @@ namespace DFT {
 	}
 
 	void DFTree::replaceSEQs() {
-		for (Nodes::Node *node : nodes) {
+		/* Copy, as the SANDs are added to nodes */
+		const std::vector<Nodes::Node *> current = nodes;
+		std::unordered_set<Nodes::Node *> replaced;
+		for (Nodes::Node *node : current) {
 			if (!node->matchesType(Nodes::GateSeqType))
 				continue;
 			Nodes::GateSeq *seq = static_cast<DFT::Nodes::GateSeq *>(node);
@@ -64,28 +68,178 @@ namespace DFT {
 				
 				// Point all the SEQ's parents to the SAND
 				for(Nodes::Gate* parent: seq->getParents()) {
-					// Add the parent to the OR-node's parents
-					seq->getParents().push_back(parent);
+					// Add the parent to the SAND's parents
+					sand->getParents().push_back(parent);
 					vector<Nodes::Node *> &pcs = parent->getChildren();
 					for (size_t i = 0; i < pcs.size(); i++) {
 						if (pcs[i] == seq)
 							pcs[i] = sand;
 					}
 				}
-				// Remove the original SEQ node
-				removeNode(seq);
 
 				// Replace the top node if necessary.
 				if (getTopNode() == seq)
-					setTopNode(sand);
+					setTopNode_(sand);
+
+				// Remove the original SEQ node (below)
+				replaced.insert(seq);
 			}
 		}
-		return;
+		removeNodes(replaced);
 	}
 
-	void DFTree::removeUnreachable(void) {
+	void DFTree::addRepairInfo() {
+		for (Nodes::Node *node : nodes) {
+			if (node->repairsChildren())
+				node->setChildRepairs();
+		}
+		if (!topNode || !topNode->isGate())
+			return;
+
+		DFTreeGraph graph(*this);
+		std::vector<size_t> below = graph.postOrder(graph.getTop());
+
+		/* A gate below the Top Node with a repairable basic event as
+		 * child makes all its ancestors repairable (also those not
+		 * below the Top Node).
+		 */
+		std::vector<bool> marked(graph.size());
+		std::vector<size_t> queue;
+		for (size_t id : below) {
+			if (!graph.getNode(id)->isGate())
+				continue;
+			for (size_t c : graph.getChildren(id)) {
+				Nodes::Node *child = graph.getNode(c);
+				if (child->isBasicEvent() && child->isRepairable()) {
+					marked[id] = true;
+					queue.push_back(id);
+					break;
+				}
+			}
+		}
+		while (!queue.empty()) {
+			size_t id = queue.back();
+			queue.pop_back();
+			graph.getNode(id)->setRepairable(true);
+			for (size_t p : graph.getParents(id)) {
+				if (!marked[p]) {
+					marked[p] = true;
+					queue.push_back(p);
+				}
+			}
+		}
+
+		/* And a gate below the Top Node is repairable if any of its
+		 * children is a repairable gate (e.g., repaired by a repair
+		 * unit); children come first in the post-order.
+		 */
+		for (size_t id : below) {
+			Nodes::Node *node = graph.getNode(id);
+			if (!node->isGate())
+				continue;
+			for (size_t c : graph.getChildren(id)) {
+				Nodes::Node *child = graph.getNode(c);
+				if (child->isGate() && child->isRepairable()) {
+					node->setRepairable(true);
+					break;
+				}
+			}
+		}
+	}
+
+	/* Inspections/repair should certainly not activate their children. */
+	static bool activatesChildren(Nodes::Node *node) {
+		return !(node->matchesType(Nodes::RepairUnitType)
+		         || node->matchesType(Nodes::RepairUnitFcfsType)
+		         || node->matchesType(Nodes::RepairUnitPrioType)
+		         || node->matchesType(Nodes::RepairUnitNdType)
+		         || node->matchesType(Nodes::InspectionType)
+		         || node->matchesType(Nodes::ReplacementType));
+	}
+
+	void DFTree::addAlwaysActiveInfo() {
+		DFTreeGraph graph(*this);
+		size_t n = graph.size();
+		std::vector<bool> isChild(n);
+		for (size_t id = 0; id < n; id++) {
+			Nodes::Node *node = graph.getNode(id);
+			if (!node->isGate() || node->matchesType(Nodes::InspectionType))
+				continue;
+			for (size_t c : graph.getChildren(id))
+				isChild[c] = true;
+		}
+
+		std::vector<bool> visited(n);
+		std::vector<size_t> stack;
+		for (size_t id = 0; id < n; id++) {
+			if (!isChild[id]) {
+				visited[id] = true;
+				stack.push_back(id);
+			}
+		}
+		while (!stack.empty()) {
+			size_t id = stack.back();
+			stack.pop_back();
+			Nodes::Node *node = graph.getNode(id);
+			node->setAlwaysActive(true);
+			if (!node->isGate() || !activatesChildren(node))
+				continue;
+			DFTreeGraph::Range children = graph.getChildren(id);
+			size_t count = children.size();
+			/* Of SPAREs, only the primary is always-active.
+			 * Of FDEPs, avoid activating non-trigger children.
+			 * Of PANDs, only the first child is always-active.
+			 */
+			if (node->matchesType(Nodes::GateSpareType)
+			    || node->matchesType(Nodes::GateFDEPType)
+			    || node->matchesType(Nodes::GateSAndType))
+			{
+				count = std::min(count, (size_t)1);
+			}
+			for (size_t i = 0; i < count; i++) {
+				size_t c = children.begin()[i];
+				if (!visited[c]) {
+					visited[c] = true;
+					stack.push_back(c);
+				}
+			}
+		}
+	}
+
+	void DFTree::checkFDEPInfo() {
+		if (!topNode || !topNode->isGate())
+			return;
+		DFTreeGraph graph(*this);
+		std::vector<bool> visited(graph.size());
+		std::vector<size_t> stack;
+		std::vector<Nodes::Gate *> gates;
+		if (graph.getTop() != DFTreeGraph::NONE) {
+			visited[graph.getTop()] = true;
+			stack.push_back(graph.getTop());
+		}
+		while (!stack.empty()) {
+			size_t id = stack.back();
+			stack.pop_back();
+			gates.push_back(static_cast<Nodes::Gate *>(graph.getNode(id)));
+			for (size_t c : graph.getChildren(id)) {
+				Nodes::Node *child = graph.getNode(c);
+				if (!child->isGate() || child->outputIsDumb() || visited[c])
+					continue;
+				visited[c] = true;
+				stack.push_back(c);
+			}
+		}
+		for (Nodes::Gate *gate : gates) {
+			std::vector<Nodes::Node *> &children = gate->getChildren();
+			children.erase(std::remove_if(children.begin(), children.end(),
+				[](Nodes::Node *c) { return c->isGate() && c->outputIsDumb(); }),
+				children.end());
+		}
+	}
+
+	std::unordered_set<Nodes::Node *> DFTree::getReachable(Nodes::Node *top) {
 		std::unordered_set<Nodes::Node *> to_explore, reachable;
-		to_explore.insert(topNode);
+		to_explore.insert(top);
 		while (to_explore.size() != 0) {
 			Nodes::Node *current = *to_explore.begin();
 			to_explore.erase(current);
@@ -97,25 +251,74 @@ namespace DFT {
 						to_explore.insert(c);
 				}
 			}
-			if (current == topNode)
+			if (current == top)
 				continue;
 			for (Nodes::Node *par : current->getParents()) {
 				if (reachable.find(par) == reachable.end())
 					to_explore.insert(par);
 			}
-			for (Nodes::Node *node : nodes) {
-				if (!node->matchesType(Nodes::GateFDEPType))
-					continue;
-				Nodes::GateFDEP *f = static_cast<Nodes::GateFDEP *>(node);
-				if (reachable.find(f) != reachable.end())
-					continue;
-				for (Nodes::Node *dep : f->getDependers()) {
-					if (dep == current)
-						to_explore.insert(f);
-				}
+			for (Nodes::GateFDEP *f : current->getTriggers()) {
+				if (reachable.find(f) == reachable.end())
+					to_explore.insert(f);
+			}
+		}
+		return reachable;
+	}
+
+	void DFTree::unindexNode(Nodes::Node *node) {
+		auto it = nodeTable.find(node->getName());
+		if (it == nodeTable.end() || it->second != node)
+			return;
+		nodeTable.erase(it);
+		for (Nodes::Node *n : nodes) {
+			if (n->getName() == node->getName()) {
+				nodeTable.emplace(n->getName(), n);
+				break;
+			}
+		}
+	}
+
+	void DFTree::removeNodes(const std::unordered_set<Nodes::Node *> &remove) {
+		if (remove.empty())
+			return;
+		auto removed = [&](Nodes::Node *n) { return remove.count(n) != 0; };
+		std::vector<Nodes::Node *> keep;
+		keep.reserve(nodes.size());
+		for (Nodes::Node *node : nodes) {
+			if (removed(node))
+				continue;
+			keep.push_back(node);
+			if (node->isGate()) {
+				Nodes::Gate *gate = static_cast<Nodes::Gate *>(node);
+				std::vector<Nodes::Node *> &children = gate->getChildren();
+				children.erase(std::remove_if(children.begin(),
+				                              children.end(), removed),
+				               children.end());
+			}
+			std::vector<Nodes::Gate *> &parents = node->getParents();
+			parents.erase(std::remove_if(parents.begin(), parents.end(),
+			                             removed),
+			              parents.end());
+		}
+		nodes.swap(keep);
+		bool unindexed = false;
+		for (Nodes::Node *node : remove) {
+			auto it = nodeTable.find(node->getName());
+			if (it != nodeTable.end() && it->second == node) {
+				nodeTable.erase(it);
+				unindexed = true;
 			}
+			delete node;
+		}
+		/* Other nodes of the same names take their place */
+		if (unindexed) {
+			for (Nodes::Node *node : nodes)
+				nodeTable.emplace(node->getName(), node);
 		}
-		std::unordered_set<Nodes::Node *> to_remove;
+	}
+
+	void DFTree::removeUnreachable(void) {
+		std::unordered_set<Nodes::Node *> reachable = getReachable(topNode);
 		for (Nodes::Node *node : reachable) {
 			if (!node->matchesType(Nodes::GateFDEPType))
 				continue;
@@ -127,12 +330,11 @@ namespace DFT {
 			}
 			f->getDependers().swap(keep);
 		}
+		std::unordered_set<Nodes::Node *> unreachable;
 		for (Nodes::Node *node : nodes) {
-			if (reachable.find(node) == reachable.end()) {
-				to_remove.insert(node);
-			}
+			if (reachable.find(node) == reachable.end())
+				unreachable.insert(node);
 		}
-		for (Nodes::Node *node : to_remove)
-			removeNode(node);
+		removeNodes(unreachable);
 	}
 }
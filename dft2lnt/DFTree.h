@@ -18,6 +18,8 @@ class DFTree;
 #include <vector>
 #include <map>
 #include <set>
+#include <unordered_map>
+#include <unordered_set>
 #include <iostream>
 #include <assert.h>
 #include "dftnodes/nodes.h"
@@ -37,8 +39,9 @@ private:
 	/// The nodes of the DFT
 	std::vector<Nodes::Node*> nodes;
 	
-	/// The mapping from name (e.g. "A") to a Node
-	std::map<std::string,DFT::Nodes::Node*> nodeTable;
+	/// The mapping from name (e.g. "A") to a Node, the first one in
+	/// nodes if several have the same name
+	std::unordered_map<std::string,DFT::Nodes::Node*> nodeTable;
 	
 	/// The Top (root) Node of the DFT
 	Nodes::Node* topNode;
@@ -51,6 +54,20 @@ private:
 		return 0;
 	}
 	
+	/**
+	 * Removes a node that is no longer in nodes from nodeTable, where
+	 * another node of the same name (e.g., one replacing it) takes its
+	 * place.
+	 */
+	void unindexNode(Nodes::Node* node);
+
+	/**
+	 * Removes (and frees) the specified nodes, and all references to
+	 * them from the remaining nodes, as removeNode() for each of them
+	 * but in a single pass over the DFT.
+	 */
+	void removeNodes(const std::unordered_set<Nodes::Node*>& remove);
+
 	DFTree(const DFTree& d) {
 	}
 	
@@ -76,6 +93,7 @@ public:
 	 */
 	void addNode(Nodes::Node* node) {
 		nodes.push_back(node);
+		nodeTable.emplace(node->getName(), node);
 	}
 	
 	/**
@@ -106,6 +124,7 @@ public:
 		// Remove the node from the DFT
 		vector<DFT::Nodes::Node*>::iterator it = std::remove(nodes.begin(),nodes.end(),node);
 		nodes.resize(it-nodes.begin());
+		unindexNode(node);
 		
 		// Delete the node
 		delete node;
@@ -120,12 +139,8 @@ public:
 	 * @return The Node associated with the specified name.
 	 */
 	Nodes::Node* getNode(const std::string& name) {
-		for(size_t i=0; i<nodes.size(); ++i) {
-			if(nodes.at(i)->getName()==name) {
-				return nodes.at(i);
-			}
-		}
-		return NULL;
+		std::unordered_map<std::string,DFT::Nodes::Node*>::const_iterator it = nodeTable.find(name);
+		return it == nodeTable.end() ? NULL : it->second;
 	}
 
 	/**
@@ -169,16 +184,32 @@ public:
 		return topNode;
 	}
 
+	/**
+	 * Returns the nodes needed to analyse the subtree below the specified
+	 * node: its descendants, the other parents of those descendants, and
+	 * the FDEPs triggering any of these.
+	 * @param top The root of the subtree.
+	 * @return The nodes of the subtree, including top itself.
+	 */
+	std::unordered_set<Nodes::Node *> getReachable(Nodes::Node *top);
+
+	/**
+	 * Removes (and frees) all nodes not needed to analyse the subtree
+	 * of the Top Node (see getReachable()). Takes time linear in the
+	 * size of the DFT, however many nodes are removed.
+	 */
 	void removeUnreachable(void);
 
 	/**
 	 * Translates this DFTree so that all FDEP nodes are removed and Or nodes
 	 * are inserted, such that the meaning of the DFTree is unaltered.
+	 * The FDEP nodes are removed together at the end.
 	 */
 	void transformFDEPNodes() {
 		
 		// Copy the current list of nodes
 		const auto nodes = this->nodes;
+		std::unordered_set<Nodes::Node*> fdeps;
 		
 		// Loop over all the nodes in the DFT
 		for(DFT::Nodes::Node* node: nodes) {
@@ -249,10 +280,11 @@ public:
 					gate->addChild(fdep->getEventSource());
 				}
 				
-				// Remove the original FDEP node
-				removeNode(node);
+				// Remove the original FDEP node (below)
+				fdeps.insert(node);
 			}
 		}
+		removeNodes(fdeps);
 	}
 	
 	/**
@@ -260,13 +292,17 @@ public:
 	 * by the list of names, will be marked as failed. This means that they
 	 * will fail immediately (at t=0).
 	 * @param evidence List of names of basic events that will fail at t=0
+	 * @param partial Whether to ignore names of nodes that are not in
+	 *        this DFT, e.g. basic events outside a module.
 	 * @throw std::vector<std::string> List of error messages
 	 */
-	void applyEvidence(std::vector<std::string>& evidence) {
+	void applyEvidence(const std::vector<std::string>& evidence, bool partial = false) {
 		std::vector<std::string> errors;
-		for(std::string& nodeName: evidence) {
+		for(const std::string& nodeName: evidence) {
 			DFT::Nodes::Node* node = getNode(nodeName);
-			if(node) {
+			if(!node && partial) {
+				continue;
+			} else if(node) {
 				if(node->isBasicEvent()) {
 					DFT::Nodes::BasicEvent* be = static_cast<DFT::Nodes::BasicEvent*>(node);
 					be->setFailed(true);
@@ -283,162 +319,35 @@ public:
 	}
 
 	/**
-	 * Apply repair information to a gates
-	 * @param Gate to apply information on
+	 * Replaces SEQ gates whose children are all independent basic
+	 * events by SAND gates with cold children.
 	 */
-	void addRepairInfo(DFT::Nodes::Gate* gate) {
-		gate->setRepairable(true);
-		for(size_t n = 0; n<gate->getParents().size(); ++n) {
-			DFT::Nodes::Node* parent = gate->getParents().at(n);
-			if(parent->isGate()){
-				DFT::Nodes::Gate* p = static_cast<DFT::Nodes::Gate*>(parent);
-				addRepairInfo(p);
-			}
-		}
-	}
-
 	void replaceSEQs();
 
 	/**
-	 * Find repair information
-	 * @param Gate to start
-	 */
-	void findRepairInfo(DFT::Nodes::Gate* gate) {
-		for(size_t n = 0; n<gate->getChildren().size(); ++n) {
-			// Get the current child and associated childID
-			DFT::Nodes::Node* child = gate->getChildren().at(n);
-			if(child->isBasicEvent()) {
-				const DFT::Nodes::BasicEvent* be = static_cast<const DFT::Nodes::BasicEvent*>(child);
-				if(be->isRepairable()){
-					addRepairInfo(gate);
-				}
-			}else if(child->isGate()) {
-				DFT::Nodes::Gate* g = static_cast<DFT::Nodes::Gate*>(child);
-				findRepairInfo(g);
-				if(child->isRepairable())
-					gate->setRepairable(true);
-			}
-		}
-	}
-
-
-	/**
-	 * Apply repair information to all gates
+	 * Apply repair information to all gates: a gate is repairable if
+	 * it is the ancestor of a repairable basic event below the Top
+	 * Node. Takes time linear in the size of the DFT.
 	 */
-	void addRepairInfo() {
-		for (size_t i = 0; i < nodes.size(); i++) {
-			if (nodes.at(i)->repairsChildren()) {
-				nodes.at(i)->setChildRepairs();
-			}
-		}
-
-		DFT::Nodes::Node* node=getTopNode();
-		if(node->isGate()){
-			DFT::Nodes::Gate* gate = static_cast<DFT::Nodes::Gate*>(node);
-			findRepairInfo(gate);
-		}
-	}
+	void addRepairInfo();
 
-	/**
-	 * Set this gate to be always active, and apply to children as
-	 * needed.
-	 */
-	void addAlwaysActiveInfo(DFT::Nodes::Gate *gate)
-	{
-		if (gate->matchesType(DFT::Nodes::RepairUnitType)
-			|| gate->matchesType(DFT::Nodes::RepairUnitFcfsType)
-			|| gate->matchesType(DFT::Nodes::RepairUnitPrioType)
-			|| gate->matchesType(DFT::Nodes::RepairUnitNdType)
-			|| gate->matchesType(DFT::Nodes::InspectionType)
-			|| gate->matchesType(DFT::Nodes::ReplacementType))
-		{
-			/* Inspections/repair should certainly not
-			 * activate their children.
-			 */
-			return;
-		}
-
-		size_t n = gate->getChildren().size();
-		if (DFT::Nodes::Node::typeMatch(gate->getType(), DFT::Nodes::GateSpareType))
-			n = 1; /* Of SPAREs, only the primary is always-active. */
-		if (DFT::Nodes::Node::typeMatch(gate->getType(), DFT::Nodes::GateFDEPType))
-			n = 1; /* Of FDEPs, avoid activating non-trigger children. */
-		if (DFT::Nodes::Node::typeMatch(gate->getType(), DFT::Nodes::GateSAndType))
-			n = 1; /* Of PANDs, only the first child is always-active. */
-
-
-		while (n-- > 0) {
-			// Get the current child and associated childID
-			DFT::Nodes::Node *child = gate->getChildren().at(n);
-			child->setAlwaysActive(true);
-			if(child->isGate()) {
-				DFT::Nodes::Gate *g = static_cast<DFT::Nodes::Gate*>(child);
-				addAlwaysActiveInfo(g);
-			}
-		}
-	}
 	/**
 	 * Apply information about always-active gates (Smart Semantics) to
 	 * entire tree.
 	 * Basic concept: All root nodes are always-active, as are all
 	 * nodes reachable from an always-active node without traversing
 	 * a dynamically-activating node (i.e., SPARE or SAND).
+	 * Takes time linear in the size of the DFT.
 	 */
-	void addAlwaysActiveInfo()
-	{
-		std::set<Nodes::Node *> roots;
-		for (auto node : nodes)
-			roots.insert(node);
-		for (auto node : nodes) {
-			if (!node->isGate())
-				continue;
-			Nodes::Gate *gate = static_cast<Nodes::Gate*>(node);
-			if (gate->matchesType(DFT::Nodes::InspectionType))
-				continue;
-			for (auto child : gate->getChildren())
-				roots.erase(child);
-		}
-		for (auto root : roots) {
-			root->setAlwaysActive(true);
-			if (root->isGate()) {
-				Nodes::Gate *gate = static_cast<Nodes::Gate*>(root);
-				addAlwaysActiveInfo(gate);
-			}
-		}
-	}
-    
-    /**
-     * Find FDEP information
-     * @param Gate to start
-     */
-    void findFDEPInfo(DFT::Nodes::Gate* gate) {
-        for(size_t n = 0; n<gate->getChildren().size(); ++n) {
-            // Get the current child and associated childID
-            DFT::Nodes::Node* child = gate->getChildren().at(n);
-            if(child->isGate()) {
-                DFT::Nodes::Gate* g = static_cast<DFT::Nodes::Gate*>(child);
-                if(child->outputIsDumb()) {
-                    gate->delChild(n);
-                    n--;
-                }else{
-                    findFDEPInfo(g);
-                }
-            }
-        }
-    }
+	void addAlwaysActiveInfo();
+
+	/**
+	 * Apply FDEP checks: removes the gates with dumb outputs (e.g.,
+	 * FDEPs) from the children of the gates below the Top Node.
+	 * Takes time linear in the size of the DFT.
+	 */
+	void checkFDEPInfo();
 
-    
-    /**
-     * Apply FDEP checks
-     */
-    void checkFDEPInfo() {
-        DFT::Nodes::Node* node=getTopNode();
-        if(node->isGate()){
-            DFT::Nodes::Gate* gate = static_cast<DFT::Nodes::Gate*>(node);
-            findFDEPInfo(gate);
-        }
-    }
-    
 };
 } // Namespace: DFT
 
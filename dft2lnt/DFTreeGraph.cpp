@@ -0,0 +1,71 @@
+/*
+ * DFTreeGraph.cpp
+ *
+ * Part of dft2lnt library - a library containing read/write operations for DFT
+ * files in Galileo format and translating DFT specifications into Lotos NT.
+ *
+ * @author Enno Ruijters
+ */
+
+#include "DFTreeGraph.h"
+#include "DFTree.h"
+
+DFT::DFTreeGraph::DFTreeGraph(DFTree &dft)
+	:nodes(dft.getNodes()), top(NONE)
+{
+	size_t n = nodes.size();
+	ids.reserve(n);
+	for (size_t i = 0; i < n; i++)
+		ids.emplace(nodes[i], i);
+	if (dft.getTopNode())
+		top = getId(dft.getTopNode());
+
+	childStart.reserve(n + 1);
+	parentStart.reserve(n + 1);
+	for (size_t i = 0; i < n; i++) {
+		childStart.push_back(childIds.size());
+		if (nodes[i]->isGate()) {
+			Nodes::Gate *gate = static_cast<Nodes::Gate*>(nodes[i]);
+			for (Nodes::Node *child : gate->getChildren()) {
+				size_t c = getId(child);
+				if (c != NONE)
+					childIds.push_back(c);
+			}
+		}
+		parentStart.push_back(parentIds.size());
+		for (Nodes::Gate *parent : nodes[i]->getParents()) {
+			size_t p = getId(parent);
+			if (p != NONE)
+				parentIds.push_back(p);
+		}
+	}
+	childStart.push_back(childIds.size());
+	parentStart.push_back(parentIds.size());
+}
+
+std::vector<size_t> DFT::DFTreeGraph::postOrder(size_t root) const
+{
+	std::vector<size_t> ret;
+	if (root == NONE)
+		return ret;
+	std::vector<bool> visited(nodes.size());
+	/* Each entry is a node and the number of its children pushed so far */
+	std::vector<std::pair<size_t, size_t>> stack;
+	stack.emplace_back(root, 0);
+	visited[root] = true;
+	while (!stack.empty()) {
+		size_t id = stack.back().first;
+		Range children = getChildren(id);
+		if (stack.back().second == children.size()) {
+			ret.push_back(id);
+			stack.pop_back();
+			continue;
+		}
+		size_t child = children.begin()[stack.back().second++];
+		if (!visited[child]) {
+			visited[child] = true;
+			stack.emplace_back(child, 0);
+		}
+	}
+	return ret;
+}
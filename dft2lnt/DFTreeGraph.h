@@ -0,0 +1,113 @@
+/*
+ * DFTreeGraph.h
+ *
+ * Part of dft2lnt library - a library containing read/write operations for DFT
+ * files in Galileo format and translating DFT specifications into Lotos NT.
+ *
+ * @author Enno Ruijters
+ */
+
+#ifndef DFTREEGRAPH_H
+#define DFTREEGRAPH_H
+
+#include <unordered_map>
+#include <vector>
+#include <stddef.h>
+#include "dftnodes/nodes.h"
+
+namespace DFT {
+
+class DFTree;
+
+/**
+ * Compact, read-only view of the structure of a DFTree, for passes that
+ * traverse the whole DFT. Every node has an integer id (its index in
+ * DFTree::getNodes()), and the children and parents of all nodes are
+ * stored contiguously in compressed sparse row form: the children of node
+ * i are childIds[childStart[i]] up to childIds[childStart[i + 1]], and
+ * likewise for the parents.
+ * Children and parents that are not in the DFTree are left out.
+ * The view is invalidated by any change to the structure of the DFTree.
+ */
+class DFTreeGraph {
+public:
+	/// The id of no node
+	static const size_t NONE = (size_t)-1;
+
+	/**
+	 * A range of node ids, usable in range-based for loops.
+	 */
+	class Range {
+	private:
+		const size_t *first, *last;
+	public:
+		Range(const size_t *first, const size_t *last): first(first), last(last) {}
+		const size_t *begin() const { return first; }
+		const size_t *end() const { return last; }
+		size_t size() const { return last - first; }
+	};
+
+private:
+	std::vector<Nodes::Node*> nodes;
+	std::unordered_map<const Nodes::Node*, size_t> ids;
+	std::vector<size_t> childStart, childIds;
+	std::vector<size_t> parentStart, parentIds;
+	size_t top;
+
+public:
+	/**
+	 * Builds the view of the specified DFT, in time linear in its size.
+	 */
+	DFTreeGraph(DFTree &dft);
+
+	/**
+	 * Returns the number of nodes.
+	 */
+	size_t size() const { return nodes.size(); }
+
+	/**
+	 * Returns the node with the specified id.
+	 */
+	Nodes::Node *getNode(size_t id) const { return nodes[id]; }
+
+	/**
+	 * Returns the id of the specified node, or NONE if it is not in
+	 * the DFT.
+	 */
+	size_t getId(const Nodes::Node *node) const {
+		auto it = ids.find(node);
+		return it == ids.end() ? NONE : it->second;
+	}
+
+	/**
+	 * Returns the id of the Top Node, or NONE if there is none.
+	 */
+	size_t getTop() const { return top; }
+
+	/**
+	 * Returns the ids of the children of a node, in order.
+	 */
+	Range getChildren(size_t id) const {
+		return Range(childIds.data() + childStart[id],
+		             childIds.data() + childStart[id + 1]);
+	}
+
+	/**
+	 * Returns the ids of the parents of a node.
+	 */
+	Range getParents(size_t id) const {
+		return Range(parentIds.data() + parentStart[id],
+		             parentIds.data() + parentStart[id + 1]);
+	}
+
+	/**
+	 * Returns the ids of the nodes reachable from the specified node
+	 * through children (including itself), each after all of its
+	 * children. Takes time linear in the size of the DFT.
+	 */
+	std::vector<size_t> postOrder(size_t root) const;
+};
+
+} // Namespace: DFT
+
+#endif // DFTREEGRAPH_H
@@ -0,0 +1,165 @@
+/*
+ * DFTreeHasher.cpp
+ *
+ * Part of dft2lnt library - a library containing read/write operations for DFT
+ * files in Galileo format and translating DFT specifications into Lotos NT.
+ *
+ * @author Enno Ruijters
+ */
+
+#include "DFTreeHasher.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <stdint.h>
+#include <vector>
+#include "dftnodes/nodes.h"
+
+/* 64-bit FNV-1a, since the hashes must be stable across builds and
+ * platforms (which std::hash does not guarantee).
+ */
+static std::string fnv1a(const std::string &data)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (unsigned char c : data) {
+		hash ^= c;
+		hash *= 0x100000001b3ULL;
+	}
+	std::stringstream ss;
+	ss << std::hex << std::setw(16) << std::setfill('0') << hash;
+	return ss.str();
+}
+
+/* Writes the attributes of a node, everything except its name and edges.
+ * Doubles are written in hexadecimal, so distinct values never encode
+ * the same.
+ */
+static void encodeAttributes(const DFT::Nodes::Node *node, std::ostream &out)
+{
+	out << std::hexfloat;
+	out << node->getType() << ' ' << node->getTypeStr()
+	    << (node->isRepairable() ? " r" : "")
+	    << (node->isAlwaysActive() ? " a" : "");
+	if (node->isBasicEvent()) {
+		const DFT::Nodes::BasicEvent *be;
+		be = static_cast<const DFT::Nodes::BasicEvent *>(node);
+		out << ' ' << DFT::Nodes::BE::getCalculationModeStr(be->getMode())
+		    << " l" << be->getLambda().str()
+		    << " p" << be->getProb().str()
+		    << " d" << be->getDorm().str()
+		    << " res" << be->getRes().str()
+		    << " m" << be->getMaintain()
+		    << " rep" << be->getRepair()
+		    << " prio" << be->getPriority()
+		    << " i" << be->getInterval()
+		    << " ph" << be->getPhases()
+		    << (be->getFailed() ? " failed" : "");
+		if (!be->getFileToEmbed().empty())
+			out << " f" << be->getFileToEmbed().size() << ':' << be->getFileToEmbed();
+	} else if (node->matchesType(DFT::Nodes::InspectionType)) {
+		const DFT::Nodes::Inspection *i;
+		i = static_cast<const DFT::Nodes::Inspection *>(node);
+		out << " l" << i->getLambda().str();
+	} else if (node->matchesType(DFT::Nodes::ReplacementType)) {
+		const DFT::Nodes::Replacement *r;
+		r = static_cast<const DFT::Nodes::Replacement *>(node);
+		out << " l" << r->getLambda()
+		    << " ph" << r->getPhases();
+	}
+}
+
+/* The nodes a node refers to besides its children */
+static const std::vector<DFT::Nodes::Node *> *getDependers(const DFT::Nodes::Node *node)
+{
+	if (node->matchesType(DFT::Nodes::GateFDEPType))
+		return &static_cast<const DFT::Nodes::GateFDEP *>(node)->getDependers();
+	if (node->matchesType(DFT::Nodes::RepairUnitAnyType))
+		return &static_cast<const DFT::Nodes::RepairUnit *>(node)->getDependers();
+	if (node->matchesType(DFT::Nodes::ReplacementType))
+		return &static_cast<const DFT::Nodes::Replacement *>(node)->getDependers();
+	return nullptr;
+}
+
+bool DFT::DFTreeHasher::isIndependent(DFT::Nodes::Node *node)
+{
+	return node->getParents().size() == 1 && modules.isIndependent(node);
+}
+
+void DFT::DFTreeHasher::encode(DFT::Nodes::Node *node, DFT::Nodes::Node *root,
+                               std::unordered_map<const DFT::Nodes::Node *, size_t> &visited,
+                               std::string &out)
+{
+	auto seen = visited.find(node);
+	if (seen != visited.end()) {
+		out += "@" + std::to_string(seen->second) + ";";
+		return;
+	}
+	/* Nothing else in this subtree refers to the nodes of an
+	 * independent subtree below it, so it can be referred to by hash.
+	 */
+	if (node != root && isIndependent(node)) {
+		out += "#" + getHash(node) + ";";
+		return;
+	}
+	size_t id = visited.size();
+	visited[node] = id;
+
+	std::stringstream attributes;
+	encodeAttributes(node, attributes);
+	out += "(" + attributes.str();
+
+	if (node->isGate()) {
+		const std::vector<DFT::Nodes::Node *> &children
+			= static_cast<DFT::Nodes::Gate *>(node)->getChildren();
+		out += " c" + std::to_string(children.size()) + ":";
+		bool commutative = node->matchesType(DFT::Nodes::GateAndType)
+		                   || node->matchesType(DFT::Nodes::GateOrType)
+		                   || node->matchesType(DFT::Nodes::GateVotingType);
+		for (DFT::Nodes::Node *child : children) {
+			if (!isIndependent(child))
+				commutative = false;
+		}
+		if (commutative) {
+			std::vector<std::string> childHashes;
+			for (DFT::Nodes::Node *child : children)
+				childHashes.push_back(getHash(child));
+			std::sort(childHashes.begin(), childHashes.end());
+			for (const std::string &h : childHashes)
+				out += "#" + h + ";";
+		} else {
+			for (DFT::Nodes::Node *child : children)
+				encode(child, root, visited, out);
+		}
+	}
+	const std::vector<DFT::Nodes::Node *> *dependers = getDependers(node);
+	if (dependers) {
+		out += " d" + std::to_string(dependers->size()) + ":";
+		for (DFT::Nodes::Node *dep : *dependers)
+			encode(dep, root, visited, out);
+	}
+	out += " t" + std::to_string(node->getTriggers().size()) + ":";
+	/* Within an independent subtree, the parents and triggers of every
+	 * node except the root are part of the subtree as well (e.g.,
+	 * repair units and FDEPs).
+	 */
+	if (node != root) {
+		for (DFT::Nodes::Node *trigger : node->getTriggers())
+			encode(trigger, root, visited, out);
+		out += " p" + std::to_string(node->getParents().size()) + ":";
+		for (DFT::Nodes::Node *parent : node->getParents())
+			encode(parent, root, visited, out);
+	}
+	out += ")";
+}
+
+const std::string &DFT::DFTreeHasher::getHash(DFT::Nodes::Node *root)
+{
+	auto known = hashes.find(root);
+	if (known != hashes.end())
+		return known->second;
+	std::unordered_map<const DFT::Nodes::Node *, size_t> visited;
+	std::string encoding;
+	encode(root, root, visited, encoding);
+	return hashes[root] = fnv1a(encoding);
+}
@@ -0,0 +1,67 @@
+/*
+ * DFTreeHasher.h
+ *
+ * Part of dft2lnt library - a library containing read/write operations for DFT
+ * files in Galileo format and translating DFT specifications into Lotos NT.
+ *
+ * @author Enno Ruijters
+ */
+
+namespace DFT {
+class DFTreeHasher;
+}
+
+#ifndef DFTREEHASHER_H
+#define DFTREEHASHER_H
+
+#include <string>
+#include <unordered_map>
+#include "DFTree.h"
+#include "DFTreeModules.h"
+
+namespace DFT {
+
+/**
+ * Calculates structural hashes of independent subtrees of a DFT. The hash
+ * covers the types of the nodes, the order and arity of their children,
+ * the parameters of basic events and the other attributes of the nodes,
+ * but not their names. Independent subtrees with the same hash thus have
+ * the same failure behaviour (barring hash collisions), even if they are
+ * in different DFTs, so their results only need to be calculated once.
+ *
+ * The children of AND, OR and voting gates are sorted, so reordering them
+ * does not change the hash. Other edges are followed in the order of the
+ * DFT, with nodes shared within the subtree referred to by the order in
+ * which they are first reached.
+ */
+class DFTreeHasher {
+private:
+	/// Hashes of the independent subtrees encountered so far
+	std::unordered_map<const DFT::Nodes::Node *, std::string> hashes;
+	/// The independent subtrees of the DFT
+	const DFTreeModules &modules;
+
+	void encode(DFT::Nodes::Node *node, DFT::Nodes::Node *root,
+	            std::unordered_map<const DFT::Nodes::Node *, size_t> &visited,
+	            std::string &out);
+	bool isIndependent(DFT::Nodes::Node *node);
+
+public:
+	/**
+	 * Hashes subtrees of the DFT whose independent subtrees are the
+	 * specified ones.
+	 */
+	DFTreeHasher(const DFTreeModules &modules): modules(modules) {}
+
+	/**
+	 * Returns the structural hash of the subtree below the specified
+	 * node, which should be an independent subtree (see
+	 * DFTreeModules).
+	 * @return The hash, as 16 hexadecimal digits.
+	 */
+	const std::string &getHash(DFT::Nodes::Node *root);
+};
+
+} // Namespace: DFT
+
+#endif // DFTREEHASHER_H
@@ -0,0 +1,196 @@
+/*
+ * DFTreeModules.cpp
+ *
+ * Part of dft2lnt library - a library containing read/write operations for DFT
+ * files in Galileo format and translating DFT specifications into Lotos NT.
+ *
+ * @author Enno Ruijters
+ */
+
+#include "DFTreeModules.h"
+#include "DFTree.h"
+#include <algorithm>
+
+static const size_t NONE = DFT::DFTreeGraph::NONE;
+
+DFT::DFTreeModules::DFTreeModules(DFTree &dft)
+	:graph(dft)
+{
+	size_t n = graph.size();
+
+	/* Collect the edges in both directions, as the parents and
+	 * triggers of a node need not mirror the children and dependers
+	 * of its gates exactly.
+	 */
+	std::vector<std::pair<size_t, size_t>> edges;
+	auto addEdge = [&](size_t a, const Nodes::Node *other) {
+		size_t b = graph.getId(other);
+		if (b == NONE || b == a)
+			return;
+		edges.emplace_back(a, b);
+		edges.emplace_back(b, a);
+	};
+	for (size_t id = 0; id < n; id++) {
+		Nodes::Node *node = graph.getNode(id);
+		for (size_t c : graph.getChildren(id)) {
+			edges.emplace_back(id, c);
+			edges.emplace_back(c, id);
+		}
+		for (size_t p : graph.getParents(id)) {
+			edges.emplace_back(id, p);
+			edges.emplace_back(p, id);
+		}
+		if (node->matchesType(Nodes::GateFDEPType)) {
+			Nodes::GateFDEP *f = static_cast<Nodes::GateFDEP *>(node);
+			for (Nodes::Node *dep : f->getDependers())
+				addEdge(id, dep);
+		}
+		for (Nodes::GateFDEP *f : node->getTriggers())
+			addEdge(id, f);
+	}
+
+	/* Bucket the edges by node, leaving out duplicates */
+	std::vector<size_t> count(n + 1, 0);
+	for (const auto &e : edges)
+		count[e.first + 1]++;
+	for (size_t id = 0; id < n; id++)
+		count[id + 1] += count[id];
+	std::vector<size_t> bucketed(edges.size());
+	for (const auto &e : edges)
+		bucketed[count[e.first]++] = e.second;
+	std::vector<size_t> seen(n, NONE);
+	adjStart.reserve(n + 1);
+	size_t from = 0;
+	for (size_t id = 0; id < n; id++) {
+		adjStart.push_back(adj.size());
+		for (; from < count[id]; from++) {
+			size_t other = bucketed[from];
+			if (other != id && seen[other] != id) {
+				seen[other] = id;
+				adj.push_back(other);
+			}
+		}
+	}
+	adjStart.push_back(adj.size());
+
+	order.assign(n, NONE);
+	below.assign(n, 1);
+	low.assign(n, NONE);
+	visitedFrom.assign(n, NONE);
+	part.assign(n, NONE);
+	visited.reserve(n);
+	/* Start from the Top Node, so the subtrees below it are visited
+	 * from their parents.
+	 */
+	if (graph.getTop() != NONE)
+		search(graph.getTop());
+	for (size_t id = 0; id < n; id++) {
+		if (order[id] == NONE)
+			search(id);
+	}
+
+	independent.assign(n, false);
+	for (size_t id = 0; id < n; id++) {
+		Nodes::Node *node = graph.getNode(id);
+		if (node->getParents().empty()) {
+			independent[id] = true;
+			continue;
+		}
+		if (node->getParents().size() > 1)
+			continue;
+		size_t p = graph.getId(node->getParents()[0]);
+		if (p == NONE)
+			independent[id] = true;
+		else if (visitedFrom[id] == p)
+			independent[id] = low[id] > order[p];
+		else if (visitedFrom[p] == id)
+			independent[id] = low[p] > order[id];
+	}
+}
+
+void DFT::DFTreeModules::search(size_t start)
+{
+	/* Each entry is a node and the number of its neighbours tried */
+	std::vector<std::pair<size_t, size_t>> stack;
+	order[start] = low[start] = visited.size();
+	visited.push_back(start);
+	part[start] = start;
+	stack.emplace_back(start, adjStart[start]);
+	while (!stack.empty()) {
+		size_t id = stack.back().first;
+		if (stack.back().second == adjStart[id + 1]) {
+			stack.pop_back();
+			size_t from = visitedFrom[id];
+			if (from != NONE) {
+				below[from] += below[id];
+				low[from] = std::min(low[from], low[id]);
+			}
+			continue;
+		}
+		size_t next = adj[stack.back().second++];
+		if (order[next] == NONE) {
+			order[next] = low[next] = visited.size();
+			visited.push_back(next);
+			visitedFrom[next] = id;
+			part[next] = start;
+			stack.emplace_back(next, adjStart[next]);
+		} else if (next != visitedFrom[id]) {
+			low[id] = std::min(low[id], order[next]);
+		}
+	}
+}
+
+bool DFT::DFTreeModules::isIndependent(const Nodes::Node *node) const
+{
+	size_t id = graph.getId(node);
+	return id != NONE && independent[id];
+}
+
+void DFT::DFTreeModules::getRange(size_t id, size_t &first, size_t &last,
+                                  size_t &excludeFirst, size_t &excludeLast) const
+{
+	excludeFirst = excludeLast = 0;
+	size_t p = NONE;
+	if (graph.getNode(id)->getParents().size() == 1)
+		p = graph.getId(graph.getNode(id)->getParents()[0]);
+	if (p != NONE && visitedFrom[p] == id) {
+		/* Visited from below, so the subtree is everything in its
+		 * connected part except what was visited from the parent.
+		 */
+		size_t start = part[id];
+		first = order[start];
+		last = first + below[start];
+		excludeFirst = order[p];
+		excludeLast = excludeFirst + below[p];
+	} else if (p != NONE) {
+		first = order[id];
+		last = first + below[id];
+	} else {
+		size_t start = part[id];
+		first = order[start];
+		last = first + below[start];
+	}
+}
+
+DFT::DFTreeModules::Count
+DFT::DFTreeModules::count(const std::function<bool(const Nodes::Node *)> &property) const
+{
+	Count ret;
+	ret.modules = this;
+	ret.before.reserve(visited.size() + 1);
+	ret.before.push_back(0);
+	for (size_t id : visited)
+		ret.before.push_back(ret.before.back() + property(graph.getNode(id)));
+	return ret;
+}
+
+size_t DFT::DFTreeModules::Count::in(const Nodes::Node *root) const
+{
+	size_t id = modules->graph.getId(root);
+	if (id == NONE)
+		return 0;
+	size_t first, last, excludeFirst, excludeLast;
+	modules->getRange(id, first, last, excludeFirst, excludeLast);
+	return before[last] - before[first]
+	       - (before[excludeLast] - before[excludeFirst]);
+}
@@ -0,0 +1,104 @@
+/*
+ * DFTreeModules.h
+ *
+ * Part of dft2lnt library - a library containing read/write operations for DFT
+ * files in Galileo format and translating DFT specifications into Lotos NT.
+ *
+ * @author Enno Ruijters
+ */
+
+#ifndef DFTREEMODULES_H
+#define DFTREEMODULES_H
+
+#include <functional>
+#include <vector>
+#include "DFTreeGraph.h"
+
+namespace DFT {
+
+/**
+ * Finds the independent subtrees (modules) of a DFT, all at once in time
+ * linear in the size of the DFT.
+ *
+ * A node is an independent subtree if it has no parents, or if it has
+ * exactly one parent and the nodes connected to it without passing
+ * through its parent (via parent/child relationships and FDEP
+ * dependencies, in either direction) do not include the parent. These
+ * nodes make up the subtree. Shared spares are children of all their
+ * spare gates, so they are covered by the parent/child relationships.
+ *
+ * As in the algorithm of Dutuit and Rauzy, this follows from the visit
+ * times of a single depth-first search: the edge between a node and its
+ * only parent must be a bridge, i.e., no node visited below the one
+ * endpoint has an edge to a node visited before it.
+ */
+class DFTreeModules {
+public:
+	/**
+	 * The number of nodes with some property in each independent
+	 * subtree, see count().
+	 */
+	class Count {
+	private:
+		const DFTreeModules *modules;
+		/// The number of nodes with the property before each position
+		/// in the visiting order
+		std::vector<size_t> before;
+		friend class DFTreeModules;
+	public:
+		/**
+		 * Returns the number of nodes with the property in the
+		 * subtree of the specified independent subtree.
+		 */
+		size_t in(const Nodes::Node *root) const;
+	};
+
+private:
+	DFTreeGraph graph;
+	/// The neighbours of each node, in compressed sparse row form
+	std::vector<size_t> adjStart, adj;
+	/// The position of each node in the visiting order
+	std::vector<size_t> order;
+	/// The node at each position of the visiting order
+	std::vector<size_t> visited;
+	/// The number of nodes visited from each node (including itself)
+	std::vector<size_t> below;
+	/// The earliest position in the visiting order reachable from the
+	/// nodes visited from each node by a single non-tree edge
+	std::vector<size_t> low;
+	/// The node each node was visited from (NONE for the first node of
+	/// each connected part)
+	std::vector<size_t> visitedFrom;
+	/// The first node visited in the connected part of each node
+	std::vector<size_t> part;
+	/// Whether each node is an independent subtree
+	std::vector<bool> independent;
+
+	void search(size_t start);
+
+	/**
+	 * Returns the range of positions in the visiting order of the
+	 * subtree of an independent node with one parent, without the
+	 * range of positions to exclude from it.
+	 */
+	void getRange(size_t id, size_t &first, size_t &last,
+	              size_t &excludeFirst, size_t &excludeLast) const;
+
+public:
+	DFTreeModules(DFTree &dft);
+
+	/**
+	 * Returns whether the specified node is an independent subtree.
+	 */
+	bool isIndependent(const Nodes::Node *node) const;
+
+	/**
+	 * Counts the nodes with the specified property, so that the number
+	 * in any independent subtree can be found in constant time.
+	 */
+	Count count(const std::function<bool(const Nodes::Node *)> &property) const;
+};
+
+} // Namespace: DFT
+
+#endif // DFTREEMODULES_H
@@ -9,6 +9,7 @@
 
 #include "DFTreeValidator.h"
 #include "dft2lnt.h"
+#include <unordered_set>
 
 DFT::DFTreeValidator::DFTreeValidator(DFT::DFTree* dft, CompilerContext* cc):
 	dft(dft),
@@ -25,14 +26,10 @@ int DFT::DFTreeValidator::validateReferences() {
 		assert(nodes.at(i));
 		nodes.at(i)->addReferencesTo(notDefinedButReferencedNodes);
 	}
-	for(size_t i=0; i<nodes.size();++i) {
-		//std::remove(notDefinedButReferencedNodes.begin(),notDefinedButReferencedNodes.end(),nodes.at(i));
-		for(;;) {
-			std::vector<Nodes::Node*>::iterator it = std::find(notDefinedButReferencedNodes.begin(),notDefinedButReferencedNodes.end(),nodes.at(i));
-			if(it == notDefinedButReferencedNodes.end()) break;
-			notDefinedButReferencedNodes.erase(it);
-		}
-	}
+	std::unordered_set<Nodes::Node*> defined(nodes.begin(),nodes.end());
+	std::vector<Nodes::Node*>::iterator end = std::remove_if(notDefinedButReferencedNodes.begin(),notDefinedButReferencedNodes.end(),
+		[&](Nodes::Node* n) { return defined.count(n) > 0; });
+	notDefinedButReferencedNodes.erase(end,notDefinedButReferencedNodes.end());
 	
 	for(std::vector<Nodes::Node*>::iterator i = notDefinedButReferencedNodes.begin(); i != notDefinedButReferencedNodes.end(); i++) {
 		cc->reportErrorAt((*i)->getLocation(),"node " + ((*i)->getName()) + " references inexistent node");
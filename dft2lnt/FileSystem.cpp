@@ -280,6 +280,13 @@ time_t FileSystem::getLastStatusChangeTime(const File& file) {
 	return fileStat.st_ctime;
 }
 
+uint64_t FileSystem::getFileSize(const File& file) {
+	struct stat fileStat;
+	if (stat(file.getFileRealPath().c_str(),&fileStat))
+		return 0;
+	return fileStat.st_size;
+}
+
 bool FileSystem::canCreateOrModify(const File& file) {
 	if(hasAccessTo(file,W_OK)) return true;
 	if(!exists(file) && hasAccessTo(File(file.getPathTo()),W_OK|X_OK)) return true;
@@ -12,6 +12,7 @@ class File;
 #define FILESYSTEM_H
 
 #include <limits.h>
+#include <stdint.h>
 #include <vector>
 #include <string>
 
@@ -46,6 +47,11 @@ public:
 	static time_t getLastAccessTime(const File& file);
 	static time_t getLastModificationTime(const File& file);
 	static time_t getLastStatusChangeTime(const File& file);
+
+	/**
+	 * Returns the size of the file in bytes, or 0 if it does not exist.
+	 */
+	static uint64_t getFileSize(const File& file);
 	
 	static bool canCreateOrModify(const File& file);
 	static bool hasAccessTo(const File& file, int mode);
@@ -88,11 +88,13 @@ void MessageFormatter::print(const Location& loc, const std::string& str, const
 
 
 void MessageFormatter::reportErrorAt(Location loc, const std::string& str, const int& verbosityLevel) {
+	std::lock_guard<std::recursive_mutex> guard(lock);
 	messageAt(loc,str,MessageType::Error,verbosityLevel);
 	errors++;
 }
 
 void MessageFormatter::reportWarningAt(Location loc, const std::string& str, const int& verbosityLevel) {
+	std::lock_guard<std::recursive_mutex> guard(lock);
 	messageAt(loc,str,MessageType::Warning,verbosityLevel);
 	warnings++;
 }
@@ -110,11 +112,13 @@ void MessageFormatter::reportAction3At(Location loc, const std::string& str, con
 }
 
 void MessageFormatter::reportError(const std::string& str, const int& verbosityLevel) {
+	std::lock_guard<std::recursive_mutex> guard(lock);
 	message(str,MessageType::Error,verbosityLevel);
 	errors++;
 }
 
 void MessageFormatter::reportWarning(const std::string& str, const int& verbosityLevel) {
+	std::lock_guard<std::recursive_mutex> guard(lock);
 	message(str,MessageType::Warning,verbosityLevel);
 	warnings++;
 }
@@ -158,6 +162,7 @@ void MessageFormatter::message(const std::string& str, const MessageType& mType,
 
 
 void MessageFormatter::messageAt(Location loc, const std::string& str, const MessageType& mType, const int& verbosityLevel) {
+	std::lock_guard<std::recursive_mutex> guard(lock);
 	static int n=1;
 
 	if(verbosityLevel>verbosity && !mType.isError() && !mType.isWarning()) {
@@ -202,6 +207,7 @@ void MessageFormatter::reportErrors(const int& verbosityLevel) {
 }
 
 void MessageFormatter::flush() {
+	std::lock_guard<std::recursive_mutex> guard(lock);
 	std::set<MSG>::iterator it = messages.begin();
 	for(;it!=messages.end(); ++it) {
 		print(it->loc,it->message,it->type);
@@ -12,6 +12,7 @@
 #include "dft_parser_location.h"
 #include "ConsoleWriter.h"
 #include <set>
+#include <mutex>
 
 class MessageFormatter {
 public:
@@ -116,6 +117,8 @@ private:
 	unsigned int warnings;
 	bool m_autoFlush;
 	int verbosity;
+	/// Serializes messages reported from concurrently running jobs
+	std::recursive_mutex lock;
 	void print(const Location& l, const std::string& str, const MessageType& mType);
 public:
 
@@ -11,6 +11,16 @@
 # define WIN32_LEAN_AND_MEAN // Omit rarely-used and architecture-specific stuff from WIN32
 # include <windows.h>
 # include <iostream>
+#else
+# include <spawn.h>
+# include <poll.h>
+# include <fcntl.h>
+# include <errno.h>
+# include <unistd.h>
+# include <sys/wait.h>
+# include <sys/resource.h>
+# include <mutex>
+extern char **environ;
 #endif
 
 MessageFormatter* Shell::messageFormatter = NULL;
@@ -143,9 +153,11 @@ int Shell::system(const SystemOptions& options, RunStatistics* stats) {
 		}
 	}
 	
-	// Obtain the real path of the specified cwd and enter it
+	// Obtain the real path of the specified cwd and let the shell enter it,
+	// leaving the working directory of this process (and of any other
+	// thread running commands) untouched
 	string realCWD = FileSystem::getRealPath(options.cwd);
-	PushD dir(realCWD);
+	command = "cd \"" + realCWD + "\" && " + command;
 	if(messageFormatter) messageFormatter->reportAction("Entering directory: `" + realCWD + "'", options.verbosity);
 
 	// Execute the command
@@ -179,8 +191,6 @@ int Shell::system(const SystemOptions& options, RunStatistics* stats) {
 		}
 	}
 	
-	// Leave the cwd
-	dir.popd();
 	if(messageFormatter) messageFormatter->reportAction("Exiting directory: `" + realCWD + "'", options.verbosity);
 	
 	if(removeTmpFile && FileSystem::exists(statFile))
@@ -194,6 +204,279 @@ int Shell::system(const SystemOptions& options, RunStatistics* stats) {
 	// Return the result of the command
 	return result;
 }
+
+/* Adds output of a command to its capture, moving it to the output file
+ * once it grows beyond the spill limit.
+ */
+static void capture(Shell::Capture* cap, std::ofstream& spill,
+                    const std::string& file, size_t limit,
+                    const char* data, size_t len) {
+	if(cap->spilled) {
+		spill.write(data, len);
+		return;
+	}
+	cap->contents.append(data, len);
+	if(cap->contents.length() > limit && !file.empty()) {
+		spill.open(file, std::ios::binary | std::ios::trunc);
+		if(!spill.is_open())
+			return;
+		spill.write(cap->contents.c_str(), cap->contents.length());
+		cap->contents.clear();
+		cap->spilled = true;
+	}
+}
+
+/* Reads all currently available data from a non-blocking pipe.
+ * Returns false once the pipe is closed.
+ */
+static bool readPipe(int fd, Shell::Capture* cap, std::ofstream& spill,
+                     const std::string& file, size_t limit) {
+	char buffer[65536];
+	while(true) {
+		ssize_t n = read(fd, buffer, sizeof(buffer));
+		if(n > 0) {
+			capture(cap, spill, file, limit, buffer, n);
+		} else if(n < 0 && errno == EINTR) {
+			continue;
+		} else {
+			return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+		}
+	}
+}
+
+/* Creates a pipe whose ends are close-on-exec from the start, so that no
+ * command started concurrently from another thread (including through
+ * system(), which does not take spawnLock) inherits the write end and
+ * keeps the pipe open.
+ */
+static int openPipe(int fds[2]) {
+#ifdef __APPLE__
+	/* No pipe2(), so there is a small window before the ends are
+	 * marked, which spawnLock only closes for other spawn() calls.
+	 */
+	if(pipe(fds))
+		return -1;
+	fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+	fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+	return 0;
+#else
+	return pipe2(fds, O_CLOEXEC);
+#endif
+}
+
+/* Pipes are created and the child spawned under this lock, see
+ * openPipe().
+ */
+static std::mutex spawnLock;
+
+int Shell::spawn(const SystemOptions& options, Capture* out, Capture* err, RunStatistics* stats) {
+	std::string command = '"' + options.command + '"';
+	std::vector<char*> argv;
+	argv.push_back(const_cast<char*>(options.command.c_str()));
+	for(const std::string& argument : options.arguments) {
+		command += " \"" + argument + "\"";
+		argv.push_back(const_cast<char*>(argument.c_str()));
+	}
+	argv.push_back(NULL);
+
+	string realCWD = FileSystem::getRealPath(options.cwd);
+	if(messageFormatter) messageFormatter->reportAction("Entering directory: `" + realCWD + "'", options.verbosity);
+	if(messageFormatter) messageFormatter->reportAction("Executing: " + command, options.verbosity);
+
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+#if defined(__APPLE__) || (defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 29))
+	posix_spawn_file_actions_addchdir_np(&actions, realCWD.c_str());
+	bool needChdir = false;
+#else
+	bool needChdir = true;
+#endif
+	const std::string inFile = options.inFile.empty() ? "/dev/null" : options.inFile;
+	posix_spawn_file_actions_addopen(&actions, 0, inFile.c_str(), O_RDONLY, 0);
+
+	Capture* captures[2] = {out, err};
+	for(Capture* cap : captures) {
+		if(cap)
+			*cap = Capture();
+	}
+	const std::string* files[2] = {&options.outFile, &options.errFile};
+	const char* outPaths[2];
+	for(int i = 0; i < 2; i++)
+		outPaths[i] = files[i]->empty() ? "/dev/null" : files[i]->c_str();
+	int pipes[2][2] = {{-1, -1}, {-1, -1}};
+	pid_t pid = -1;
+	int spawnError = 0;
+	{
+		std::lock_guard<std::mutex> guard(spawnLock);
+		for(int i = 0; i < 2; i++) {
+			int fd = i + 1;
+			if(captures[i]) {
+				if(openPipe(pipes[i])) {
+					spawnError = errno;
+					break;
+				}
+				fcntl(pipes[i][0], F_SETFL, O_NONBLOCK);
+				posix_spawn_file_actions_adddup2(&actions, pipes[i][1], fd);
+			} else {
+				posix_spawn_file_actions_addopen(&actions, fd, outPaths[i], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+			}
+		}
+		if(!spawnError && !needChdir && !options.memoryLimit) {
+			spawnError = posix_spawnp(&pid, argv[0], &actions, NULL, argv.data(), environ);
+		} else if(!spawnError) {
+			/* posix_spawn cannot set resource limits (and may not
+			 * be able to change directory), so the child is set up
+			 * by hand, using only async-signal-safe calls.
+			 */
+			pid = fork();
+			if(pid == 0) {
+				if(chdir(realCWD.c_str()))
+					_exit(127);
+				if(options.memoryLimit) {
+					/* The data segment rather than the address
+					 * space is limited where the former includes
+					 * mmap()ed memory, since e.g. Java reserves
+					 * far more address space than it uses.
+					 */
+					struct rlimit limit;
+					limit.rlim_cur = limit.rlim_max = options.memoryLimit;
+#ifdef __linux__
+					if(setrlimit(RLIMIT_DATA, &limit))
+#else
+					if(setrlimit(RLIMIT_AS, &limit))
+#endif
+						_exit(127);
+				}
+				int in = open(inFile.c_str(), O_RDONLY);
+				if(in < 0 || dup2(in, 0) < 0)
+					_exit(127);
+				for(int i = 0; i < 2; i++) {
+					int fd = pipes[i][1];
+					if(fd < 0)
+						fd = open(outPaths[i], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+					if(fd < 0 || dup2(fd, i + 1) < 0)
+						_exit(127);
+				}
+				execvp(argv[0], argv.data());
+				_exit(127);
+			} else if(pid < 0) {
+				spawnError = errno;
+			}
+		}
+		for(int i = 0; i < 2; i++) {
+			if(pipes[i][1] >= 0)
+				close(pipes[i][1]);
+		}
+	}
+	posix_spawn_file_actions_destroy(&actions);
+
+	if(spawnError) {
+		for(int i = 0; i < 2; i++) {
+			if(pipes[i][0] >= 0)
+				close(pipes[i][0]);
+		}
+		if(messageFormatter) messageFormatter->reportError("Could not execute " + command + ": " + strerror(spawnError));
+		return -1;
+	}
+
+	System::Timer timer;
+	std::ofstream spills[2];
+	int status = 0;
+	struct rusage usage;
+	memset(&usage, 0, sizeof(usage));
+	bool exited = false;
+	bool terminated = false;
+	double terminateTime = 0;
+	while(true) {
+		struct pollfd fds[2];
+		int nfds = 0;
+		for(int i = 0; i < 2; i++) {
+			if(pipes[i][0] >= 0) {
+				fds[nfds].fd = pipes[i][0];
+				fds[nfds].events = POLLIN;
+				nfds++;
+			}
+		}
+		if(nfds)
+			poll(fds, nfds, 50);
+		else if(!exited)
+			usleep(10000);
+
+		/* Check for termination before reading, so that all output
+		 * written before the command exited is read below.
+		 */
+		if(!exited) {
+			pid_t r = wait4(pid, &status, WNOHANG, &usage);
+			if(r == pid || (r < 0 && errno != EINTR))
+				exited = true;
+		}
+		for(int i = 0; i < 2; i++) {
+			if(pipes[i][0] < 0)
+				continue;
+			if(!readPipe(pipes[i][0], captures[i], spills[i], *files[i], options.spillLimit) || exited) {
+				/* Once the command has exited, anything still
+				 * holding the pipe open (e.g., a background
+				 * child) is not waited for.
+				 */
+				close(pipes[i][0]);
+				pipes[i][0] = -1;
+			}
+		}
+		if(exited && pipes[0][0] < 0 && pipes[1][0] < 0)
+			break;
+		if(exited)
+			continue;
+
+		double elapsed = timer.getElapsedSeconds();
+		if(!terminated) {
+			bool timedOut = options.timeout > 0 && elapsed > options.timeout;
+			bool cancelled = options.cancel && *options.cancel;
+			if(timedOut || cancelled) {
+				if(messageFormatter) {
+					std::stringstream str;
+					if(timedOut)
+						str << "Timeout of " << options.timeout << " seconds exceeded, terminating: " << command;
+					else
+						str << "Cancelled, terminating: " << command;
+					messageFormatter->reportAction(str.str(), options.verbosity);
+				}
+				kill(pid, SIGTERM);
+				terminated = true;
+				terminateTime = elapsed;
+			}
+		} else if(elapsed - terminateTime > 2) {
+			kill(pid, SIGKILL);
+		}
+	}
+
+	if(stats) {
+		*stats = RunStatistics();
+		stats->time_user = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1000000.0f;
+		stats->time_system = usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1000000.0f;
+		stats->time_elapsed = (float)timer.getElapsedSeconds();
+		stats->time_monraw = stats->time_elapsed;
+#ifdef __APPLE__
+		stats->mem_resident = usage.ru_maxrss / 1024.0f;
+#else
+		stats->mem_resident = usage.ru_maxrss;
+#endif
+	}
+
+	if(messageFormatter) {
+		std::stringstream str;
+		str << "Process exited with result: " << status;
+		messageFormatter->reportAction(str.str(), options.verbosity);
+		messageFormatter->reportAction("Exiting directory: `" + realCWD + "'", options.verbosity);
+	}
+
+	// Check if the command was killed, e.g. by ctrl-c, but not by us
+	if(options.signalHandler && WIFSIGNALED(status) && !terminated) {
+		status = options.signalHandler(status);
+	}
+	if(terminated && !status)
+		status = -1;
+	return status;
+}
 #else // WIN32 version
 /* Escape an argument so that CommandLineToArgv parses it correctly */
 static void escapeArgument(std::stringstream& out, const std::string& argument) {
@@ -346,6 +629,42 @@ int Shell::system(const SystemOptions& options, RunStatistics* stats) {
 	// Return the result of the command
 	return exitCode;
 }
+
+int Shell::spawn(const SystemOptions& options, Capture* out, Capture* err, RunStatistics* stats) {
+	/* Output always goes through the files here, so capturing only
+	 * requires a temporary file if none was specified.
+	 * Output is read back after the command is finished; timeouts,
+	 * cancellation and memory limits are not supported.
+	 */
+	SystemOptions sysOps = options;
+	Capture* captures[2] = {out, err};
+	std::string* files[2] = {&sysOps.outFile, &sysOps.errFile};
+	bool temporary[2] = {false, false};
+	for(int i = 0; i < 2; i++) {
+		if(captures[i] && files[i]->empty()) {
+			*files[i] = getTempFile().getFilePath();
+			temporary[i] = true;
+		}
+	}
+	int result = system(sysOps, stats);
+	for(int i = 0; i < 2; i++) {
+		if(!captures[i])
+			continue;
+		File file(*files[i]);
+		*captures[i] = Capture();
+		string* contents = FileSystem::load(file);
+		if(contents) {
+			if(!temporary[i] && contents->length() > options.spillLimit)
+				captures[i]->spilled = true;
+			else
+				captures[i]->contents = *contents;
+			delete contents;
+		}
+		if(temporary[i])
+			FileSystem::remove(file);
+	}
+	return result;
+}
 #endif // WIN32
 
 bool Shell::readSvlStatisticsFromLog(File logFile, Shell::SvlStatistics& stats) {
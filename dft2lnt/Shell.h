@@ -19,6 +19,7 @@
 #include <fstream>
 #include <time.h>
 #include <signal.h>
+#include <atomic>
 #include "MessageFormatter.h"
 #include "FileSystem.h"
 #include "System.h"
@@ -68,6 +69,19 @@ public:
 		std::string inFile;
 		int verbosity;
 		std::function<int(int)> signalHandler;
+
+		/// Only used by spawn(): output captured in memory beyond this
+		/// many bytes is moved to outFile/errFile.
+		size_t spillLimit;
+		/// Only used by spawn(): seconds after which the command is
+		/// terminated, or 0 for no limit.
+		double timeout;
+		/// Only used by spawn(): the command is terminated once this
+		/// becomes true.
+		const std::atomic<bool>* cancel;
+		/// Only used by spawn(): the maximum memory in bytes of the
+		/// command (and of each process it starts), or 0 for no limit.
+		size_t memoryLimit;
 		
 		SystemOptions():
 			command(""),
@@ -80,9 +94,26 @@ public:
 			reportFile(""),
 			inFile(""),
 			verbosity(0),
-			signalHandler(&handleSignal) {
+			signalHandler(&handleSignal),
+			spillLimit((size_t)-1),
+			timeout(0),
+			cancel(NULL),
+			memoryLimit(0) {
 		}
 	};
+
+	/**
+	 * Output of a command captured by spawn(). The output is kept in
+	 * contents, unless it grew beyond the spill limit, in which case all
+	 * of it was written to the output file instead.
+	 */
+	class Capture {
+	public:
+		std::string contents;
+		bool spilled;
+
+		Capture(): spilled(false) {}
+	};
 	
     class SvlStatistics {
     public:
@@ -168,6 +199,19 @@ public:
 	static int system(std::string command, int verbosity=0, RunStatistics* stats = NULL);
 	static int system(const SystemOptions& options, RunStatistics* stats = NULL);
 
+	/**
+	 * Execute the command specified in the options directly, without
+	 * starting a shell. Unlike system(), the statistics are obtained
+	 * from the operating system and statFile/statProgram are ignored.
+	 * @param out If not NULL, stdout is captured in it (spilling to
+	 * 	outFile when larger than the spill limit), otherwise stdout is
+	 * 	written to outFile.
+	 * @param err Like out, for stderr and errFile.
+	 * @return The wait status of the command, or -1 if it could not
+	 * 	be started.
+	 */
+	static int spawn(const SystemOptions& options, Capture* out, Capture* err, RunStatistics* stats = NULL);
+
 	static bool memtimeAvailable() {
 		vector<File> memtimes;
 		int n = FileSystem::findInPath(memtimes,File("memtime"));
@@ -0,0 +1,156 @@
+/*
+ * Trace.cpp
+ *
+ * Part of dft2lnt library - a library containing read/write operations for DFT
+ * files in Galileo format and translating DFT specifications into Lotos NT.
+ *
+ * @author Enno Ruijters
+ */
+
+#include "Trace.h"
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#ifdef WIN32
+# include <process.h>
+#else
+# include <unistd.h>
+#endif
+
+Trace::Span::Span(Trace *trace, const std::string &name,
+                  const std::string &category)
+	:trace(trace), name(name), category(category), start(0)
+{
+	if (trace)
+		start = Trace::now();
+}
+
+Trace::Span::~Span()
+{
+	if (trace)
+		trace->addSpan(name, category, start, Trace::now(), args);
+}
+
+void Trace::Span::addArg(const std::string &key, const std::string &value)
+{
+	if (trace)
+		args.push_back(std::make_pair(key, Trace::quote(value)));
+}
+
+void Trace::Span::addArg(const std::string &key, uint64_t value)
+{
+	if (trace)
+		args.push_back(std::make_pair(key, std::to_string(value)));
+}
+
+Trace::Trace(const std::string &processName)
+{
+#ifdef WIN32
+	pid = _getpid();
+#else
+	pid = getpid();
+#endif
+	events.push_back("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":"
+	                 + std::to_string(pid)
+	                 + ",\"args\":{\"name\":" + quote(processName) + "}}");
+}
+
+uint64_t Trace::now()
+{
+	/* On Linux, steady_clock is CLOCK_MONOTONIC, which is the same in
+	 * every process.
+	 */
+	auto t = std::chrono::steady_clock::now().time_since_epoch();
+	return std::chrono::duration_cast<std::chrono::microseconds>(t).count();
+}
+
+std::string Trace::quote(const std::string &value)
+{
+	std::string ret = "\"";
+	for (unsigned char c : value) {
+		if (c == '"' || c == '\\') {
+			ret += '\\';
+			ret += c;
+		} else if (c < 0x20) {
+			char buf[8];
+			snprintf(buf, sizeof(buf), "\\u%04x", c);
+			ret += buf;
+		} else {
+			ret += c;
+		}
+	}
+	return ret + "\"";
+}
+
+int Trace::getThread()
+{
+	auto it = threads.find(std::this_thread::get_id());
+	if (it != threads.end())
+		return it->second;
+	int tid = threads.size() + 1;
+	threads[std::this_thread::get_id()] = tid;
+	return tid;
+}
+
+void Trace::addSpan(const std::string &name, const std::string &category,
+                    uint64_t start, uint64_t end, const Args &args)
+{
+	std::stringstream ss;
+	ss << "{\"name\":" << quote(name) << ",\"cat\":" << quote(category)
+	   << ",\"ph\":\"X\",\"ts\":" << start << ",\"dur\":" << (end - start)
+	   << ",\"pid\":" << pid;
+	std::lock_guard<std::mutex> guard(lock);
+	ss << ",\"tid\":" << getThread();
+	if (!args.empty()) {
+		ss << ",\"args\":{";
+		for (size_t i = 0; i < args.size(); i++) {
+			if (i)
+				ss << ',';
+			ss << quote(args[i].first) << ':' << args[i].second;
+		}
+		ss << '}';
+	}
+	ss << '}';
+	events.push_back(ss.str());
+}
+
+int Trace::addFile(const File &file)
+{
+	std::string *contents = FileSystem::load(file);
+	if (!contents)
+		return 1;
+	/* Strip the surrounding brackets, leaving the events themselves */
+	size_t begin = contents->find('[');
+	size_t end = contents->rfind(']');
+	if (begin == std::string::npos || end == std::string::npos || end < begin) {
+		delete contents;
+		return 1;
+	}
+	std::string inner = contents->substr(begin + 1, end - begin - 1);
+	delete contents;
+	if (inner.find_first_not_of(" \t\r\n") == std::string::npos)
+		return 0;
+	/* Trailing newline and separator are added by write() */
+	while (!inner.empty() && (inner.back() == '\n' || inner.back() == ' '))
+		inner.pop_back();
+	if (inner.front() == '\n')
+		inner.erase(0, 1);
+	std::lock_guard<std::mutex> guard(lock);
+	events.push_back(inner);
+	return 0;
+}
+
+int Trace::write(const File &file)
+{
+	std::ofstream out(file.getFilePath());
+	std::lock_guard<std::mutex> guard(lock);
+	out << "[\n";
+	for (size_t i = 0; i < events.size(); i++) {
+		out << events[i];
+		if (i + 1 < events.size())
+			out << ",\n";
+	}
+	out << "\n]\n";
+	return !out.good();
+}
@@ -0,0 +1,118 @@
+/*
+ * Trace.h
+ *
+ * Part of dft2lnt library - a library containing read/write operations for DFT
+ * files in Galileo format and translating DFT specifications into Lotos NT.
+ *
+ * @author Enno Ruijters
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <map>
+#include <thread>
+#include <stdint.h>
+#include "FileSystem.h"
+
+/**
+ * Collects timed spans of work, and writes them in the Chrome trace event
+ * format (viewable in chrome://tracing or Perfetto). All methods may be
+ * called from multiple threads.
+ *
+ * Timestamps are taken from a monotonic clock shared by all processes on
+ * the system, so the traces written by child processes can be merged into
+ * the trace of their parent (see addFile()).
+ */
+class Trace {
+public:
+	/**
+	 * Arguments of a span, as pairs of names and JSON values.
+	 */
+	typedef std::vector<std::pair<std::string, std::string>> Args;
+
+	/**
+	 * Records the time between its construction and destruction as a
+	 * span in the trace, if there is one. Spans started and ended on the
+	 * same thread nest within each other.
+	 */
+	class Span {
+	private:
+		Trace *trace;
+		std::string name;
+		std::string category;
+		uint64_t start;
+		Args args;
+	public:
+		/**
+		 * Starts a span.
+		 * @param trace The trace to add the span to, or NULL to not
+		 * 	record anything.
+		 */
+		Span(Trace *trace, const std::string &name,
+		     const std::string &category);
+		~Span();
+
+		Span(const Span &) = delete;
+		Span &operator=(const Span &) = delete;
+
+		/**
+		 * Adds a string argument to the span.
+		 */
+		void addArg(const std::string &key, const std::string &value);
+
+		/**
+		 * Adds a numeric argument to the span.
+		 */
+		void addArg(const std::string &key, uint64_t value);
+	};
+
+	/**
+	 * Creates an empty trace for the current process.
+	 * @param processName The name to show for this process.
+	 */
+	Trace(const std::string &processName);
+
+	/**
+	 * Returns the current time in microseconds.
+	 */
+	static uint64_t now();
+
+	/**
+	 * Returns the value as a quoted and escaped JSON string.
+	 */
+	static std::string quote(const std::string &value);
+
+	/**
+	 * Adds a completed span to the trace.
+	 * @param start Start time, as returned by now().
+	 * @param end End time, as returned by now().
+	 */
+	void addSpan(const std::string &name, const std::string &category,
+	             uint64_t start, uint64_t end, const Args &args = Args());
+
+	/**
+	 * Adds the events from a trace file written by another process.
+	 * @return 0 if successful, non-zero otherwise.
+	 */
+	int addFile(const File &file);
+
+	/**
+	 * Writes the trace to the specified file.
+	 * @return 0 if successful, non-zero otherwise.
+	 */
+	int write(const File &file);
+
+private:
+	std::mutex lock;
+	std::vector<std::string> events;
+	std::map<std::thread::id, int> threads;
+	int pid;
+
+	int getThread();
+};
+
+#endif
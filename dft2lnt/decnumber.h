@@ -1,9 +1,12 @@
 #include <string>
 #include <cstring>
+#include <cstdlib>
 #include <limits>
 #include <cctype>
 #include <cmath>
 #include <cstdint>
+#include <vector>
+#include <algorithm>
 #include <exception>
 #include <stdexcept>
 
@@ -23,140 +26,404 @@ class decnumber
 	 * integers.
 	 * e is stored as a standard integer (I doubt we'll need numbers
 	 * bigger than 10^2^32 any time soon).
-	 * i is stored as a base-N sequence of digits, where N is the
-	 * largest multiple of 10 we can fit in a block (the sequence is
-	 * stored big-endian).
+	 * i is stored as a little-endian sequence of limbs in base 10^k,
+	 * the largest power of ten for which the product of two limbs fits
+	 * in a uintmax_t (10^9 for 32-bit limbs). Decimal digits thus never
+	 * straddle limbs, so parsing, printing and scaling by powers of ten
+	 * take linear time.
+	 * Numbers of up to INLINE_LIMBS limbs are stored in the object
+	 * itself, only larger ones on the heap.
+	 * Numbers are kept normalized: i has no leading zero limbs and is
+	 * not divisible by 10, and zero has no limbs, sign 1 and exponent 0.
 	 */
 private:
-	static constexpr BT base = (std::numeric_limits<BT>::max() / 10) * 10;
+	/* Holds the product of two limbs plus two more limbs */
+	typedef uintmax_t WT;
+
+	static constexpr unsigned calc_limb_digits() {
+		unsigned d = 0;
+		WT p = 1;
+		while (p <= std::numeric_limits<BT>::max() / 10
+		       && p * 10 <= std::numeric_limits<WT>::max() / (p * 10))
+		{
+			p *= 10;
+			d++;
+		}
+		return d;
+	}
+
+	static constexpr unsigned LIMB_DIGITS = calc_limb_digits();
+
+	static constexpr BT pow10(unsigned n) {
+		BT ret = 1;
+		while (n--)
+			ret *= 10;
+		return ret;
+	}
+
+	static constexpr BT base = pow10(LIMB_DIGITS);
+
+	static const std::size_t INLINE_LIMBS = 4;
 
-	std::size_t num_blocks;
-	BT *blocks;
+	/* Below this many limbs, schoolbook multiplication is faster */
+	static const std::size_t KARATSUBA_THRESHOLD = 40;
+
+	BT inline_limbs[INLINE_LIMBS];
+	BT *limbs;
+	std::size_t num_limbs, capacity;
 	ET exponent;
 	int sign;
 
-	void mul_unnorm(BT val) {
-		if (val == 0) {
-			free(blocks);
-			blocks = nullptr;
-			num_blocks = 0;
-			sign = 1;
-			exponent = 0;
-			return;
-		}
-		if (val < 0)
-			throw std::invalid_argument("Unnormalized multiplication by negative numbers currently not supported.");
-		if (val == 1)
-			return;
-		if (val == base) {
-			if (num_blocks == SIZE_MAX)
-				throw std::overflow_error("Number way too big.");
-			BT *tmp = new BT[num_blocks + 1];
-			memcpy(tmp, blocks, num_blocks * sizeof(BT));
-			delete[] blocks;
-			blocks = tmp;
-			blocks[num_blocks] = 0;
-			num_blocks++;
+	void init() {
+		limbs = inline_limbs;
+		capacity = INLINE_LIMBS;
+		num_limbs = 0;
+		exponent = 0;
+		sign = 1;
+	}
+
+	void release() {
+		if (limbs != inline_limbs)
+			delete[] limbs;
+		limbs = inline_limbs;
+		capacity = INLINE_LIMBS;
+	}
+
+	void reserve(std::size_t n) {
+		if (n <= capacity)
 			return;
+		std::size_t cap = std::max(n, capacity * 2);
+		BT *tmp = new BT[cap];
+		memcpy(tmp, limbs, num_limbs * sizeof(BT));
+		release();
+		limbs = tmp;
+		capacity = cap;
+	}
+
+	void resize(std::size_t n) {
+		reserve(n);
+		for (std::size_t i = num_limbs; i < n; i++)
+			limbs[i] = 0;
+		num_limbs = n;
+	}
+
+	void trim() {
+		while (num_limbs && limbs[num_limbs - 1] == 0)
+			num_limbs--;
+	}
+
+	void set_zero() {
+		num_limbs = 0;
+		exponent = 0;
+		sign = 1;
+	}
+
+	void assign(const decnumber<BT, ET> &other) {
+		num_limbs = 0;
+		reserve(other.num_limbs);
+		memcpy(limbs, other.limbs, other.num_limbs * sizeof(BT));
+		num_limbs = other.num_limbs;
+		exponent = other.exponent;
+		sign = other.sign;
+	}
+
+	void steal(decnumber<BT, ET> &other) {
+		if (other.limbs == other.inline_limbs) {
+			assign(other);
+		} else {
+			release();
+			limbs = other.limbs;
+			capacity = other.capacity;
+			num_limbs = other.num_limbs;
+			exponent = other.exponent;
+			sign = other.sign;
+			other.limbs = other.inline_limbs;
+			other.capacity = INLINE_LIMBS;
 		}
-		decnumber<BT, ET> old(*this);
-		if (val > 2) {
-			mul_unnorm(val / 2);
+		other.set_zero();
+	}
+
+	/* Operations on the magnitude (i) only */
+
+	static int cmp_limbs(const BT *a, std::size_t na,
+	                     const BT *b, std::size_t nb)
+	{
+		if (na != nb)
+			return na < nb ? -1 : 1;
+		for (std::size_t i = na; i-- > 0; ) {
+			if (a[i] != b[i])
+				return a[i] < b[i] ? -1 : 1;
 		}
-		/* val == 2 */
+		return 0;
+	}
+
+	/* out[0..n) += x[0..nx), returns the carry out of out[n - 1] */
+	static BT add_limbs(BT *out, std::size_t n, const BT *x, std::size_t nx) {
 		BT carry = 0;
-		for (std::size_t i = num_blocks - 1; i != SIZE_MAX; i--) {
-			BT new_carry = 0;
-			/* This entirely depends on base being divisible by 2, which it
-			 * is since we've chosen it to be a multiple of 10.
-			 */
-			if (blocks[i] >= base / 2) {
-				blocks[i] -= base / 2;
-				new_carry = 1;
+		std::size_t i;
+		for (i = 0; i < nx; i++) {
+			WT sum = (WT)out[i] + x[i] + carry;
+			carry = sum >= base;
+			out[i] = (BT)(carry ? sum - base : sum);
+		}
+		for (; carry && i < n; i++) {
+			if (++out[i] == base)
+				out[i] = 0;
+			else
+				carry = 0;
+		}
+		return carry;
+	}
+
+	/* x[0..nx) -= y[0..ny), which must not be negative */
+	static void sub_limbs(BT *x, std::size_t nx, const BT *y, std::size_t ny) {
+		BT borrow = 0;
+		std::size_t i;
+		for (i = 0; i < ny; i++) {
+			WT sub = (WT)y[i] + borrow;
+			if (x[i] < sub) {
+				x[i] = (BT)(x[i] + base - sub);
+				borrow = 1;
+			} else {
+				x[i] = (BT)(x[i] - sub);
+				borrow = 0;
 			}
-			blocks[i] *= 2;
-			blocks[i] += carry;
-			if (blocks[i] >= base) {
-				new_carry++;
-				blocks[i] -= base;
+		}
+		for (; borrow && i < nx; i++) {
+			if (x[i] == 0) {
+				x[i] = base - 1;
+			} else {
+				x[i]--;
+				borrow = 0;
 			}
-			carry = new_carry;
 		}
-		if (carry) {
-			if (num_blocks == SIZE_MAX)
-				throw std::overflow_error("Number way too big.");
-			BT *tmp = new BT[num_blocks + 1];
-			memcpy(tmp+1, blocks, num_blocks * sizeof(BT));
-			delete[] blocks;
-			num_blocks++;
-			blocks = tmp;
-			blocks[0] = carry;
-		}
-		if (val & 1) {
-			BT carry = 0;
-			size_t i;
-			for (i = 0; i < old.num_blocks; i++) {
-				size_t pn = num_blocks - i - 1;
-				size_t po = old.num_blocks - i - 1;
-				if (blocks[pn] == base - carry) {
-					blocks[pn] = 0;
-				} else {
-					blocks[pn] += carry;
-					carry = 0;
-				}
-				if (blocks[pn] >= base - old.blocks[po]) {
-					carry++;
-					blocks[pn] -= base - old.blocks[po];
-				} else {
-					blocks[pn] += old.blocks[po];
-				}
+	}
+
+	/* out[0..na+nb) += a * b */
+	static void mul_schoolbook(BT *out, const BT *a, std::size_t na,
+	                           const BT *b, std::size_t nb)
+	{
+		for (std::size_t i = 0; i < na; i++) {
+			if (a[i] == 0)
+				continue;
+			WT carry = 0;
+			for (std::size_t j = 0; j < nb; j++) {
+				WT cur = out[i + j] + (WT)a[i] * b[j] + carry;
+				carry = cur / base;
+				out[i + j] = (BT)(cur % base);
 			}
-			i = num_blocks - old.num_blocks;
+			std::size_t k = i + nb;
 			while (carry) {
-				if (i) {
-					i--;
-					blocks[i]++;
-					if (blocks[i] == base)
-						blocks[i] = 0;
-					else
-						carry = 0;
-				} else {
-					if (num_blocks == SIZE_MAX)
-						throw std::overflow_error("Number way too big.");
-					BT *tmp = new BT[num_blocks + 1];
-					memcpy(tmp+1, blocks, num_blocks * sizeof(BT));
-					delete[] blocks;
-					num_blocks++;
-					blocks = tmp;
-					blocks[0] = carry;
-					carry = 0;
-				}
+				WT cur = out[k] + carry;
+				carry = cur / base;
+				out[k++] = (BT)(cur % base);
 			}
 		}
 	}
 
+	/* out[0..na+nb) = a * b, where out is initially zero */
+	static void mul_limbs(BT *out, const BT *a, std::size_t na,
+	                      const BT *b, std::size_t nb)
+	{
+		if (na < KARATSUBA_THRESHOLD || nb < KARATSUBA_THRESHOLD) {
+			mul_schoolbook(out, a, na, b, nb);
+			return;
+		}
+		/* a = a1 * base^h + a0, b = b1 * base^h + b0, then
+		 * a * b = z2 * base^2h + z1 * base^h + z0 with
+		 * z0 = a0 * b0, z2 = a1 * b1, and
+		 * z1 = (a0 + a1) * (b0 + b1) - z0 - z2.
+		 */
+		std::size_t h = std::min(na, nb) / 2;
+		std::size_t na1 = na - h, nb1 = nb - h;
+		std::vector<BT> z0(2 * h), z2(na1 + nb1);
+		mul_limbs(z0.data(), a, h, b, h);
+		mul_limbs(z2.data(), a + h, na1, b + h, nb1);
+		std::vector<BT> sa(a + h, a + na), sb(b + h, b + nb);
+		sa.push_back(add_limbs(sa.data(), na1, a, h));
+		sb.push_back(add_limbs(sb.data(), nb1, b, h));
+		std::vector<BT> z1(sa.size() + sb.size());
+		mul_limbs(z1.data(), sa.data(), sa.size(), sb.data(), sb.size());
+		sub_limbs(z1.data(), z1.size(), z0.data(), z0.size());
+		sub_limbs(z1.data(), z1.size(), z2.data(), z2.size());
+		std::size_t n = na + nb;
+		add_limbs(out, n, z0.data(), z0.size());
+		std::size_t nz1 = z1.size();
+		while (nz1 && z1[nz1 - 1] == 0)
+			nz1--;
+		add_limbs(out + h, n - h, z1.data(), nz1);
+		add_limbs(out + 2 * h, n - 2 * h, z2.data(), z2.size());
+	}
+
+	/* i *= m, for m < base */
+	void mul_small(BT m) {
+		WT carry = 0;
+		for (std::size_t i = 0; i < num_limbs; i++) {
+			WT cur = (WT)limbs[i] * m + carry;
+			limbs[i] = (BT)(cur % base);
+			carry = cur / base;
+		}
+		if (carry) {
+			resize(num_limbs + 1);
+			limbs[num_limbs - 1] = (BT)carry;
+		}
+	}
+
+	/* i /= d, returns the remainder */
+	BT div_small(BT d) {
+		WT rem = 0;
+		for (std::size_t i = num_limbs; i-- > 0; ) {
+			WT cur = rem * base + limbs[i];
+			limbs[i] = (BT)(cur / d);
+			rem = cur % d;
+		}
+		trim();
+		return (BT)rem;
+	}
+
+	/* i *= 10^n */
+	void mul_pow10(uintmax_t n) {
+		if (!num_limbs)
+			return;
+		std::size_t shift = n / LIMB_DIGITS;
+		if (shift) {
+			std::size_t old = num_limbs;
+			resize(num_limbs + shift);
+			memmove(limbs + shift, limbs, old * sizeof(BT));
+			for (std::size_t i = 0; i < shift; i++)
+				limbs[i] = 0;
+		}
+		mul_small(pow10(n % LIMB_DIGITS));
+	}
+
+	/* The number of decimal digits of i */
+	std::size_t num_digits() const {
+		if (!num_limbs)
+			return 0;
+		std::size_t ret = (num_limbs - 1) * LIMB_DIGITS;
+		for (BT top = limbs[num_limbs - 1]; top; top /= 10)
+			ret++;
+		return ret;
+	}
+
+	/* Compares the absolute values of this number and other */
+	int cmp_abs(const decnumber<BT, ET> &other) const {
+		if (!num_limbs || !other.num_limbs)
+			return (num_limbs != 0) - (other.num_limbs != 0);
+		/* Compare the positions of the most significant digits */
+		ET top = (ET)num_digits() + exponent;
+		ET otherTop = (ET)other.num_digits() + other.exponent;
+		if (top != otherTop)
+			return top < otherTop ? -1 : 1;
+		if (exponent == other.exponent) {
+			return cmp_limbs(limbs, num_limbs,
+			                 other.limbs, other.num_limbs);
+		}
+		decnumber<BT, ET> tmp(0);
+		if (exponent > other.exponent) {
+			tmp.assign(*this);
+			tmp.mul_pow10(exponent - other.exponent);
+			return cmp_limbs(tmp.limbs, tmp.num_limbs,
+			                 other.limbs, other.num_limbs);
+		}
+		tmp.assign(other);
+		tmp.mul_pow10(other.exponent - exponent);
+		return cmp_limbs(limbs, num_limbs, tmp.limbs, tmp.num_limbs);
+	}
+
 	void normalize() {
-		while (blocks && !(blocks[num_blocks - 1] % 10)) {
-			divint(10);
-			exponent++;
-		}
-		while (num_blocks && blocks[0] == 0) {
-			if (num_blocks == 0) {
-				delete[] blocks;
-				blocks = nullptr;
-			} else {
-				BT *tmp = new BT[num_blocks - 1];
-				num_blocks--;
-				memcpy(tmp, blocks + 1, num_blocks*sizeof(BT));
-				delete[] blocks;
-				blocks = tmp;
-			}
+		trim();
+		if (!num_limbs) {
+			set_zero();
+			return;
+		}
+		std::size_t zeros = 0;
+		while (limbs[zeros] == 0)
+			zeros++;
+		if (zeros) {
+			memmove(limbs, limbs + zeros, (num_limbs - zeros) * sizeof(BT));
+			num_limbs -= zeros;
+			exponent += (ET)(zeros * LIMB_DIGITS);
+		}
+		BT low = limbs[0], div = 1;
+		ET digits = 0;
+		while (low % 10 == 0) {
+			low /= 10;
+			div *= 10;
+			digits++;
+		}
+		if (digits) {
+			div_small(div);
+			exponent += digits;
+		}
+	}
+
+	/* Sets i to the specified decimal digits (without sign) */
+	void set_digits(const char *digits, std::size_t n) {
+		while (n && *digits == '0') {
+			digits++;
+			n--;
+		}
+		num_limbs = 0;
+		reserve((n + LIMB_DIGITS - 1) / LIMB_DIGITS);
+		while (n) {
+			std::size_t len = std::min<std::size_t>(n, LIMB_DIGITS);
+			BT limb = 0;
+			for (std::size_t i = n - len; i < n; i++)
+				limb = limb * 10 + (digits[i] - '0');
+			limbs[num_limbs++] = limb;
+			n -= len;
 		}
-		if (!blocks)
-			exponent = 0;
 	}
 
-	void parse_string(std::string num) {
+	/* The largest integer mantissa of a float type with the specified
+	 * number of mantissa bits (capped to what fits in an uintmax_t).
+	 */
+	static constexpr uintmax_t max_mantissa(int bits) {
+		return bits >= std::numeric_limits<uintmax_t>::digits
+		       ? std::numeric_limits<uintmax_t>::max()
+		       : ((uintmax_t)1 << bits) - 1;
+	}
+
+	/* The largest k for which 10^k is exact in a float type with the
+	 * specified number of mantissa bits (i.e., 5^k fits in the mantissa).
+	 */
+	static constexpr int exact_pow10(int bits) {
+		int k = 0;
+		for (uintmax_t p = 1; p <= max_mantissa(bits) / 5; p *= 5)
+			k++;
+		return k;
+	}
+
+	/* Converts to a float type without going through a string, if the
+	 * mantissa and the power of ten are both exact in that type, so a
+	 * single multiplication or division rounds correctly. This covers
+	 * most numbers we read from or write to the model checkers.
+	 * @return Whether the conversion was possible.
+	 */
+	template <class F>
+	bool to_float_exact(F &ret) const {
+		const int bits = std::numeric_limits<F>::digits;
+		const int max_exp = exact_pow10(bits);
+		if (num_limbs * LIMB_DIGITS > (std::size_t)std::numeric_limits<uintmax_t>::digits10)
+			return false;
+		if (exponent < -max_exp || exponent > max_exp)
+			return false;
+		uintmax_t m = 0;
+		for (std::size_t i = num_limbs; i-- > 0; )
+			m = m * base + limbs[i];
+		if (m > max_mantissa(bits))
+			return false;
+		F scale = 1;
+		for (ET i = exponent < 0 ? -exponent : exponent; i > 0; i--)
+			scale *= 10;
+		ret = exponent < 0 ? (F)m / scale : (F)m * scale;
+		if (sign < 0)
+			ret = -ret;
+		return true;
+	}
+
+	void parse_string(const std::string &num) {
 		std::size_t pos = 0;
 		bool past_point = false;
 		while (isspace(num[pos]))
@@ -169,206 +436,160 @@ private:
 			if (num[pos] == '+')
 				pos++;
 		}
-		while (num[pos] == '0')
-			pos++;
-		num_blocks = 0;
-		exponent = 0;
-		blocks = nullptr;
-
+		std::string digits;
+		ET frac_digits = 0;
 		while (num[pos] != 0 && num[pos] != 'e' && num[pos] != 'E') {
 			if (num[pos] == '.') {
-				if (past_point) {
-					delete[] blocks;
+				if (past_point)
 					throw std::runtime_error("Multiple decimal points");
-				}
 				past_point = true;
 				pos++;
 				continue;
 			}
-			if (!isdigit(num[pos])) {
-				delete[] blocks;
+			if (!isdigit(num[pos]))
 				throw std::runtime_error("Unexpected character in number: '" + num + "'");
-			}
-			mul_unnorm(10);
-			if (num_blocks == 0) {
-				blocks = new BT[1];
-				blocks[0] = 0;
-				num_blocks = 1;
-			}
-			blocks[num_blocks - 1] += num[pos] - '0';
+			digits += num[pos];
 			if (past_point) {
-				if (exponent == std::numeric_limits<ET>::min())
-				{
-					delete[] blocks;
+				if (frac_digits == std::numeric_limits<ET>::max())
 					throw std::overflow_error("Exponent out of range: " + num);
-				}
-				exponent--;
+				frac_digits++;
 			}
 			pos++;
 		}
-		if (!num[pos]) {
-			normalize();
-			return;
-		}
-		/* Exponent remains */
-		pos++; /* Skip 'e' */
 		ET additional_exponent = 0;
-		ET emax = std::numeric_limits<ET>::max();
-		int exp_sign = 1;
-		if (num[pos] == '-') {
-			exp_sign = -1;
-			pos++;
-		} else if (num[pos] == '+') {
-			pos++;
-		}
-		while (num[pos]) {
-			if (!isdigit(num[pos])) {
-				delete[] blocks;
-				throw std::runtime_error("Unexpected character in number: " + num);
+		if (num[pos]) {
+			pos++; /* Skip 'e' */
+			ET emax = std::numeric_limits<ET>::max();
+			int exp_sign = 1;
+			if (num[pos] == '-') {
+				exp_sign = -1;
+				pos++;
+			} else if (num[pos] == '+') {
+				pos++;
 			}
-			if (additional_exponent < ((emax - 9) / 10) - 9) {
-				additional_exponent *= 10;
-				additional_exponent += num[pos] - '0';
-			} else {
-				delete[] blocks;
-				throw std::overflow_error("Exponent out of range: " + num);
+			while (num[pos]) {
+				if (!isdigit(num[pos]))
+					throw std::runtime_error("Unexpected character in number: " + num);
+				if (additional_exponent < ((emax - 9) / 10) - 9) {
+					additional_exponent *= 10;
+					additional_exponent += num[pos] - '0';
+				} else {
+					throw std::overflow_error("Exponent out of range: " + num);
+				}
+				pos++;
 			}
-			pos++;
+			additional_exponent *= exp_sign;
 		}
-		additional_exponent *= exp_sign;
-		if (exponent <= 0 && sign == 1) {
-			exponent += additional_exponent;
-		} else if (exponent >= 0 && sign == -1) {
-			exponent -= additional_exponent;
-		} else if (sign == 1) {
-			if (exponent > emax - additional_exponent) {
-				delete[] blocks;
-				throw std::overflow_error("Exponent out of range: " + num);
-			}
-			exponent += additional_exponent;
-		} else { /* sign == -1 */
-			ET emin = std::numeric_limits<ET>::min();
-			if (exponent < emin + additional_exponent) {
-				delete[] blocks;
-				throw std::overflow_error("Exponent out of range: " + num);
-			}
-			exponent -= additional_exponent;
+		if (additional_exponent < std::numeric_limits<ET>::min() + frac_digits)
+			throw std::overflow_error("Exponent out of range: " + num);
+		exponent = additional_exponent - frac_digits;
+		set_digits(digits.data(), digits.size());
+		normalize();
+	}
+
+	/* this += other * other_sign */
+	void add_signed(const decnumber<BT, ET> &other, int other_sign) {
+		if (!other.num_limbs)
+			return;
+		if (!num_limbs) {
+			assign(other);
+			sign = other_sign;
+			return;
+		}
+		decnumber<BT, ET> tmp(0);
+		const decnumber<BT, ET> *add = &other;
+		if (exponent > other.exponent) {
+			mul_pow10(exponent - other.exponent);
+			exponent = other.exponent;
+		} else if (other.exponent > exponent) {
+			tmp.assign(other);
+			tmp.mul_pow10(other.exponent - exponent);
+			add = &tmp;
+		}
+		if (sign == other_sign) {
+			resize(std::max(num_limbs, add->num_limbs) + 1);
+			add_limbs(limbs, num_limbs, add->limbs, add->num_limbs);
+		} else if (cmp_limbs(limbs, num_limbs, add->limbs, add->num_limbs) >= 0) {
+			sub_limbs(limbs, num_limbs, add->limbs, add->num_limbs);
+		} else {
+			if (add != &tmp)
+				tmp.assign(*add);
+			sub_limbs(tmp.limbs, tmp.num_limbs, limbs, num_limbs);
+			ET e = exponent;
+			steal(tmp);
+			sign = other_sign;
+			exponent = e;
 		}
 		normalize();
 	}
+
 public:
-	//decnumber() :num_blocks(0), blocks(nullptr), sign(1), exponent(0)
+	//decnumber() :num_limbs(0), limbs(nullptr), sign(1), exponent(0)
 	//{}
 	decnumber() = delete;
 
 	decnumber(const decnumber<BT, ET> &other) {
-		num_blocks = other.num_blocks;
-		if (num_blocks) {
-			blocks = new BT[num_blocks];
-			memcpy(blocks, other.blocks, num_blocks * sizeof(*blocks));
-		} else {
-			blocks = nullptr;
-		}
-		exponent = other.exponent;
-		sign = other.sign;
+		init();
+		assign(other);
 	}
 
-	decnumber(decnumber<BT, ET> &&other)
-		: num_blocks(other.num_blocks),
-		  blocks(other.blocks),
-		  exponent(other.exponent),
-		  sign(other.sign)
-	{
-		other.blocks = nullptr;
+	decnumber(decnumber<BT, ET> &&other) {
+		init();
+		steal(other);
 	}
 
 	decnumber(std::string num) {
+		init();
 		parse_string(num);
 	}
 
 	decnumber(uintmax_t i) {
-		blocks = nullptr;
+		init();
 		*this = i;
 	}
 
 	decnumber(intmax_t i) {
-		blocks = nullptr;
+		init();
 		*this = i;
 	}
 
 	decnumber(int i) {
-		blocks = nullptr;
+		init();
 		*this = (intmax_t)i;
 	}
 
 	decnumber(long double v) {
-		blocks = nullptr;
+		init();
 		*this = v;
 	}
 
 	decnumber(double v) {
-		blocks = nullptr;
+		init();
 		*this = (long double)v;
 	}
 
 	~decnumber() {
-		delete[] blocks;
+		release();
 	}
 
 	decnumber<BT, ET>& operator=(const decnumber<BT, ET> &other) {
-		if (this != &other) {
-			delete[] blocks;
-			num_blocks = other.num_blocks;
-			if (num_blocks) {
-				blocks = new BT[num_blocks];
-				memcpy(blocks, other.blocks, num_blocks * sizeof(BT));
-			} else {
-				blocks = nullptr;
-			}
-			exponent = other.exponent;
-			sign = other.sign;
-		}
+		if (this != &other)
+			assign(other);
 		return *this;
 	}
 
 	decnumber<BT, ET>& operator=(decnumber<BT, ET> &&other) {
-		if (this != &other) {
-			delete[] blocks;
-			blocks = other.blocks;
-			other.blocks = nullptr;
-			num_blocks = other.num_blocks;
-			exponent = other.exponent;
-			sign = other.sign;
-		}
+		if (this != &other)
+			steal(other);
 		return *this;
 	}
 
 	decnumber<BT, ET>& operator=(uintmax_t i) {
-		delete[] blocks;
-		blocks = nullptr;
-		num_blocks = 0;
-		sign = 1;
-		exponent = 0;
-		uintmax_t rev = 0, bits = 0;
-		if (i == 0)
-			return *this;
+		set_zero();
 		while (i) {
-			rev <<= 1;
-			if (i % 2)
-				rev++;
-			i /= 2;
-			bits++;
-		}
-		while (bits--) {
-			mul_unnorm(2);
-			if (num_blocks == 0) {
-				blocks = new BT[1];
-				blocks[0] = 0;
-				num_blocks = 1;
-			}
-			if (rev % 2)
-				blocks[num_blocks - 1]++;
-			rev /= 2;
+			resize(num_limbs + 1);
+			limbs[num_limbs - 1] = (BT)(i % base);
+			i /= base;
 		}
 		normalize();
 		return *this;
@@ -385,229 +606,74 @@ public:
 	}
 
 	decnumber<BT, ET>& operator=(long double v) {
-		long double frac, ipart;
-		delete[] blocks;
-		blocks = nullptr;
-		frac = modfl(v, &ipart);
-		blocks = nullptr;
-		num_blocks = 0;
-		sign = 1;
-		exponent = 0;
-		if (v < 0) {
-			sign = -1;
-			v = -v;
-		}
-		while (ipart) {
-			mul_unnorm(2);
-			if (num_blocks == 0) {
-				blocks = new BT[1];
-				blocks[0] = 0;
-				num_blocks = 1;
+		if (std::isnan(v) || std::isinf(v))
+			throw std::domain_error("Not a finite number");
+		/* Write v as mantissa * 2^e with an integer mantissa, and
+		 * negative powers of two as 5^-e * 10^e. This is exact in
+		 * base-2 floats (i.e., IEEE-754), as long as the mantissa
+		 * fits in an uintmax_t.
+		 */
+		bool negative = v < 0;
+		int e;
+		long double m = frexpl(negative ? -v : v, &e);
+		int bits = std::numeric_limits<long double>::digits;
+		if (bits > std::numeric_limits<uintmax_t>::digits)
+			bits = std::numeric_limits<uintmax_t>::digits;
+		*this = (uintmax_t)ldexpl(m, bits);
+		e -= bits;
+		BT factor = e < 0 ? 5 : 2, power = 1;
+		BT limit = base / factor;
+		unsigned long n = e < 0 ? -(long)e : e;
+		while (n && num_limbs) {
+			power *= factor;
+			if (--n == 0 || power >= limit) {
+				mul_small(power);
+				power = 1;
 			}
-			frac = modfl(ipart / 2, &ipart);
-			if (frac)
-				blocks[num_blocks - 1]++;
 		}
+		if (num_limbs && e < 0)
+			exponent += e;
 		normalize();
-		if (frac) {
-			/* Note: this is only guaranteed to terminate
-			 * (and be exact) in base-2 floats (i.e.,
-			 * IEEE-754)
-			 */
-			decnumber<BT, ET> f(5), h(5);
-			f.exponent = -1;
-			h.exponent = -1;
-			while (frac) {
-				if (frac >= 0.5) {
-					*this += f;
-					frac -= 0.5;
-				}
-				frac *= 2;
-				f *= h;
-			}
-		}
+		if (negative && num_limbs)
+			sign = -1;
 		return *this;
 	}
 
 	decnumber<BT, ET> operator+(const decnumber<BT, ET> &other) const {
-		if (other.num_blocks == 0)
-			return *this;
-		if (num_blocks == 0)
-			return other;
 		decnumber<BT, ET> ret(*this);
 		ret += other;
 		return ret;
 	}
 
-	decnumber<BT, ET> operator+=(const decnumber<BT, ET> &other) {
-		if (other.num_blocks == 0)
-			return *this;
-		if (num_blocks == 0) {
-			*this = other;
-			return *this;
-		}
-		if (other.sign == -1) {
-			decnumber<BT, ET> ret(other);
-			ret.sign *= -1;
-			*this = *this - ret;
-			return *this;
-		}
-
-		if (sign == -1) {
-			sign = 1;
-			*this = other - *this;
-			sign *= -1;
-			return *this;
-		}
-		decnumber<BT, ET> tmp(0);
-		const decnumber<BT, ET> *add;
-		if (other.exponent <= exponent) {
-			add = &other;
-			while (add->exponent < exponent) {
-				mul_unnorm(10);
-				exponent--;
-			}
-		} else {
-			tmp = other;
-			while (exponent < tmp.exponent) {
-				tmp.mul_unnorm(10);
-				tmp.exponent--;
-			}
-			add = &tmp;
-		}
-		BT carry = 0;
-		if (num_blocks < add->num_blocks) {
-			size_t d = add->num_blocks - num_blocks;
-			BT *tmp = new BT[add->num_blocks];
-			memcpy(tmp + d, blocks, num_blocks * sizeof(*tmp));
-			delete[] blocks;
-			blocks = tmp;
-			while (d--)
-				blocks[d] = 0;
-			num_blocks = add->num_blocks;
-		}
-		size_t d = num_blocks - add->num_blocks;
-		for (std::size_t i = num_blocks - 1; i != SIZE_MAX; i--) {
-			if (blocks[i] == (base - 1) && carry) {
-				blocks[i] = 0;
-				carry = 1;
-			} else {
-				blocks[i] += carry;
-				carry = 0;
-			}
-			if (i >= d) {
-				if (blocks[i] > base - add->blocks[i - d]) {
-					carry = 1;
-					blocks[i] -= base - add->blocks[i - d];
-				} else {
-					carry = 0;
-					blocks[i] += add->blocks[i - d];
-				}
-			}
-		}
-		if (carry) {
-			if (num_blocks == SIZE_MAX)
-				throw std::overflow_error("Addition result too large");
-			BT *bl;
-			bl = new BT[num_blocks + 1];
-			bl[0] = carry;
-			memcpy(bl+1, blocks, num_blocks * sizeof(*bl));
-			num_blocks++;
-			delete[] blocks;
-			blocks = bl;
+	decnumber<BT, ET>& operator+=(const decnumber<BT, ET> &other) {
+		if (&other == this) {
+			decnumber<BT, ET> copy(other);
+			return *this += copy;
 		}
-		normalize();
+		add_signed(other, other.sign);
 		return *this;
 	}
 
 	decnumber<BT, ET> operator-(const decnumber<BT, ET> &other) const {
-		if (other.num_blocks == 0)
-			return *this;
-		if (num_blocks == 0) {
-			decnumber<BT, ET> ret(other);
-			ret.sign *= -1;
-			return ret;
-		}
-		if (other.sign == -1) {
-			decnumber<BT, ET> ret(other);
-			ret.sign *= -1;
-			return *this + ret;
-		}
-
 		decnumber<BT, ET> ret(*this);
-		if (sign == -1) {
-			ret.sign = 1;
-			ret = ret + other;
-			ret.sign *= -1;
-			return ret;
-		}
-		decnumber<BT, ET> tmp(0);
-		const decnumber<BT, ET> *sub;
-		if (other.exponent <= ret.exponent) {
-			sub = &other;
-			while (sub->exponent < ret.exponent) {
-				ret.mul_unnorm(10);
-				ret.exponent--;
-			}
-		} else {
-			tmp = other;
-			while (exponent < tmp.exponent) {
-				tmp.mul_unnorm(10);
-				tmp.exponent--;
-			}
-			sub = &tmp;
-		}
-		if (ret.num_blocks < sub->num_blocks) {
-			size_t d = sub->num_blocks - ret.num_blocks;
-			BT *tmp = new BT[sub->num_blocks];
-			memcpy(tmp + d, ret.blocks, ret.num_blocks * sizeof(*tmp));
-			delete[] ret.blocks;
-			ret.blocks = tmp;
-			while (d--)
-				ret.blocks[d] = 0;
-			ret.num_blocks = sub->num_blocks;
-		}
-		size_t d = ret.num_blocks - sub->num_blocks;
-		BT carry = 0;
-		for (std::size_t i = ret.num_blocks - 1; i != SIZE_MAX; i--) {
-			if (ret.blocks[i] < carry) {
-				ret.blocks[i] += base - carry;
-				carry = 1;
-			} else {
-				ret.blocks[i] -= carry;
-				carry = 0;
-			}
-			if (i >= d) {
-				if (ret.blocks[i] < sub->blocks[i - d]) {
-					carry += 1;
-					ret.blocks[i] += base - sub->blocks[i - d];
-				} else {
-					ret.blocks[i] -= sub->blocks[i - d];
-				}
-			}
-		}
-		if (carry) {
-			ret = other - *this;
-			ret.sign = -1;
-		} else {
-			ret.normalize();
-		}
+		ret -= other;
 		return ret;
 	}
 
-	decnumber<BT, ET>& operator*=(const decnumber<BT, ET> &other) {
-		if (other.num_blocks == 0 || num_blocks == 0) {
-			num_blocks = 0;
-			exponent = 0;
-			sign = 1;
-			delete[] blocks;
-			blocks = nullptr;
+	decnumber<BT, ET>& operator-=(const decnumber<BT, ET> &other) {
+		if (&other == this) {
+			set_zero();
 			return *this;
 		}
-		int target_sign = 1;
-		if (sign != other.sign)
-			target_sign = -1;
+		add_signed(other, -other.sign);
+		return *this;
+	}
 
+	decnumber<BT, ET>& operator*=(const decnumber<BT, ET> &other) {
+		if (other.num_limbs == 0 || num_limbs == 0) {
+			set_zero();
+			return *this;
+		}
 		ET emax = std::numeric_limits<ET>::max();
 		ET emin = std::numeric_limits<ET>::min();
 		ET target_exponent = other.exponent;
@@ -617,36 +683,32 @@ public:
 			throw std::overflow_error("Multiplication result too large: " + std::to_string(target_exponent) + " plus " + std::to_string(exponent));
 		}
 		target_exponent += exponent;
-
-		decnumber<BT, ET> multiplier(0);
-		multiplier.blocks = blocks;
-		multiplier.exponent = 0;
-		multiplier.num_blocks = num_blocks;
-		num_blocks = 0;
-		blocks = nullptr;
-		exponent = 0;
-		sign = 1;
-
-		decnumber<BT, ET> multiplicand(other);
-		multiplicand.exponent = 0;
-		std::size_t i;
-		for (i = multiplicand.num_blocks - 1; i != SIZE_MAX; i--) {
-			decnumber<BT, ET> tmp(multiplier);
-			tmp.mul_unnorm(multiplicand.blocks[i]);
-			tmp.normalize();
-			*this += tmp;
-			multiplier.mul_unnorm(base);
-			multiplier.normalize();
-		}
+		int target_sign = sign == other.sign ? 1 : -1;
+
+		if (other.num_limbs == 1) {
+			/* Also covers multiplication by itself */
+			mul_small(other.limbs[0]);
+		} else if (num_limbs == 1) {
+			BT m = limbs[0];
+			assign(other);
+			mul_small(m);
+		} else {
+			decnumber<BT, ET> ret(0);
+			ret.resize(num_limbs + other.num_limbs);
+			mul_limbs(ret.limbs, limbs, num_limbs,
+			          other.limbs, other.num_limbs);
+			steal(ret);
+		}
+		/* The product of numbers not divisible by 10 can still be,
+		 * e.g. 2 * 5.
+		 */
+		exponent = target_exponent;
 		sign = target_sign;
-		exponent += target_exponent;
 		normalize();
 		return *this;
 	}
 
 	decnumber<BT, ET> operator*(const decnumber<BT, ET> &other) const {
-		if (other.num_blocks == 0 || num_blocks == 0)
-			return decnumber<BT, ET>(0);
 		decnumber<BT, ET> ret(*this);
 		ret *= other;
 		return ret;
@@ -655,15 +717,13 @@ public:
 	bool operator==(const decnumber<BT, ET> &other) const {
 		if (&other == this)
 			return true;
-		if (other.num_blocks == 0 && num_blocks == 0)
-			return true;
-		if (other.num_blocks != num_blocks)
+		if (other.num_limbs != num_limbs)
 			return false;
 		if (other.sign != sign)
 			return false;
 		if (other.exponent != exponent)
 			return false;
-		return !memcmp(other.blocks, blocks, num_blocks * sizeof(BT));
+		return !memcmp(other.limbs, limbs, num_limbs * sizeof(BT));
 	}
 
 	bool operator!=(const decnumber<BT, ET> &other) const {
@@ -673,87 +733,97 @@ public:
 	bool operator<(const decnumber<BT, ET> &other) const {
 		if (&other == this)
 			return false;
-		if (other.num_blocks == 0 && num_blocks == 0)
-			return false;
-		if (num_blocks == 0)
-			return other.sign > 0;
-		if (other.num_blocks == 0)
+		if (num_limbs == 0)
+			return other.num_limbs && other.sign > 0;
+		if (other.num_limbs == 0)
 			return sign < 0;
 		if (other.sign != sign)
 			return sign < other.sign;
-		if (other.exponent == exponent) {
-			if (other.num_blocks != num_blocks)
-				return num_blocks < other.num_blocks;
-			for (size_t i = 0; i < num_blocks; i++)
-				if (blocks[i] != other.blocks[i])
-					return blocks[i] < other.blocks[i];
-		}
-		decnumber<BT, ET> delta = (*this) - other;
-		if (delta.sign < 0)
-			return true;
-		return false;
+		int cmp = cmp_abs(other);
+		return sign > 0 ? cmp < 0 : cmp > 0;
 	}
 
 	bool operator<=(const decnumber<BT, ET> &other) const {
-		return (*this == other) || (*this < other);
+		return !(other < *this);
 	}
 
 	bool operator>(const decnumber<BT, ET> &other) const {
-		return !(*this <= other);
+		return other < *this;
+	}
+
+	/* Returns the decimal digits of i (i.e., without sign and exponent).
+	 */
+	std::string digits() const {
+		if (!num_limbs)
+			return "";
+		std::string ret = std::to_string(limbs[num_limbs - 1]);
+		ret.reserve(num_limbs * LIMB_DIGITS);
+		for (std::size_t i = num_limbs - 1; i-- > 0; ) {
+			char buf[LIMB_DIGITS];
+			BT limb = limbs[i];
+			for (unsigned j = LIMB_DIGITS; j-- > 0; ) {
+				buf[j] = (char)('0' + limb % 10);
+				limb /= 10;
+			}
+			ret.append(buf, LIMB_DIGITS);
+		}
+		return ret;
+	}
+
+	/* Returns this number rounded to at most the specified number of
+	 * significant digits, towards positive infinity if up is true, and
+	 * towards negative infinity otherwise.
+	 */
+	decnumber<BT, ET> round(std::size_t precision, bool up) const {
+		std::size_t d = num_digits();
+		if (d <= precision)
+			return *this;
+		std::size_t dropped = d - precision;
+		if (exponent > 0 && (ET)dropped > std::numeric_limits<ET>::max() - exponent)
+			throw std::overflow_error("Exponent out of range when rounding");
+		decnumber<BT, ET> ret(*this);
+		std::size_t shift = dropped / LIMB_DIGITS;
+		memmove(ret.limbs, ret.limbs + shift,
+		        (ret.num_limbs - shift) * sizeof(BT));
+		ret.num_limbs -= shift;
+		ret.div_small(pow10(dropped % LIMB_DIGITS));
+		/* Normalized numbers do not end in a zero, so some nonzero
+		 * digit was dropped.
+		 */
+		if (up == (sign > 0)) {
+			static const BT one = 1;
+			ret.resize(ret.num_limbs + 1);
+			add_limbs(ret.limbs, ret.num_limbs, &one, 1);
+		}
+		ret.exponent += (ET)dropped;
+		ret.normalize();
+		if (ret.num_limbs)
+			ret.sign = sign;
+		return ret;
 	}
 
 	std::string str() const {
-		if (!num_blocks)
+		if (!num_limbs)
 			return "0";
-		std::string ret;
-		decnumber<BT, ET> num(*this);
-		while (num.num_blocks) {
-			BT digit = num.blocks[num.num_blocks - 1] % 10;
-			ret = (char)('0' + digit) + ret;
-			num.divint(10);
-		}
-		if (exponent == 1)
-			ret += std::string("0");
-		else if (exponent == 2)
-			ret += std::string("00");
-		else if (exponent > 2) {
-			ret += std::string("e") + std::to_string(exponent);
+		std::string ret = digits();
+		if (exponent == 1) {
+			ret += "0";
+		} else if (exponent == 2) {
+			ret += "00";
+		} else if (exponent > 2) {
+			ret += "e" + std::to_string(exponent);
 		} else if (exponent < 0) {
 			uintmax_t neg_exponent = -(uintmax_t)exponent;
-			size_t digits = ret.size();
-			size_t dot_pos;
-			if (digits == neg_exponent) {
-				digits++;
-				neg_exponent = 0;
-				ret = "0" + ret;
-				dot_pos = 1;
-			} else if (digits == neg_exponent - 1) {
-				digits += 2;
-				neg_exponent = 0;
-				ret = "00" + ret;
-				dot_pos = 1;
-			} else if (digits == neg_exponent - 2) {
-				digits += 3;
-				neg_exponent = 0;
-				ret = "000" + ret;
-				dot_pos = 1;
+			uintmax_t digits = ret.size();
+			if (neg_exponent >= digits && neg_exponent <= digits + 2) {
+				ret = "0." + std::string(neg_exponent - digits, '0') + ret;
 			} else if (digits > neg_exponent) {
-				dot_pos = digits - neg_exponent;
-				neg_exponent = 0;
+				ret.insert(digits - neg_exponent, 1, '.');
 			} else {
-				dot_pos = 1;
-				neg_exponent -= digits - 1;
-			}
-			if (digits > 1) {
-				ret += ".";
-				while (digits > dot_pos) {
-					ret[digits] = ret[digits - 1];
-					ret[digits - 1] = '.';
-					digits--;
-				}
+				if (digits > 1)
+					ret.insert(1, 1, '.');
+				ret += "e-" + std::to_string(neg_exponent - (digits - 1));
 			}
-			if (neg_exponent)
-				ret += std::string("e-") + std::to_string(neg_exponent);
 		}
 		if (sign < 0)
 			return "-" + ret;
@@ -762,44 +832,97 @@ public:
 	}
 
 	explicit operator double() const {
-		return std::stod(str());
+		double ret;
+		if (to_float_exact(ret))
+			return ret;
+		return strtod(str().c_str(), nullptr);
+	}
+
+	explicit operator long double() const {
+		long double ret;
+		if (to_float_exact(ret))
+			return ret;
+		return strtold(str().c_str(), nullptr);
 	}
 
 	bool is_zero() const {
-		return num_blocks == 0;
+		return num_limbs == 0;
 	}
 
+	/* Divides this number by the specified integer. Only exact division
+	 * is supported, i.e. num may only have factors other than 2 and 5
+	 * that also divide i.
+	 */
 	void divint(BT num) {
-		if ((num < 0 && num < -base) || num > base)
-			throw std::invalid_argument("Division by numbers larger than the internal base is currently not supported.");
-		if (base % num)
-			throw std::invalid_argument("Divisor currently must be multiple of internal base.");
-		BT carry = 0;
-		if (num < 0) {
-			sign = -sign;
-			num = -num;
-		}
-		BT carry_mul = base / num;
-		for (std::size_t i = 0; i < num_blocks; i++) {
-			BT new_carry;
-			new_carry = blocks[i] % num;
-			blocks[i] /= num;
-			blocks[i] += carry * carry_mul;
-			carry = new_carry;
-		}
-		if (!num_blocks || blocks[0])
+		if (num == 0)
+			throw std::domain_error("Division by zero");
+		if (!num_limbs)
 			return;
-		num_blocks--;
-		if (!num_blocks) {
-			delete[] blocks;
-			blocks = nullptr;
-		} else {
-			BT *new_blocks = new BT[num_blocks];
-			memcpy(new_blocks, blocks + 1, num_blocks * sizeof(BT));
-			delete[] blocks;
-			blocks = new_blocks;
-		}
+		/* Dividing by 2^twos * 5^fives is multiplying by
+		 * 2^(c - twos) * 5^(c - fives) * 10^-c.
+		 */
+		unsigned twos = 0, fives = 0;
+		while (num % 2 == 0) {
+			num /= 2;
+			twos++;
+		}
+		while (num % 5 == 0) {
+			num /= 5;
+			fives++;
+		}
+		if (num > 1) {
+			if (num > std::numeric_limits<WT>::max() / base)
+				throw std::invalid_argument("Division by numbers this large is currently not supported.");
+			decnumber<BT, ET> quotient(*this);
+			if (quotient.div_small(num))
+				throw std::invalid_argument("Division result cannot be represented exactly.");
+			steal(quotient);
+		}
+		unsigned c = std::max(twos, fives);
+		if (exponent < std::numeric_limits<ET>::min() + (ET)c)
+			throw std::overflow_error("Exponent out of range when dividing");
+		for (unsigned i = twos; i < c; i++)
+			mul_small(2);
+		for (unsigned i = fives; i < c; i++)
+			mul_small(5);
+		exponent -= c;
+		normalize();
 	}
 };
 
+/* Elementary functions. These are not exact, but are calculated in long
+ * double precision, so the results are within a few units in the last
+ * place of a long double. Callers needing guaranteed bounds should widen
+ * the result accordingly.
+ */
+template <class BT, class ET>
+decnumber<BT, ET> exp(const decnumber<BT, ET> &x)
+{
+	return decnumber<BT, ET>(expl((long double)x));
+}
+
+/* Returns e^x - 1, without losing precision for x close to zero. */
+template <class BT, class ET>
+decnumber<BT, ET> expm1(const decnumber<BT, ET> &x)
+{
+	return decnumber<BT, ET>(expm1l((long double)x));
+}
+
+template <class BT, class ET>
+decnumber<BT, ET> log(const decnumber<BT, ET> &x)
+{
+	if (x <= decnumber<BT, ET>(0))
+		throw std::domain_error("Logarithm of non-positive number: " + x.str());
+	return decnumber<BT, ET>(logl((long double)x));
+}
+
+/* Returns ln(1 + x), without losing precision for x close to zero. */
+template <class BT, class ET>
+decnumber<BT, ET> log1p(const decnumber<BT, ET> &x)
+{
+	if (x <= decnumber<BT, ET>(-1))
+		throw std::domain_error("Logarithm of non-positive number: 1 + " + x.str());
+	return decnumber<BT, ET>(log1pl((long double)x));
+}
+
 #endif // DECNUMBER_H
@@ -0,0 +1,100 @@
+/*
+ * decnumber_bench.cpp
+ *
+ * Part of dft2lnt library - a library containing read/write operations for DFT
+ * files in Galileo format and translating DFT specifications into Lotos NT.
+ *
+ * Microbenchmark of the decnumber operations used when combining results,
+ * to be run by hand after changing decnumber.h:
+ *   make decnumber_bench && ./decnumber_bench [iterations]
+ *
+ * @author Enno Ruijters
+ */
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <functional>
+#include <string>
+#include <stdlib.h>
+#include "decnumber.h"
+
+typedef decnumber<> number;
+
+/* Keeps the compiler from optimizing the benchmarked operations away */
+static volatile std::size_t sink;
+
+static void bench(const std::string &name, long iterations,
+                  const std::function<void()> &op)
+{
+	auto start = std::chrono::steady_clock::now();
+	for (long i = 0; i < iterations; i++)
+		op();
+	auto end = std::chrono::steady_clock::now();
+	double ns = std::chrono::duration<double, std::nano>(end - start).count();
+	std::cout << std::left << std::setw(32) << name
+	          << std::right << std::setw(12) << std::fixed
+	          << std::setprecision(1) << ns / iterations << " ns/op"
+	          << std::endl;
+}
+
+/* A number with the specified number of significant digits */
+static number digits(std::size_t n, int exponent)
+{
+	std::string s;
+	for (std::size_t i = 0; i < n; i++)
+		s += (char)('1' + (i * 7) % 9);
+	return number(s + "e" + std::to_string(exponent));
+}
+
+int main(int argc, char **argv)
+{
+	long iterations = 100000;
+	if (argc > 1)
+		iterations = atol(argv[1]);
+	if (iterations <= 0) {
+		std::cerr << "Usage: " << argv[0] << " [iterations]" << std::endl;
+		return 1;
+	}
+
+	/* Typical results of the model checkers */
+	const std::string result = "0.0006535013297581376245";
+	const number p(result), q("0.99934649867024186237");
+	const number p40 = digits(40, -42), q40 = digits(40, -41);
+	const number big = digits(2000, -2000), big2 = digits(2000, -1990);
+
+	bench("parse (22 digits)", iterations, [&]() {
+		sink = number(result).is_zero();
+	});
+	bench("str (22 digits)", iterations, [&]() {
+		sink = p.str().size();
+	});
+	bench("str (2000 digits)", iterations / 100, [&]() {
+		sink = big.str().size();
+	});
+	bench("add (40 digits)", iterations, [&]() {
+		sink = (p40 + q40).is_zero();
+	});
+	bench("add (unaligned)", iterations, [&]() {
+		sink = (p + number(1)).is_zero();
+	});
+	bench("multiply (40 digits)", iterations, [&]() {
+		sink = (p40 * q40).is_zero();
+	});
+	bench("multiply (2000 digits)", iterations / 100, [&]() {
+		sink = (big * big2).is_zero();
+	});
+	bench("round (80 to 40 digits)", iterations, [&]() {
+		sink = (p40 * q40).round(40, true).is_zero();
+	});
+	bench("compare", iterations, [&]() {
+		sink = p40 < q40;
+	});
+	bench("to double", iterations, [&]() {
+		sink = (double)p > 0.5;
+	});
+	bench("from double", iterations, [&]() {
+		sink = number(0.1).is_zero();
+	});
+	return 0;
+}
@@ -21,6 +21,7 @@ class ASTAttribute;
 #define DFT_AST_H
 
 #include "dftnodes/nodes.h"
+#include "Arena.h"
 
 namespace DFT {
 namespace AST {
@@ -68,6 +69,14 @@ public:
 	
 	virtual ~ASTNode() {
 	}
+
+	/* ASTNodes are allocated in the current Arena, if any */
+	static void *operator new(size_t size) {
+		return DFT::Arena::allocate(size);
+	}
+	static void operator delete(void *p) {
+		DFT::Arena::deallocate(p);
+	}
 	
 	/**
 	 * Returns the type of this ASTNode.
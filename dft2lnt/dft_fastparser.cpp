@@ -0,0 +1,659 @@
+/*
+ * dft_fastparser.cpp
+ *
+ * Part of dft2lnt library - a library containing read/write operations for DFT
+ * files in Galileo format and translating DFT specifications into Lotos NT.
+ *
+ * @author Enno Ruijters
+ */
+
+#include "dft_fastparser.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctype.h>
+#include <memory>
+#include <string_view>
+#include <thread>
+#include <vector>
+#ifndef WIN32
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#endif
+#include "dftnodes/nodes.h"
+
+namespace {
+
+/* Parts smaller than this are not worth a thread of their own */
+const size_t MIN_PART_SIZE = 1 << 20;
+
+/**
+ * The location of the current token, tracked exactly as yylloc in
+ * lexer.l.lpp, so the AST gets the same locations.
+ */
+struct Position {
+	int firstLine, firstColumn, lastLine, lastColumn;
+
+	void step() {
+		firstLine = lastLine;
+		firstColumn = lastColumn;
+	}
+	void advance(size_t n) {
+		lastColumn += n;
+	}
+	void advanceLine() {
+		lastColumn = 1;
+		lastLine++;
+	}
+};
+
+enum TokenType {
+	TOKEN_END,
+	TOKEN_STRING,
+	TOKEN_REAL,
+	TOKEN_TOPLEVEL,
+	TOKEN_GATE,
+	TOKEN_VOTING,
+	TOKEN_INSPECTION,
+	TOKEN_REPLACEMENT,
+	TOKEN_ATTRIBUTE,
+	TOKEN_SEMICOLON,
+	TOKEN_EQUALS,
+	/* Anything only the generated parser handles */
+	TOKEN_UNSUPPORTED
+};
+
+struct Token {
+	TokenType type;
+	/// The text of the token, or the contents of a string
+	std::string_view text;
+	Position position;
+	/// The node type of a gate, or the label of an attribute
+	int kind;
+};
+
+struct Keyword {
+	const char *text;
+	TokenType type;
+	int kind;
+};
+
+/* In the order of the rules of the lexer, which decides ties */
+const Keyword keywords[] = {
+	{"toplevel", TOKEN_TOPLEVEL,    0},
+	{"page",     TOKEN_UNSUPPORTED, 0},
+	{"phase",    TOKEN_UNSUPPORTED, 0},
+	{"phasedor", TOKEN_GATE,        DFT::Nodes::GatePhasedOrType},
+	{"or",       TOKEN_GATE,        DFT::Nodes::GateOrType},
+	{"and",      TOKEN_GATE,        DFT::Nodes::GateAndType},
+	{"sand",     TOKEN_GATE,        DFT::Nodes::GateSAndType},
+	{"hsp",      TOKEN_GATE,        DFT::Nodes::GateHSPType},
+	{"wsp",      TOKEN_GATE,        DFT::Nodes::GateWSPType},
+	{"csp",      TOKEN_GATE,        DFT::Nodes::GateCSPType},
+	{"pand",     TOKEN_GATE,        DFT::Nodes::GatePAndType},
+	{"por",      TOKEN_GATE,        DFT::Nodes::GatePorType},
+	{"seq",      TOKEN_GATE,        DFT::Nodes::GateSeqType},
+	{"of",       TOKEN_UNSUPPORTED, 0},
+	{"fdep",     TOKEN_GATE,        DFT::Nodes::GateFDEPType},
+	{"ru",       TOKEN_GATE,        DFT::Nodes::RepairUnitType},
+	{"ru_f",     TOKEN_GATE,        DFT::Nodes::RepairUnitFcfsType},
+	{"ru_p",     TOKEN_GATE,        DFT::Nodes::RepairUnitPrioType},
+	{"ru_nd",    TOKEN_GATE,        DFT::Nodes::RepairUnitNdType},
+	{"insp",     TOKEN_UNSUPPORTED, 0},
+	{"rep",      TOKEN_UNSUPPORTED, 0},
+	{"accepts transfers from", TOKEN_GATE, DFT::Nodes::GateTransferType},
+	{"prob",     TOKEN_ATTRIBUTE,   DFT::Nodes::BE::AttrLabelProb},
+	{"lambda",   TOKEN_ATTRIBUTE,   DFT::Nodes::BE::AttrLabelLambda},
+	{"rate",     TOKEN_ATTRIBUTE,   DFT::Nodes::BE::AttrLabelRate},
+	{"shape",    TOKEN_ATTRIBUTE,   DFT::Nodes::BE::AttrLabelShape},
+	{"mean",     TOKEN_ATTRIBUTE,   DFT::Nodes::BE::AttrLabelMean},
+	{"stddev",   TOKEN_ATTRIBUTE,   DFT::Nodes::BE::AttrLabelStddev},
+	{"cov",      TOKEN_ATTRIBUTE,   DFT::Nodes::BE::AttrLabelCov},
+	{"res",      TOKEN_ATTRIBUTE,   DFT::Nodes::BE::AttrLabelRes},
+	{"repl",     TOKEN_ATTRIBUTE,   DFT::Nodes::BE::AttrLabelRepl},
+	{"dorm",     TOKEN_ATTRIBUTE,   DFT::Nodes::BE::AttrLabelDorm},
+	{"aph",      TOKEN_ATTRIBUTE,   DFT::Nodes::BE::AttrLabelAph},
+	{"phases",   TOKEN_ATTRIBUTE,   DFT::Nodes::BE::AttrLabelPhases},
+	{"maintain", TOKEN_ATTRIBUTE,   DFT::Nodes::BE::AttrLabelMaintain},
+	{"repair",   TOKEN_ATTRIBUTE,   DFT::Nodes::BE::AttrLabelRepair},
+	{"prio",     TOKEN_ATTRIBUTE,   DFT::Nodes::BE::AttrLabelPrio},
+	{"interval", TOKEN_ATTRIBUTE,   DFT::Nodes::BE::AttrLabelInterval},
+};
+
+/**
+ * Lexes and parses a part of a file that starts at the beginning of a
+ * statement (or of the file), following the rules of lexer.l.lpp and
+ * parser.y.ypp for correct statements.
+ */
+class PartParser {
+private:
+	const char *p, *end;
+	const std::string &fileName;
+	Position position;
+
+	char at(const char *q) const {
+		return q < end ? *q : '\0';
+	}
+
+	int get() {
+		return p < end ? (unsigned char)*p++ : EOF;
+	}
+
+	bool matchText(const char *q, const char *text) const {
+		size_t len = strlen(text);
+		return (size_t)(end - q) >= len && !memcmp(q, text, len);
+	}
+
+	size_t matchPosNumber(const char *q) const {
+		const char *start = q;
+		while (q < end && isdigit((unsigned char)*q))
+			q++;
+		return q - start;
+	}
+
+	size_t matchNumber(const char *q) const {
+		size_t sign = at(q) == '-' || at(q) == '+';
+		size_t n = matchPosNumber(q + sign);
+		return n ? sign + n : 0;
+	}
+
+	/* [-+]?digits([.]digits)? when signed, digits([.]digits)? if not */
+	size_t matchFraction(const char *q, size_t n) const {
+		if (n && at(q + n) == '.') {
+			size_t f = matchPosNumber(q + n + 1);
+			if (f)
+				n += 1 + f;
+		}
+		return n;
+	}
+
+	size_t matchRate(const char *q) const {
+		size_t n = matchFraction(q, matchPosNumber(q));
+		if (n && (at(q + n) == 'e' || at(q + n) == 'E')) {
+			size_t e = matchNumber(q + n + 1);
+			if (e)
+				n += 1 + e;
+		}
+		return n;
+	}
+
+	size_t matchRealExp(const char *q) const {
+		size_t n = matchFraction(q, matchNumber(q));
+		if (n && (at(q + n) == 'e' || at(q + n) == 'E')) {
+			size_t e = matchFraction(q + n + 1, matchNumber(q + n + 1));
+			if (e)
+				n += 1 + e;
+		}
+		return n;
+	}
+
+	Token token(TokenType type, const char *start, size_t length, int kind = 0) {
+		Token t;
+		t.type = type;
+		t.text = std::string_view(start, length);
+		t.kind = kind;
+		t.position = position;
+		return t;
+	}
+
+	/* The longest match of the rules for numbers, keywords and
+	 * identifiers, as flex would choose.
+	 */
+	Token lexWord() {
+		size_t best = 0;
+		TokenType type = TOKEN_UNSUPPORTED;
+		int kind = 0;
+		auto consider = [&](size_t length, TokenType t, int k) {
+			if (length > best) {
+				best = length;
+				type = t;
+				kind = k;
+			}
+		};
+		size_t n = matchNumber(p);
+		if (n && matchText(p + n, "of")) {
+			size_t m = matchNumber(p + n + 2);
+			if (m)
+				consider(n + 2 + m, TOKEN_VOTING, 0);
+		}
+		if (matchText(p + n, "insp")) {
+			size_t r = matchRate(p + n + 4);
+			if (r)
+				consider(n + 4 + r, TOKEN_INSPECTION, 0);
+		}
+		if (n && matchText(p + n, "rep")) {
+			size_t r = matchRate(p + n + 3);
+			if (r)
+				consider(n + 3 + r, TOKEN_REPLACEMENT, 0);
+		}
+		consider(matchRealExp(p), TOKEN_REAL, 0);
+		if (*p == '-')
+			consider(1, TOKEN_UNSUPPORTED, 0);
+		for (const Keyword &k : keywords) {
+			if (matchText(p, k.text))
+				consider(strlen(k.text), k.type, k.kind);
+		}
+		if (isalpha((unsigned char)*p) || *p == '_') {
+			const char *q = p + 1;
+			while (q < end && (isalnum((unsigned char)*q) || *q == '_'))
+				q++;
+			consider(q - p, TOKEN_UNSUPPORTED, 0);
+		}
+		if (best == 0)
+			return token(TOKEN_UNSUPPORTED, p, 0);
+		const char *start = p;
+		p += best;
+		position.advance(best);
+		return token(type, start, best, kind);
+	}
+
+	Token lexString() {
+		const char *start = p++;
+		while (p < end && *p != '"') {
+			/* Escape sequences are left to the generated lexer */
+			if (*p == '\\' || *p == '\0')
+				return token(TOKEN_UNSUPPORTED, start, 0);
+			p++;
+		}
+		if (p == end)
+			return token(TOKEN_UNSUPPORTED, start, 0);
+		p++;
+		position.advance(p - start);
+		return token(TOKEN_STRING, start + 1, p - start - 2);
+	}
+
+	/* Skips a comment after its opening, counting lines (and only
+	 * lines) as the lexer does.
+	 */
+	bool skipBlockComment() {
+		p += 2;
+		position.advance(2);
+		for (;;) {
+			int c;
+			while ((c = get()) != '*' && c != EOF && c != '\r' && c != '\n') {
+			}
+			if (c == '*') {
+				while ((c = get()) == '*') {
+				}
+				if (c == '/')
+					return true;
+			} else if (c == '\r') {
+				c = get();
+				position.advanceLine();
+				if (c != '\n' && c != EOF)
+					p--;
+			} else if (c == '\n') {
+				position.advanceLine();
+			}
+			/* The lexer warns about this */
+			if (c == EOF)
+				return false;
+		}
+	}
+
+	Token next() {
+		position.step();
+		for (;;) {
+			if (p == end)
+				return token(TOKEN_END, p, 0);
+			char c = *p;
+			if (c == '\n' || (c == '\r' && at(p + 1) == '\n')) {
+				size_t len = c == '\r' ? 2 : 1;
+				p += len;
+				position.advance(len);
+				position.advanceLine();
+				position.step();
+			} else if (c == ' ' || c == '\t') {
+				const char *start = p;
+				while (p < end && (*p == ' ' || *p == '\t'))
+					p++;
+				position.advance(p - start);
+				position.step();
+			} else if (c == '/' && at(p + 1) == '/') {
+				const char *q = p + 2;
+				while (q < end && *q != '\n' && *q != '\r')
+					q++;
+				if (at(q) == '\r' && at(q + 1) == '\n')
+					q += 2;
+				else if (at(q) == '\n')
+					q++;
+				else
+					return token(TOKEN_UNSUPPORTED, p, 0);
+				position.advance(q - p);
+				position.advanceLine();
+				p = q;
+			} else if (c == '/' && at(p + 1) == '*') {
+				if (!skipBlockComment())
+					return token(TOKEN_UNSUPPORTED, p, 0);
+			} else if (c == '"') {
+				return lexString();
+			} else if (c == ';' || c == '=') {
+				p++;
+				position.advance(1);
+				return token(c == ';' ? TOKEN_SEMICOLON : TOKEN_EQUALS, p - 1, 1);
+			} else if (c == 'L' && (at(p + 1) == '"' || at(p + 1) == '\'')) {
+				return token(TOKEN_UNSUPPORTED, p, 0);
+			} else {
+				return lexWord();
+			}
+		}
+	}
+
+	Location location(const Token &t) const {
+		return Location(fileName, t.position.firstLine, t.position.firstColumn,
+		                t.position.lastLine, t.position.lastColumn);
+	}
+
+	/* The location of a rule from its first to its last token */
+	Location location(const Token &first, const Token &last) const {
+		return Location(fileName, first.position.firstLine, first.position.firstColumn,
+		                last.position.lastLine, last.position.lastColumn);
+	}
+
+	DFT::AST::ASTIdentifier *identifier(const Token &t) const {
+		std::string str(t.text);
+		/* The lexer leaves out newlines in strings */
+		str.erase(std::remove(str.begin(), str.end(), '\n'), str.end());
+		return new DFT::AST::ASTIdentifier(location(t), str);
+	}
+
+	/* As the corresponding rules of the lexer and the gate rule */
+	DFT::AST::ASTGateType *gateType(const Token &t) const {
+		std::string text(t.text);
+		if (t.type == TOKEN_GATE) {
+			return new DFT::AST::ASTGateType(location(t), text,
+				(DFT::Nodes::NodeType)t.kind);
+		} else if (t.type == TOKEN_VOTING) {
+			if (!isdigit((unsigned char)text[0]) || text.size() > 100)
+				return NULL;
+			const char *src = text.c_str();
+			int k = atoi(src);
+			while (isdigit((unsigned char)*src))
+				src++;
+			src += 2;
+			int n = isdigit((unsigned char)*src) ? atoi(src) : 0;
+			return new DFT::AST::ASTVotingGateType(location(t), k, n);
+		} else if (t.type == TOKEN_INSPECTION) {
+			unsigned long n = 0;
+			char *insp = (char *)text.c_str();
+			if (*insp != 'i') {
+				n = strtoul(text.c_str(), &insp, 10);
+				/* The lexer warns about this */
+				if (n > INT_MAX || n == ULONG_MAX)
+					return NULL;
+			}
+			insp += 4;
+			return new DFT::AST::ASTInspectionType(location(t), n,
+				decnumber<>(std::string(insp)));
+		} else if (t.type == TOKEN_REPLACEMENT) {
+			if (!isdigit((unsigned char)text[0]) || text.size() > 100)
+				return NULL;
+			char buffer[101];
+			const char *src = text.c_str();
+			char *dst = buffer;
+			while (isdigit((unsigned char)*src))
+				*dst++ = *src++;
+			*dst = '\0';
+			int n = atoi(buffer);
+			/* Skips the first character of the rate, as the lexer */
+			src += 4;
+			dst = buffer;
+			if (src < text.c_str() + text.size()) {
+				while (ispunct((unsigned char)*src) || isdigit((unsigned char)*src))
+					*dst++ = *src++;
+			}
+			*dst = '\0';
+			return new DFT::AST::ASTReplacementType(location(t), n, atof(buffer));
+		}
+		return NULL;
+	}
+
+	DFT::AST::ASTNode *gate(const Token &name, const Token &type) {
+		std::unique_ptr<DFT::AST::ASTGateType> gt(gateType(type));
+		if (!gt)
+			return NULL;
+		/* Deletes the children parsed so far (ASTIdentifiers owns
+		 * its elements) on a syntax error.
+		 */
+		std::unique_ptr<DFT::AST::ASTIdentifiers> children(new DFT::AST::ASTIdentifiers());
+		for (;;) {
+			Token t = next();
+			if (t.type == TOKEN_SEMICOLON) {
+				return new DFT::AST::ASTGate(location(name, t), identifier(name),
+				                             gt.release(), children.release());
+			} else if (t.type != TOKEN_STRING) {
+				return NULL;
+			}
+			children->push_back(identifier(t));
+		}
+	}
+
+	DFT::AST::ASTNode *basicEvent(const Token &name, Token t) {
+		/* Likewise for the attributes and their values */
+		std::unique_ptr<DFT::AST::ASTAttributes> attributes(new DFT::AST::ASTAttributes());
+		for (;; t = next()) {
+			if (t.type == TOKEN_SEMICOLON) {
+				DFT::AST::ASTBasicEvent *be;
+				be = new DFT::AST::ASTBasicEvent(location(name, t), identifier(name));
+				be->setAttributes(attributes.release());
+				return be;
+			} else if (t.type != TOKEN_ATTRIBUTE || next().type != TOKEN_EQUALS) {
+				return NULL;
+			}
+			Token value = next();
+			DFT::AST::ASTAttrib *attrib;
+			if (value.type == TOKEN_REAL) {
+				std::string text(value.text);
+				double val;
+				sscanf(text.c_str(), "%lf", &val);
+				attrib = new DFT::AST::ASTAttribFloat(location(value), val, text);
+			} else if (value.type == TOKEN_STRING) {
+				attrib = new DFT::AST::ASTAttribString(location(value), identifier(value));
+			} else {
+				return NULL;
+			}
+			DFT::AST::ASTAttribute *attribute = new DFT::AST::ASTAttribute(location(t),
+				std::string(t.text), (DFT::Nodes::BE::AttributeLabelType)t.kind);
+			attribute->setValue(attrib);
+			attributes->push_back(attribute);
+		}
+	}
+
+	DFT::AST::ASTNode *statement(const Token &first) {
+		if (first.type == TOKEN_TOPLEVEL) {
+			Token name = next();
+			if (name.type != TOKEN_STRING)
+				return NULL;
+			Token semicolon = next();
+			if (semicolon.type != TOKEN_SEMICOLON)
+				return NULL;
+			return new DFT::AST::ASTTopLevel(location(first, semicolon), identifier(name));
+		} else if (first.type == TOKEN_STRING) {
+			Token t = next();
+			switch (t.type) {
+			case TOKEN_GATE:
+			case TOKEN_VOTING:
+			case TOKEN_INSPECTION:
+			case TOKEN_REPLACEMENT:
+				return gate(first, t);
+			default:
+				return basicEvent(first, t);
+			}
+		}
+		return NULL;
+	}
+
+public:
+	PartParser(const char *begin, const char *end, int line, const std::string &fileName)
+		:p(begin), end(end), fileName(fileName)
+	{
+		position.firstLine = position.lastLine = line;
+		position.firstColumn = position.lastColumn = 1;
+	}
+
+	/**
+	 * Parses the statements of the part.
+	 * @return false if the part contains anything unsupported.
+	 */
+	bool parse(DFT::AST::ASTNodes &nodes) {
+		for (;;) {
+			Token t = next();
+			if (t.type == TOKEN_END)
+				return true;
+			DFT::AST::ASTNode *node = statement(t);
+			if (!node)
+				return false;
+			nodes.push_back(node);
+		}
+	}
+
+	/**
+	 * Returns whether the part ended at the beginning of the specified
+	 * line, in the state in which the next part starts.
+	 */
+	bool endsAt(int line) const {
+		return position.firstLine == line && position.lastLine == line
+		       && position.firstColumn == 1 && position.lastColumn == 1;
+	}
+};
+
+struct Part {
+	const char *begin, *end;
+	int line;
+	/* The arena of the nodes if the caller uses one, only handed over
+	 * to the caller's arena once every part has been parsed, so that
+	 * nothing is left behind in it if the file is parsed again. It is
+	 * declared before the nodes, so it outlives them.
+	 */
+	std::unique_ptr<DFT::Arena> arena;
+	DFT::AST::ASTNodes nodes;
+	bool ok;
+	bool endsClean;
+};
+
+void parsePart(Part *part, int nextLine, const std::string *fileName)
+{
+	std::unique_ptr<DFT::Arena::Scope> scope;
+	if (part->arena)
+		scope.reset(new DFT::Arena::Scope(*part->arena));
+	PartParser parser(part->begin, part->end, part->line, *fileName);
+	part->ok = parser.parse(part->nodes);
+	part->endsClean = parser.endsAt(nextLine);
+}
+
+/* Finds the start of the first line after the specified position that
+ * follows the end of a statement.
+ */
+const char *findBoundary(const char *from, const char *begin, const char *end)
+{
+	while (from < end) {
+		const char *nl = (const char *)memchr(from, '\n', end - from);
+		if (!nl)
+			return end;
+		const char *q = nl;
+		if (q > begin && q[-1] == '\r')
+			q--;
+		if (q > begin && q[-1] == ';')
+			return nl + 1;
+		from = nl + 1;
+	}
+	return end;
+}
+
+} // Anonymous namespace
+
+static DFT::AST::ASTNodes *parseParts(const char *begin, const char *end,
+                                      const std::string &fileName,
+                                      unsigned threads)
+{
+	size_t size = end - begin;
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	size_t nParts = std::max((size_t)1, std::min((size_t)threads, size / MIN_PART_SIZE));
+
+	std::vector<const char *> bounds(1, begin);
+	for (size_t k = 1; k < nParts; k++) {
+		const char *b = findBoundary(std::max(bounds.back(), begin + size * k / nParts),
+		                             begin, end);
+		if (b < end && b > bounds.back())
+			bounds.push_back(b);
+	}
+	bounds.push_back(end);
+
+	std::vector<Part> parts(bounds.size() - 1);
+	int line = 1;
+	for (size_t i = 0; i < parts.size(); i++) {
+		parts[i].begin = bounds[i];
+		parts[i].end = bounds[i + 1];
+		parts[i].line = line;
+		if (i + 1 < parts.size())
+			line += std::count(bounds[i], bounds[i + 1], '\n');
+	}
+
+	DFT::Arena *arena = DFT::Arena::getCurrent();
+	if (arena) {
+		for (Part &part : parts)
+			part.arena.reset(new DFT::Arena());
+	}
+	std::vector<std::thread> workers;
+	for (size_t i = 1; i < parts.size(); i++) {
+		workers.emplace_back(parsePart, &parts[i], i + 1 < parts.size() ? parts[i + 1].line : 0,
+		                     &fileName);
+	}
+	parsePart(&parts[0], parts.size() > 1 ? parts[1].line : 0, &fileName);
+	for (std::thread &t : workers)
+		t.join();
+
+	for (size_t i = 0; i < parts.size(); i++) {
+		/* The last part starts where the previous one ended, so its
+		 * errors are real.
+		 */
+		if (i + 1 == parts.size() && !parts[i].ok)
+			return NULL;
+		/* A part boundary in the middle of a comment or string (or
+		 * one that counts lines differently): parse the file in one
+		 * go.
+		 */
+		if (!parts[i].ok || (i + 1 < parts.size() && !parts[i].endsClean)) {
+			/* Free the nodes parsed so far (and their arenas)
+			 * first, rather than keeping two ASTs in memory.
+			 */
+			parts.clear();
+			return parseParts(begin, end, fileName, 1);
+		}
+	}
+
+	DFT::AST::ASTNodes *ret = new DFT::AST::ASTNodes();
+	for (Part &part : parts) {
+		ret->insert(ret->end(), part.nodes.begin(), part.nodes.end());
+		part.nodes.clear();
+		if (part.arena)
+			arena->adopt(*part.arena);
+	}
+	return ret;
+}
+
+DFT::AST::ASTNodes* FastParser::parse(unsigned threads)
+{
+#ifdef WIN32
+	return NULL;
+#else
+	struct stat st;
+	if (fstat(fd, &st) || !S_ISREG(st.st_mode))
+		return NULL;
+	size_t size = st.st_size;
+	if (size == 0)
+		return new DFT::AST::ASTNodes();
+	void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED)
+		return NULL;
+	madvise(map, size, MADV_SEQUENTIAL);
+	const char *data = (const char *)map;
+	DFT::AST::ASTNodes *ret = parseParts(data, data + size, fileName, threads);
+	munmap(map, size);
+	return ret;
+#endif
+}
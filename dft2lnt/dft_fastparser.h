@@ -0,0 +1,54 @@
+/*
+ * dft_fastparser.h
+ *
+ * Part of dft2lnt library - a library containing read/write operations for DFT
+ * files in Galileo format and translating DFT specifications into Lotos NT.
+ *
+ * @author Enno Ruijters
+ */
+
+class FastParser;
+
+#ifndef DFT_FASTPARSER_H
+#define DFT_FASTPARSER_H
+
+#include <string>
+#include "dft_ast.h"
+
+/**
+ * Parser for large, machine-generated Galileo files, as an alternative to
+ * the generated lexer and parser (see Parser). The file is memory-mapped
+ * and tokenized in place, without copying every token, and split at the
+ * ends of statements into parts that are parsed in parallel.
+ *
+ * Only correct files using the statements in common use (the toplevel,
+ * gates and basic events with their attributes) are parsed, with the
+ * same AST and locations as Parser would produce. Anything else,
+ * including every syntax error, is left to Parser, which reports the
+ * errors.
+ */
+class FastParser {
+private:
+	int fd;
+	std::string fileName;
+
+public:
+	/**
+	 * Constructs a parser for the opened file with the specified
+	 * descriptor, which is not closed by the parser.
+	 * @param fileName The name of the file, used in locations.
+	 */
+	FastParser(int fd, std::string fileName): fd(fd), fileName(fileName) {
+	}
+
+	/**
+	 * Parses the file, using at most the specified number of threads
+	 * (0 for one per processor).
+	 * @return The list of ASTNodes parsed from the file, or NULL if the
+	 * 	file should be parsed by Parser instead (e.g., because it
+	 * 	is not a regular file or contains a syntax error).
+	 */
+	DFT::AST::ASTNodes* parse(unsigned threads = 0);
+};
+
+#endif // DFT_FASTPARSER_H
@@ -13,7 +13,8 @@
 
 using namespace std;
 
-Parser* pp = NULL;
+/* The active parser of this thread, parsers can run in different threads */
+thread_local Parser* pp = NULL;
 
 #include "lexer.l.h"
 #include "yyheader.h"
@@ -70,6 +71,7 @@ DFT::AST::ASTNodes* Parser::parse() {
 	
 	// Free the lexer
 	yylex_destroy(scanner);
+	pp = NULL;
 	
 	return result_nodes;//new Program(ASTroot);
 }
@@ -23,7 +23,7 @@ class Parser;
 
 using namespace std;
 
-extern Parser* pp;
+extern thread_local Parser* pp;
 
 /* An opaque pointer. */
 #ifndef YY_TYPEDEF_YY_SCANNER_T
@@ -17,6 +17,7 @@ class Node;
 #include <vector>
 
 #include "dft_parser_location.h"
+#include "Arena.h"
 
 using namespace std;
 
@@ -187,6 +188,14 @@ public:
 	}
 	virtual ~Node() {
 	}
+
+	/* Nodes are allocated in the current Arena, if any */
+	static void *operator new(size_t size) {
+		return DFT::Arena::allocate(size);
+	}
+	static void operator delete(void *p) {
+		DFT::Arena::deallocate(p);
+	}
 	
 	/**
 	 * Returns the name of this Node.
@@ -307,15 +316,6 @@ public:
 	bool matchesType(NodeType otherType) const {return typeMatch(type, otherType);}
 	bool hasInspectionModule(void) const;
 	bool hasRepairModule(void) const;
-
-	/* A node is an independent subtree if:
-	 * - It has exactly one parent.
-	 * - The set of nodes that is reachable (via parent/child
-	 *   relationships) from the node without visiting its parent is
-	 *   disjoint from the set of nodes that is reachable from the
-	 *   parent without visiting this node.
-	 */
-	bool isIndependentSubtree(void) const;
 };
 
 } // Namespace: Nodes
@@ -0,0 +1,123 @@
+/*
+ * interval.h
+ *
+ * Part of dft2lnt library - a library containing read/write operations for DFT
+ * files in Galileo format and translating DFT specifications into Lotos NT.
+ *
+ * @author Enno Ruijters
+ */
+
+#ifndef INTERVAL_H
+#define INTERVAL_H
+
+#include "decnumber.h"
+
+/**
+ * A closed interval of decimal numbers, used to calculate with bounds on
+ * a value. The bounds are kept to a limited number of significant digits,
+ * and rounded outward after every operation, so the result of a
+ * calculation always contains the exact result while each operation takes
+ * constant time (exact decnumber products keep growing).
+ */
+class interval
+{
+private:
+	decnumber<> lo, hi;
+
+	interval &roundOutward() {
+		lo = lo.round(PRECISION, false);
+		hi = hi.round(PRECISION, true);
+		return *this;
+	}
+
+public:
+	/// Number of significant digits kept of each bound
+	static const std::size_t PRECISION = 40;
+
+	/**
+	 * Creates the interval containing only the specified value (rounded
+	 * outward to the precision).
+	 */
+	interval(const decnumber<> &value)
+		:lo(value), hi(value)
+	{
+		roundOutward();
+	}
+
+	/**
+	 * Creates the interval [lower, upper] (rounded outward to the
+	 * precision).
+	 */
+	interval(const decnumber<> &lower, const decnumber<> &upper)
+		:lo(lower), hi(upper)
+	{
+		if (upper < lower)
+			throw std::invalid_argument("Empty interval [" + lower.str() + ", " + upper.str() + "]");
+		roundOutward();
+	}
+
+	const decnumber<> &lower() const { return lo; }
+	const decnumber<> &upper() const { return hi; }
+
+	interval operator+(const interval &other) const {
+		interval ret(*this);
+		ret += other;
+		return ret;
+	}
+
+	interval &operator+=(const interval &other) {
+		lo += other.lo;
+		hi += other.hi;
+		return roundOutward();
+	}
+
+	interval operator-(const interval &other) const {
+		interval ret(*this);
+		ret -= other;
+		return ret;
+	}
+
+	interval &operator-=(const interval &other) {
+		decnumber<> newLo = lo - other.hi;
+		hi = hi - other.lo;
+		lo = std::move(newLo);
+		return roundOutward();
+	}
+
+	interval operator*(const interval &other) const {
+		interval ret(*this);
+		ret *= other;
+		return ret;
+	}
+
+	interval &operator*=(const interval &other) {
+		const decnumber<> zero(0);
+		if (zero <= lo && zero <= other.lo) {
+			/* The common case: probabilities */
+			lo *= other.lo;
+			hi *= other.hi;
+			return roundOutward();
+		}
+		decnumber<> products[] = {lo * other.lo, lo * other.hi,
+		                          hi * other.lo, hi * other.hi};
+		lo = products[0];
+		hi = products[0];
+		for (const decnumber<> &p : products) {
+			if (p < lo)
+				lo = p;
+			if (hi < p)
+				hi = p;
+		}
+		return roundOutward();
+	}
+
+	/**
+	 * Returns 1 - this, the probability of the complement of an event
+	 * with this probability.
+	 */
+	interval complement() const {
+		return interval(decnumber<>(1)) - *this;
+	}
+};
+
+#endif // INTERVAL_H
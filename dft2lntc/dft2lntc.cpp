@@ -14,6 +14,8 @@
 #include <stdarg.h>
 #include <string>
 #include <fstream>
+#include <sstream>
+#include <memory>
 #include <sys/stat.h>
 #include <sys/types.h>
 
@@ -30,21 +32,16 @@
 #include "dft_parser.h"
 #include "dft_ast.h"
 #include "ASTPrinter.h"
-#include "ASTValidator.h"
-#include "ASTDFTBuilder.h"
 #include "FileSystem.h"
 #include "dft2lnt.h"
 #include "DFTree.h"
-#include "DFTreeValidator.h"
 #include "DFTreePrinter.h"
-#ifdef HAVE_CADP
-#include "DFTreeBCGNodeBuilder.h"
-#endif
-#include "DFTreeAUTNodeBuilder.h"
-#include "DFTreeEXPBuilder.h"
+#include "files.h"
 #include "compiletime.h"
 #include "Settings.h"
 #include "modularize.h"
+#include "translator.h"
+#include "Trace.h"
 
 FILE* pp_outputFile = stdout;
 
@@ -66,6 +63,8 @@ void print_help(MessageFormatter* messageFormatter, string topic="") {
 		messageFormatter->notify ("Debug Options:");
 		messageFormatter->message("  -a FILE         Output AST to file. '-' for stdout.");
 		messageFormatter->message("  -t FILE         Output DFT to file. '-' for stdout.");
+		messageFormatter->message("  --no-fast-parser Always use the generated parser, e.g. to compare");
+		messageFormatter->message("                  its AST (see -a) with that of the fast parser.");
 		messageFormatter->message("  --verbose=x     Set verbosity to x, -1 <= x <= 5.");
 		messageFormatter->message("  -v, --verbose   Increase verbosity. Up to 5 levels.");
 		messageFormatter->message("  -q              Decrease verbosity.");
@@ -73,6 +72,8 @@ void print_help(MessageFormatter* messageFormatter, string topic="") {
 		messageFormatter->notify ("Output Options:");
 		messageFormatter->message("  -o FILE         Output EXP to <FILE>.exp and SVL to <FILE>.svl.");
 		messageFormatter->message("  -m FILE         Output module description to <FILE>, '-' for stdout.");
+		messageFormatter->message("  -M DIR          Output module description and the EXP and SVL of every");
+		messageFormatter->message("                  module to DIR, as <INPUT>.mod and <INPUT>@<root>.exp/svl.");
 		messageFormatter->message("  -x FILE         Output EXP to file. '-' for stdout. Overrules -o.");
 		messageFormatter->message("  -s FILE         Output SVL to file. '-' for stdout. Overrules -o.");
 		messageFormatter->message("  -b FILE         Output of SVL to this BCG file. Overrules -o.");
@@ -82,6 +83,8 @@ void print_help(MessageFormatter* messageFormatter, string topic="") {
 		messageFormatter->message("                  embedded bcg files mentioned as aph attributes");
 		messageFormatter->message("                  (used by dftcalc; not intented to be used directly by user).");
 		messageFormatter->message("  --warn-code     Return non-zero if there are one or more warnings.");
+		messageFormatter->message("  --trace FILE    Write the time spent in each stage to FILE, in the");
+		messageFormatter->message("                  Chrome trace event format.");
 		messageFormatter->flush();
 	} else if(topic=="topics") {
 		messageFormatter->notify ("Help topics:");
@@ -109,54 +112,6 @@ void print_version(MessageFormatter* messageFormatter) {
 	messageFormatter->flush();
 }
 
-static std::string getCache(CompilerContext* compilerContext) {
-	std::string root;
-#ifdef WIN32
-	PWSTR rootStr;
-	HRESULT hr = SHGetKnownFolderPath(FOLDERID_LocalAppData, 0, NULL, &rootStr);
-	if (!SUCCEEDED(hr)) {
-		compilerContext->reportError("Unable to lookup Application Data directory");
-		exit(EXIT_FAILURE);
-	}
-	char bytes[MAX_PATH];
-	WideCharToMultiByte(CP_ACP, 0, rootStr, -1, bytes, sizeof(bytes), NULL, NULL);
-	std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
-	CoTaskMemFree(rootStr);
-	root = std::string(bytes);
-#elif defined __APPLE__
-	root = std::getenv("HOME");
-	root += "/Library/Caches";
-#else
-	root = std::getenv("HOME");
-	root += "/.cache";
-	if (!FileSystem::isDir(File(root))) {
-		if (FileSystem::mkdir(File(root))) {
-			compilerContext->reportError("Could not create cache root directory (" + root + ")");
-			return "";
-		}
-	}
-#endif
-	/* End of OS-specific part */
-
-	std::string cache = root + "/dftcalc";
-	if (!FileSystem::isDir(File(cache))) {
-		if (FileSystem::mkdir(File(cache))) {
-			compilerContext->reportError("Could not create cache directory (" + cache + ")");
-			return "";
-		}
-	}
-
-	std::string autDir = cache + DFT2LNT::AUT_CACHE_DIR;
-	if (!FileSystem::isDir(File(autDir))) {
-		if (FileSystem::mkdir(File(autDir))) {
-			compilerContext->reportError("Could not create .aut directory (" + autDir + ")");
-			return "";
-		}
-	}
-
-	return cache;
-}
-
 std::string getRoot(CompilerContext* compilerContext) {
 	char* root = getenv((const char*)"DFT2LNTROOT");
 	std::string dft2lntRoot = root?string(root):"";
@@ -215,6 +170,92 @@ end:
 	return dft2lntRoot;
 }
 
+/**
+ * Writes the static modules of the DFT, and translates every module that
+ * has to be analysed separately. The DFT is only parsed once, each module
+ * is loaded from it.
+ * @param translator The translator that loaded the (valid) DFT.
+ * @param dir The directory to write the files to.
+ * @param name The module description is written to <name>.mod, the module
+ * 	rooted at node X to <name>@X.exp and <name>@X.svl.
+ * @return 0 if successful, non-zero otherwise
+ */
+static int writeModuleDir(DFT::Translator &translator, const std::string &dir,
+                          const std::string &name,
+                          const std::vector<std::string> &failedBEs,
+                          const std::string &dft2lntRoot,
+                          const std::string &cacheDir,
+                          CompilerContext *cc, Trace *trace)
+{
+	if (!FileSystem::isDir(File(dir)) && FileSystem::mkdir(File(dir))) {
+		cc->reportError("Could not create module directory (" + dir + ")");
+		cc->flush();
+		return 1;
+	}
+	/* Checks the evidence against the whole DFT, each module takes the
+	 * part of it that is in the module.
+	 */
+	if (!failedBEs.empty() && translator.applyEvidence(failedBEs))
+		return 1;
+	cc->reportAction("Writing static modules...",VERBOSITY_FLOW);
+	std::stringstream modules;
+	{
+		Trace::Span span(trace, "modularize", "dft2lntc");
+		span.addArg("nodes", translator.getDFT()->getNodes().size());
+		writeModules(modules, translator.getDFT());
+	}
+	std::string modFileName = dir + "/" + name + ".mod";
+	std::ofstream modFile(modFileName);
+	modFile << modules.str();
+	if (!modFile.good()) {
+		cc->reportError("Could not write `" + modFileName + "'");
+		cc->flush();
+		return 1;
+	}
+
+	std::string line;
+	while (std::getline(modules, line)) {
+		std::string root;
+		if (line.size() > 1 && line[0] == 'M' && line[1] == '#')
+			root = line.substr(line.find(' ') + 1);
+		else if (!line.empty() && line[0] == 'M')
+			root = line.substr(1);
+		else if (!line.empty() && line[0] == 'E')
+			root = line.substr(line.find(' ') + 1);
+		else
+			continue;
+		std::string base = dir + "/" + name + "@" + root;
+		cc->reportAction("Translating module " + root + "...",VERBOSITY_FLOW);
+		cc->flush();
+		DFT::Translator module(cc, trace);
+		std::stringstream exp, svl;
+		if (module.loadModule(translator, root)
+		    || (!failedBEs.empty() && module.applyEvidence(failedBEs, true)))
+		{
+			return 1;
+		}
+		module.transform();
+		if (module.generateAutomata(dft2lntRoot, cacheDir)
+		    || module.buildEXP(dft2lntRoot, base + "." + DFT::FileExtensions::BCG,
+		                       base + "." + DFT::FileExtensions::EXP, exp, svl))
+		{
+			return 1;
+		}
+		std::ofstream expFile(base + "." + DFT::FileExtensions::EXP);
+		expFile << exp.str();
+		std::ofstream svlFile(base + "." + DFT::FileExtensions::SVL);
+		svlFile << svl.str();
+		if (!expFile.good() || !svlFile.good()) {
+			cc->reportError("Could not write the files of module " + root);
+			cc->flush();
+			return 1;
+		}
+	}
+	cc->reportAction("Done writing static modules.",VERBOSITY_FLOW);
+	cc->flush();
+	return cc->getErrors() > 0;
+}
+
 int main(int argc, char** argv) {
 	/* Set defaults */
 	Settings default_settings;
@@ -242,7 +283,11 @@ int main(int argc, char** argv) {
 	int    outputBCGFileSet  = 0;
 	string outputMODFileName = "";
 	int    outputMODFileSet  = 0;
+	string outputMODDirName  = "";
+	int    outputMODDirSet   = 0;
 	string rootNode          = "";
+	string traceFileName     = "";
+	bool   useFastParser     = true;
 
 	int useColoredMessages   = 1;
 	int verbosity            = 0;
@@ -280,6 +325,10 @@ int main(int argc, char** argv) {
 			// -m FILE
 			outputMODFileName = string(argv[++argi]);
 			outputMODFileSet = 1;
+		} else if (!strcmp(argv[argi], "-M")) {
+			// -M DIR
+			outputMODDirName = string(argv[++argi]);
+			outputMODDirSet = 1;
 		} else if (!strcmp(argv[argi], "-n")) {
 			// -n FILENAME
 			origFileName = string(argv[++argi]);
@@ -337,7 +386,7 @@ int main(int argc, char** argv) {
 					break;
 				begin = end + 1;
 			}
-		} else if (!strcmp(argv[argi], "-e")) {
+		} else if (!strcmp(argv[argi], "-r")) {
 			rootNode = string(argv[++argi]);
 		} else if(!strcmp("--help", argv[argi])) {
 			printHelp = true;
@@ -355,6 +404,11 @@ int main(int argc, char** argv) {
 			useColoredMessages = false;
 		} else if(!strcmp("--warn-code", argv[argi])) {
 			settings["warn-code"] = "1";
+		} else if(!strcmp("--trace", argv[argi])) {
+			// --trace FILE
+			traceFileName = string(argv[++argi]);
+		} else if(!strcmp("--no-fast-parser", argv[argi])) {
+			useFastParser = false;
 		}
 	}
 	for (; argi < argc; argi++) {
@@ -440,24 +494,20 @@ int main(int argc, char** argv) {
 	std::string dft2lntRoot = getRoot(&compilerContext);
 	bool rootValid = dft2lntRoot!="";
 
-	std::string cacheDir = getCache(&compilerContext);
+	std::string cacheDir = DFT::Translator::getCacheDir(&compilerContext);
 	if (cacheDir == "") {
 		compilerContext.flush();
 		return EXIT_FAILURE;
 	}
 
+	std::unique_ptr<Trace> trace;
+	if (!traceFileName.empty())
+		trace.reset(new Trace("dft2lntc " + parserInputFilePath));
+	DFT::Translator translator(&compilerContext, trace.get());
+	translator.setFastParser(useFastParser);
+
 	/* Parse input file */
-	compilerContext.notify("Checking syntax...",VERBOSITY_FLOW);
-	Parser* parser = new Parser(inputFile,parserInputFilePath,&compilerContext);
-	DFT::AST::ASTNodes* ast = parser->parse();
-	compilerContext.flush();
-	if(!ast || compilerContext.getErrors()>0) {
-		compilerContext.reportError("Syntax is incorrect");
-		ast = 0;
-	} else {
-		compilerContext.reportAction("Syntax is correct",VERBOSITY_FLOW);
-	}
-	compilerContext.flush();
+	DFT::AST::ASTNodes* ast = translator.parse(inputFile, parserInputFilePath);
 
 	/* Print AST */
 	if(ast && outputASTFileSet) {
@@ -476,65 +526,33 @@ int main(int argc, char** argv) {
 	compilerContext.flush();
 	
 	/* Validate input */
-	int astValid = false;
-	if(ast) {
-		compilerContext.notify("Validating AST...",VERBOSITY_FLOW);
-		compilerContext.flush();
-		DFT::ASTValidator validator(ast, &compilerContext);
-		astValid = validator.validate();
-		if(!astValid) {
-			compilerContext.reportError("AST invalid");
-		} else {
-			compilerContext.reportAction("AST is valid",VERBOSITY_FLOW);
-		}
-	}
-	compilerContext.flush();
+	int astValid = ast && !translator.validateAST();
 	
 	/* Create DFT */
-	DFT::DFTree* dft = NULL;
-	if(astValid) {
-		compilerContext.notify("Building DFT...",VERBOSITY_FLOW);
-		compilerContext.flush();
-		DFT::ASTDFTBuilder builder(ast, &compilerContext);
-		dft = builder.build();
-		if(!dft) {
-			compilerContext.reportError("Could not build DFT");
-		} else {
-			compilerContext.reportAction("DFT built successfully",VERBOSITY_FLOW);
-		}
-	}
-	compilerContext.flush();
+	DFT::DFTree* dft = astValid ? translator.buildDFT() : NULL;
 
 	/* Validate DFT */
-	int dftValid = false;
-	if(dft) {
-		compilerContext.notify("Validating DFT...",VERBOSITY_FLOW);
-		compilerContext.flush();
-		DFT::DFTreeValidator validator(dft, &compilerContext);
-		dftValid = validator.validate();
-		if(!dftValid) {
-			compilerContext.reportError("DFT invalid");
-		} else {
-			compilerContext.reportAction("DFT is valid",VERBOSITY_FLOW);
-		}
-	}
-	compilerContext.flush();
-
-	if (!rootNode.empty()) {
-		DFT::Nodes::Node *newRoot = dft->getNode(rootNode);
-		if (newRoot == nullptr) {
-			compilerContext.reportError("Root node " + rootNode + " does not exist.");
-			compilerContext.flush();
-			return 1;
-		}
-		dft->setTopNode(newRoot);
-		dft->removeUnreachable();
+	int dftValid = dft && !translator.validateDFT();
+
+	if (!rootNode.empty() && translator.setRoot(rootNode))
+		return 1;
+
+	if (dftValid && outputMODDirSet) {
+		int res = writeModuleDir(translator, outputMODDirName,
+		                         inputFileSet ? File(inputFileName).getFileBase() : outputFileName,
+		                         failedBEs, dft2lntRoot, cacheDir,
+		                         &compilerContext, trace.get());
+		if (trace)
+			trace->write(File(traceFileName));
+		return res;
 	}
 
 	if (dftValid && outputMODFileSet) {
 		compilerContext.reportAction("Writing static modules...",VERBOSITY_FLOW);
 		compilerContext.flush();
 		try {
+			Trace::Span span(trace.get(), "modularize", "dft2lntc");
+			span.addArg("nodes", dft->getNodes().size());
 			writeModules(outputMODFileName, dft);
 		} catch(std::vector<std::string>& errors) {
 			for(std::string e: errors) {
@@ -543,50 +561,18 @@ int main(int argc, char** argv) {
 			compilerContext.flush();
 		}
 		compilerContext.reportAction("Done writing static modules.",VERBOSITY_FLOW);
+		if (trace)
+			trace->write(File(traceFileName));
 		return 0;
 	}
 	
 	/* Apply evidence to DFT */
-	if(dftValid && !failedBEs.empty()) {
-		compilerContext.reportAction("Applying evidence to DFT...",VERBOSITY_FLOW);
-		compilerContext.flush();
-		try {
-			dft->applyEvidence(failedBEs);
-		} catch(std::vector<std::string>& errors) {
-			for(std::string e: errors) {
-				compilerContext.reportError(e);
-			}
-			compilerContext.flush();
-		}
-	}
-    
-	/* Add repair knowledge to gates */
-	if(dft) {
-		compilerContext.reportAction("Applying repair knowledge to DFT gates...",VERBOSITY_FLOW);
-		compilerContext.flush();
-		dft->addRepairInfo();
-		compilerContext.reportAction("Done applying repair knowledge to DFT gates...",VERBOSITY_FLOW);
-	}
+	if(dftValid && !failedBEs.empty())
+		translator.applyEvidence(failedBEs);
 
-	if(dft) {
-		/* Add always-active knowledge to gates */
-		compilerContext.reportAction("Applying always-active knowledge to DFT gates...",VERBOSITY_FLOW);
-		compilerContext.flush();
-		dft->addAlwaysActiveInfo();
-		compilerContext.reportAction("Done applying always-active knowledge to DFT gates...",VERBOSITY_FLOW);
-    
-		/* Remove superflous FDEP edges */
-        compilerContext.reportAction("Applying FDEP cleanup to DFT gates...",VERBOSITY_FLOW);
-        compilerContext.flush();
-        dft->checkFDEPInfo();
-        compilerContext.reportAction("Done applying FDEP cleanup to DFT gates...",VERBOSITY_FLOW);
-
-		/* Replace sequence enforcers by SAND gates when possible. */
-        compilerContext.reportAction("Applying SEQ cleanup to DFT gates...",VERBOSITY_FLOW);
-        compilerContext.flush();
-        dft->replaceSEQs();
-        compilerContext.reportAction("Done applying SEQ cleanup to DFT gates...",VERBOSITY_FLOW);
-    }
+	/* Add repair, always-active, FDEP and SEQ knowledge to gates */
+	if(dft)
+		translator.transform();
 
 	/* Printing DFT */
 	if(dftValid && outputDFTFileSet) {
@@ -607,44 +593,24 @@ int main(int argc, char** argv) {
 
 	/* Building needed BCG files for DFT */
 	if(rootValid && dftValid) {
-		compilerContext.notify("Building needed AUT files...",VERBOSITY_FLOW);
-		compilerContext.flush();
-		DFT::DFTreeAUTNodeBuilder autBuilder(cacheDir, dft, &compilerContext);
-		DFT::DFTreeNodeBuilder *nodeBuilder = &autBuilder;
-#ifdef HAVE_CADP
-		DFT::DFTreeBCGNodeBuilder bcgBuilder(dft2lntRoot,dft, &compilerContext);
-		if (autBuilder.generate()) {
-			compilerContext.notify("Unable to make AUT files, building needed BCG files...",VERBOSITY_FLOW);
-			bcgBuilder.generate();
-			nodeBuilder = &bcgBuilder;
-		}
-#else
-		if (autBuilder.generate()) {
-			compilerContext.reportError("Unable to create AUT files.");
-		}
-#endif
+		translator.generateAutomata(dft2lntRoot, cacheDir);
 		if (outputFileSet) {
 			/* Building EXP out of DFT */
-			compilerContext.notify("Building EXP...",VERBOSITY_FLOW);
-			compilerContext.flush();
-			DFT::DFTreeEXPBuilder builder(dft2lntRoot,".",outputBCGFileName,outputEXPFileName,dft, nodeBuilder, &compilerContext);
-			builder.build();
+			std::stringstream exp, svl;
+			translator.buildEXP(dft2lntRoot, outputBCGFileName,
+			                    outputEXPFileName, exp, svl);
 
 			if(outputSVLFileName!="") {
 				std::ofstream svlFile (outputSVLFileName);
-				builder.printSVL(svlFile);
+				svlFile << svl.str();
 			} else {
-				std::stringstream out;
-				builder.printSVL(out);
-				compilerContext.reportFile("SVL",out.str());
+				compilerContext.reportFile("SVL",svl.str());
 			}
 			if(outputEXPFileName!="") {
 				std::ofstream expFile (outputEXPFileName);
-				builder.printEXP(expFile);
+				expFile << exp.str();
 			} else {
-				std::stringstream out;
-				builder.printEXP(out);
-				compilerContext.reportFile("EXP",out.str());
+				compilerContext.reportFile("EXP",exp.str());
 			}
 
 		}
@@ -659,9 +625,8 @@ int main(int argc, char** argv) {
 		compilerContext.flush();
 	}
 	
-	if(ast) delete ast;
-	if(dft) delete dft;
-	delete parser;
+	if (trace && trace->write(File(traceFileName)))
+		compilerContext.reportWarning("Could not write trace file `" + traceFileName + "'");
 	
 	if(settings["warn-code"] && compilerContext.getWarnings()>0) {
 		return EXIT_FAILURE;
@@ -1,18 +1,182 @@
 #include "modularize.h"
+#include "DFTreeHasher.h"
+#include "DFTreeModules.h"
 #include "dftnodes/nodes.h"
 #include <ostream>
 #include <fstream>
+#include <unordered_set>
 #include <vector>
 
-static void writeModules(std::ostream &out, DFT::DFTree *dft, DFT::Nodes::Node *root)
+/* Whether the basic event simply fails after an exponentially distributed
+ * time (so its probability of having failed can be calculated directly).
+ */
+static bool isExponential(DFT::Nodes::BasicEvent *be)
+{
+	return be->getMode() == DFT::Nodes::BE::CalculationMode::EXPONENTIAL
+	       && be->getPhases() == 1
+	       && be->getProb() == 1
+	       && be->getRes().is_zero()
+	       && !be->isRepairable()
+	       && be->getRepair() <= 0
+	       && be->getMaintain() == 0
+	       && be->getInterval() == 0
+	       && be->getTriggers().empty()
+	       && !be->hasRepairModule()
+	       && !be->hasInspectionModule();
+}
+
+/* Whether the basic events of a subtree cannot be described by a
+ * phase-type distribution, or the subtree can be repaired.
+ */
+static bool preventsPhaseType(const DFT::Nodes::Node *n)
+{
+	if (n->matchesType(DFT::Nodes::RepairUnitAnyType)
+	    || n->matchesType(DFT::Nodes::InspectionType)
+	    || n->matchesType(DFT::Nodes::ReplacementType)
+	    || n->isRepairable())
+	{
+		return true;
+	}
+	if (!n->isBasicEvent())
+		return false;
+	const DFT::Nodes::BasicEvent *be = static_cast<const DFT::Nodes::BasicEvent *>(n);
+	return be->getMode() == DFT::Nodes::BE::CalculationMode::APH
+	       || be->getLambda() < 0
+	       || be->getRepair() > 0
+	       || be->getMaintain() != 0
+	       || be->getInterval() != 0
+	       || be->hasRepairModule()
+	       || be->hasInspectionModule();
+}
+
+/* Whether simultaneous failures triggered by the node may make the
+ * subtree nondeterministic.
+ */
+static bool mayBeNondeterministic(const DFT::Nodes::Node *n)
+{
+	return n->matchesType(DFT::Nodes::GateFDEPType);
+}
+
+static bool isCold(const DFT::Nodes::Node *n)
+{
+	return n->isBasicEvent()
+	       && static_cast<const DFT::Nodes::BasicEvent *>(n)->getDorm() != 1;
+}
+
+/* The independent subtrees of the DFT being written, and the numbers of
+ * nodes in them that keep them from being phase-type.
+ */
+struct SubtreeInfo {
+	DFT::DFTreeModules subtrees;
+	DFT::DFTreeModules::Count notPhaseType, cold, nondeterministic;
+
+	SubtreeInfo(DFT::DFTree *dft)
+		:subtrees(*dft),
+		 notPhaseType(subtrees.count(preventsPhaseType)),
+		 cold(subtrees.count(isCold)),
+		 nondeterministic(subtrees.count(mayBeNondeterministic))
+	{
+	}
+
+	bool isIndependent(DFT::Nodes::Node *node) const {
+		return subtrees.isIndependent(node);
+	}
+
+	/* Whether the time until the independent subtree below the node
+	 * fails can be described by a phase-type distribution, i.e. the
+	 * subtree cannot be repaired and its basic events fail after
+	 * exponentially distributed times. If the subtree may be dormant
+	 * (e.g., below a spare gate), all its basic events must also be
+	 * hot, so it fails the same way whether or not it is activated.
+	 */
+	bool isPhaseType(DFT::Nodes::Node *node, bool mustBeHot) const {
+		return notPhaseType.in(node) == 0
+		       && (!mustBeHot || cold.in(node) == 0);
+	}
+};
+
+/* Finds the largest independent subtrees strictly below the node that can
+ * be analysed on their own and substituted into the module as basic
+ * events with phase-type distributions.
+ * @param mayBeDormant Whether the node may be dormant, i.e. it is below a
+ * 	spare or sequence enforcer, or reachable along several paths.
+ */
+static void findPhaseTypeModules(const SubtreeInfo &info, DFT::Nodes::Node *node,
+                                 bool mayBeDormant,
+                                 std::unordered_set<DFT::Nodes::Node *> &visited,
+                                 std::vector<DFT::Nodes::Node *> &found)
+{
+	if (!node->isGate())
+		return;
+	mayBeDormant = mayBeDormant
+	               || node->matchesType(DFT::Nodes::GateSpareType)
+	               || node->matchesType(DFT::Nodes::GateSeqType);
+	const std::vector<DFT::Nodes::Node *> &children
+		= static_cast<DFT::Nodes::Gate *>(node)->getChildren();
+	for (DFT::Nodes::Node *child : children) {
+		if (!visited.insert(child).second)
+			continue;
+		if (child->isGate()
+		    && !child->outputIsDumb()
+		    && !child->matchesType(DFT::Nodes::GateFDEPType)
+		    && child->getTriggers().empty()
+		    && child->getParents().size() == 1
+		    && info.isIndependent(child)
+		    && info.isPhaseType(child, mayBeDormant))
+		{
+			found.push_back(child);
+			continue;
+		}
+		findPhaseTypeModules(info, child,
+		                     mayBeDormant || child->getParents().size() > 1,
+		                     visited, found);
+	}
+}
+
+/* Modules to be analysed are written with their structural hash, so
+ * identical modules only need to be analysed once. With dynamic
+ * modularization, the independent subtrees of a module that have a
+ * phase-type distribution are written as its submodules ('D' module),
+ * to be analysed first and substituted into the module as basic events.
+ */
+static void writeModule(std::ostream &out, const SubtreeInfo &info,
+                        DFT::DFTreeHasher &hasher, DFT::Nodes::Node *root,
+                        bool dynamic)
+{
+	std::vector<DFT::Nodes::Node *> submodules;
+	if (dynamic) {
+		std::unordered_set<DFT::Nodes::Node *> visited;
+		findPhaseTypeModules(info, root, false, visited, submodules);
+	}
+	if (submodules.empty()) {
+		out << "M#" << hasher.getHash(root) << " " << root->getName() << "\n";
+		return;
+	}
+	out << "D" << submodules.size() << "#" << hasher.getHash(root)
+	    << " " << root->getName() << "\n";
+	for (DFT::Nodes::Node *sub : submodules)
+		writeModule(out, info, hasher, sub, dynamic);
+}
+
+static void writeModules(std::ostream &out, const SubtreeInfo &info,
+                         DFT::DFTreeHasher &hasher, DFT::Nodes::Node *root,
+                         bool dynamic)
 {
 	if (root->matchesType(DFT::Nodes::NodeType::BasicEventType)) {
 		DFT::Nodes::BasicEvent *be;
 		be = static_cast<DFT::Nodes::BasicEvent *>(root);
+		if (be->getFailed()) {
+			out << "=1\n";
+			return;
+		}
 		if (be->getLambda() == -1) {
 			out << "=" << be->getProb().str() << "\n";
 			return;
 		}
+		if (isExponential(be)) {
+			out << "E" << be->getLambda().str() << " " << be->getName() << "\n";
+			return;
+		}
 	}
 	if (root->outputIsDumb()) {
 		out << "=0\n";
@@ -22,14 +186,14 @@ static void writeModules(std::ostream &out, DFT::DFTree *dft, DFT::Nodes::Node *
 	      || root->matchesType(DFT::Nodes::NodeType::GateOrType)
 	      || root->matchesType(DFT::Nodes::NodeType::GateVotingType)))
 	{
-		out << "M" << root->getName() << "\n";
+		writeModule(out, info, hasher, root, dynamic);
 		return;
 	}
 	DFT::Nodes::Gate *g = static_cast<DFT::Nodes::Gate *>(root);
 	std::vector<DFT::Nodes::Node *> children = g->getChildren();
 	for (DFT::Nodes::Node *child : children) {
-		if (!child->isIndependentSubtree()) {
-			out << "M" << root->getName() << "\n";
+		if (!info.isIndependent(child)) {
+			writeModule(out, info, hasher, root, dynamic);
 			return;
 		}
 	}
@@ -43,17 +207,65 @@ static void writeModules(std::ostream &out, DFT::DFTree *dft, DFT::Nodes::Node *
 		out << "/" << v->getThreshold() <<" "<< children.size() << "\n";
 	}
 	for (DFT::Nodes::Node *child : children)
-		writeModules(out, dft, child);
+		writeModules(out, info, hasher, child, dynamic);
+}
+
+/* Mirrors writeModules() to check the modules below static gates */
+static bool modulesHavePhaseType(const SubtreeInfo &info, DFT::Nodes::Node *root,
+                                 bool top)
+{
+	if (root->matchesType(DFT::Nodes::NodeType::BasicEventType)) {
+		DFT::Nodes::BasicEvent *be;
+		be = static_cast<DFT::Nodes::BasicEvent *>(root);
+		if (be->getFailed() || be->getLambda() == -1 || isExponential(be))
+			return true;
+	}
+	if (root->outputIsDumb())
+		return true;
+	bool combined = root->matchesType(DFT::Nodes::NodeType::GateAndType)
+	                || root->matchesType(DFT::Nodes::NodeType::GateOrType)
+	                || root->matchesType(DFT::Nodes::NodeType::GateVotingType);
+	std::vector<DFT::Nodes::Node *> children;
+	if (combined)
+		children = static_cast<DFT::Nodes::Gate *>(root)->getChildren();
+	for (DFT::Nodes::Node *child : children) {
+		if (!info.isIndependent(child))
+			combined = false;
+	}
+	if (!combined) {
+		/* The whole DFT is analysed directly */
+		if (top)
+			return true;
+		return info.notPhaseType.in(root) == 0
+		       && info.nondeterministic.in(root) == 0;
+	}
+	for (DFT::Nodes::Node *child : children) {
+		if (!modulesHavePhaseType(info, child, false))
+			return false;
+	}
+	return true;
+}
+
+bool modulesHavePhaseType(DFT::DFTree *dft)
+{
+	SubtreeInfo info(dft);
+	return modulesHavePhaseType(info, dft->getTopNode(), true);
+}
+
+void writeModules(std::ostream &out, DFT::DFTree *dft, bool dynamic)
+{
+	SubtreeInfo info(dft);
+	DFT::DFTreeHasher hasher(info.subtrees);
+	writeModules(out, info, hasher, dft->getTopNode(), dynamic);
 }
 
-void writeModules(std::string filename, DFT::DFTree *dft)
+void writeModules(std::string filename, DFT::DFTree *dft, bool dynamic)
 {
-	DFT::Nodes::Node *root = dft->getTopNode();
 	if (filename.empty())
-		writeModules(std::cout, dft, root);
+		writeModules(std::cout, dft, dynamic);
 	else {
 		ofstream out(filename, std::ofstream::out);
-		writeModules(out, dft, root);
+		writeModules(out, dft, dynamic);
 		out.close();
 	}
 }
@@ -1,3 +1,21 @@
 #include "DFTree.h"
 
-void writeModules(std::string filename, DFT::DFTree *dft);
+/**
+ * Writes the module description of the DFT: its static gates whose
+ * children are independent, down to the modules that need to be analysed.
+ * @param dynamic Whether to split the modules to be analysed further at
+ * 	independent subtrees below dynamic gates (see dftcalc
+ * 	--dynamic-modules).
+ */
+void writeModules(std::string filename, DFT::DFTree *dft, bool dynamic = false);
+void writeModules(std::ostream &out, DFT::DFTree *dft, bool dynamic = false);
+
+/**
+ * Returns whether the time to failure of every module written by
+ * writeModules() below the static gates at the top of the DFT can be
+ * described by a phase-type distribution, so that the MTTF of the DFT
+ * follows from these distributions. Modules that can be repaired, have
+ * time-dependent behaviour, or may be nondeterministic (i.e., contain
+ * FDEP gates) cannot.
+ */
+bool modulesHavePhaseType(DFT::DFTree *dft);
@@ -0,0 +1,397 @@
+/*
+ * translator.cpp
+ *
+ * Part of dft2lnt library - a library containing read/write operations for DFT
+ * files in Galileo format and translating DFT specifications into Lotos NT.
+ *
+ * @author Enno Ruijters
+ */
+
+#include "translator.h"
+
+#include <mutex>
+#include <algorithm>
+#include <stdlib.h>
+#include "dft2lnt.h"
+#include "FileSystem.h"
+#include "dft_ast.h"
+#include "dft_parser.h"
+#include "dft_fastparser.h"
+#include "ASTValidator.h"
+#include "ASTDFTBuilder.h"
+#include "DFTreeValidator.h"
+#include "DFTreeAUTNodeBuilder.h"
+#include "DFTreeEXPBuilder.h"
+#ifdef HAVE_CADP
+# include "DFTreeBCGNodeBuilder.h"
+#endif
+
+#ifdef WIN32
+# include <windows.h>
+# include <shlobj.h>
+#endif
+
+static const int VERBOSITY_FLOW = 1;
+
+/* The automata are shared by all translations, so translations in the
+ * same process take turns generating them.
+ */
+static std::mutex automataLock;
+
+DFT::Translator::Translator(CompilerContext *cc, Trace *trace)
+	:cc(cc), trace(trace), parser(nullptr), fastParser(true), ast(nullptr),
+	 dft(nullptr),
+	 nodeBuilder(nullptr)
+{
+}
+
+DFT::Translator::~Translator()
+{
+	/* The node builders refer to the DFT */
+	autBuilder.reset();
+	bcgBuilder.reset();
+	delete ast;
+	delete dft;
+	delete parser;
+}
+
+std::string DFT::Translator::getCacheDir(CompilerContext *cc)
+{
+	std::string root;
+#ifdef WIN32
+	PWSTR rootStr;
+	HRESULT hr = SHGetKnownFolderPath(FOLDERID_LocalAppData, 0, NULL, &rootStr);
+	if (!SUCCEEDED(hr)) {
+		cc->reportError("Unable to lookup Application Data directory");
+		return "";
+	}
+	char bytes[MAX_PATH];
+	WideCharToMultiByte(CP_ACP, 0, rootStr, -1, bytes, sizeof(bytes), NULL, NULL);
+	CoTaskMemFree(rootStr);
+	root = std::string(bytes);
+#elif defined __APPLE__
+	root = std::getenv("HOME");
+	root += "/Library/Caches";
+#else
+	const char *home = std::getenv("HOME");
+	if (!home) {
+		cc->reportError("Environment variable `HOME' not set, cannot locate cache directory");
+		return "";
+	}
+	root = home;
+	root += "/.cache";
+	if (!FileSystem::isDir(File(root))) {
+		if (FileSystem::mkdir(File(root))) {
+			cc->reportError("Could not create cache root directory (" + root + ")");
+			return "";
+		}
+	}
+#endif
+	/* End of OS-specific part */
+
+	std::string cache = root + "/dftcalc";
+	if (!FileSystem::isDir(File(cache))) {
+		if (FileSystem::mkdir(File(cache))) {
+			cc->reportError("Could not create cache directory (" + cache + ")");
+			return "";
+		}
+	}
+
+	std::string autDir = cache + DFT2LNT::AUT_CACHE_DIR;
+	if (!FileSystem::isDir(File(autDir))) {
+		if (FileSystem::mkdir(File(autDir))) {
+			cc->reportError("Could not create .aut directory (" + autDir + ")");
+			return "";
+		}
+	}
+
+	return cache;
+}
+
+DFT::AST::ASTNodes *DFT::Translator::parse(FILE *input,
+                                           const std::string &fileName)
+{
+	cc->notify("Checking syntax...",VERBOSITY_FLOW);
+	Trace::Span span(trace, "parse", "dft2lntc");
+	span.addArg("file", fileName);
+	Arena::Scope scope(arena);
+	delete parser;
+	parser = nullptr;
+	/* Correct files in the common subset of the language are parsed
+	 * by the faster parser, everything else (with the error messages)
+	 * by the generated one.
+	 */
+	ast = fastParser ? FastParser(fileno(input), fileName).parse() : nullptr;
+	if (ast) {
+		fclose(input);
+		span.addArg("parser", "fast");
+	} else {
+		parser = new Parser(input, fileName, cc);
+		ast = parser->parse();
+	}
+	cc->flush();
+	if (!ast || cc->getErrors() > 0) {
+		cc->reportError("Syntax is incorrect");
+		delete ast;
+		ast = nullptr;
+	} else {
+		cc->reportAction("Syntax is correct",VERBOSITY_FLOW);
+		span.addArg("declarations", ast->size());
+	}
+	cc->flush();
+	return ast;
+}
+
+DFT::AST::ASTNodes *DFT::Translator::parse(const std::string &fileName)
+{
+	FILE *input = fopen(fileName.c_str(), "rb");
+	if (!input) {
+		cc->reportError("Could not open DFT file `" + fileName + "'");
+		return nullptr;
+	}
+	return parse(input, fileName);
+}
+
+int DFT::Translator::validateAST()
+{
+	if (!ast)
+		return 1;
+	cc->notify("Validating AST...",VERBOSITY_FLOW);
+	cc->flush();
+	Trace::Span span(trace, "validate AST", "dft2lntc");
+	DFT::ASTValidator validator(ast, cc);
+	if (!validator.validate()) {
+		cc->reportError("AST invalid");
+		cc->flush();
+		return 1;
+	}
+	cc->reportAction("AST is valid",VERBOSITY_FLOW);
+	cc->flush();
+	return 0;
+}
+
+DFT::DFTree *DFT::Translator::buildDFT()
+{
+	cc->notify("Building DFT...",VERBOSITY_FLOW);
+	cc->flush();
+	Trace::Span span(trace, "build DFT", "dft2lntc");
+	Arena::Scope scope(arena);
+	DFT::ASTDFTBuilder builder(ast, cc);
+	dft = builder.build();
+	if (!dft) {
+		cc->reportError("Could not build DFT");
+	} else {
+		cc->reportAction("DFT built successfully",VERBOSITY_FLOW);
+		span.addArg("nodes", dft->getNodes().size());
+	}
+	cc->flush();
+	return dft;
+}
+
+int DFT::Translator::validateDFT()
+{
+	if (!dft)
+		return 1;
+	cc->notify("Validating DFT...",VERBOSITY_FLOW);
+	cc->flush();
+	Trace::Span span(trace, "validate DFT", "dft2lntc");
+	DFT::DFTreeValidator validator(dft, cc);
+	if (!validator.validate()) {
+		cc->reportError("DFT invalid");
+		cc->flush();
+		return 1;
+	}
+	cc->reportAction("DFT is valid",VERBOSITY_FLOW);
+	cc->flush();
+	return 0;
+}
+
+void DFT::Translator::index()
+{
+	for (size_t i = 0; i < ast->size(); i++) {
+		DFT::AST::ASTNode *decl = ast->at(i);
+		if (decl->getType() == DFT::AST::BasicEventType) {
+			DFT::AST::ASTBasicEvent *be = static_cast<DFT::AST::ASTBasicEvent *>(decl);
+			declarations[be->getName()->getString()] = i;
+		} else if (decl->getType() == DFT::AST::GateType) {
+			DFT::AST::ASTGate *gate = static_cast<DFT::AST::ASTGate *>(decl);
+			declarations[gate->getName()->getString()] = i;
+		}
+	}
+}
+
+int DFT::Translator::loadModule(Translator &source, const std::string &root)
+{
+	Trace::Span span(trace, "load module", "dft2lntc");
+	span.addArg("root", root);
+	Arena::Scope scope(arena);
+	if (!source.ast || !source.dft) {
+		cc->reportError("No DFT to load module " + root + " from.");
+		cc->flush();
+		return 1;
+	}
+	std::call_once(source.indexed, &Translator::index, &source);
+	DFT::Nodes::Node *top = source.dft->getNode(root);
+	if (!top) {
+		cc->reportError("Root node " + root + " does not exist.");
+		cc->flush();
+		return 1;
+	}
+
+	/* Build the module from the declarations of its nodes, in the
+	 * order of the original file so the module is built exactly as if
+	 * the whole DFT was built and then cut down to the module.
+	 */
+	std::vector<size_t> indices;
+	for (DFT::Nodes::Node *node : source.dft->getReachable(top)) {
+		auto decl = source.declarations.find(node->getName());
+		if (decl != source.declarations.end())
+			indices.push_back(decl->second);
+	}
+	std::sort(indices.begin(), indices.end());
+	DFT::AST::ASTNodes module;
+	for (size_t i : indices)
+		module.push_back(source.ast->at(i));
+
+	delete dft;
+	DFT::ASTDFTBuilder builder(&module, cc);
+	dft = builder.build();
+	/* The declarations still belong to the source */
+	module.clear();
+	dft->setTopNode(dft->getNode(root));
+	span.addArg("nodes", dft->getNodes().size());
+	cc->flush();
+	return cc->getErrors() > 0;
+}
+
+int DFT::Translator::setRoot(const std::string &root)
+{
+	DFT::Nodes::Node *newRoot = dft ? dft->getNode(root) : nullptr;
+	if (newRoot == nullptr) {
+		cc->reportError("Root node " + root + " does not exist.");
+		cc->flush();
+		return 1;
+	}
+	dft->setTopNode(newRoot);
+	dft->removeUnreachable();
+	return 0;
+}
+
+int DFT::Translator::applyEvidence(const std::vector<std::string> &failedBEs,
+                                   bool partial)
+{
+	cc->reportAction("Applying evidence to DFT...",VERBOSITY_FLOW);
+	cc->flush();
+	try {
+		dft->applyEvidence(failedBEs, partial);
+	} catch(std::vector<std::string>& errors) {
+		for(std::string e: errors) {
+			cc->reportError(e);
+		}
+		cc->flush();
+		return 1;
+	}
+	return 0;
+}
+
+int DFT::Translator::substitutePhaseTypes(const std::unordered_map<std::string, std::string> &phaseTypes)
+{
+	Arena::Scope scope(arena);
+	/* Copied, as the basic events are added to the DFT */
+	std::vector<DFT::Nodes::Node *> nodes = dft->getNodes();
+	bool substituted = false;
+	for (DFT::Nodes::Node *node : nodes) {
+		auto ph = phaseTypes.find(node->getName());
+		if (ph == phaseTypes.end() || node == dft->getTopNode())
+			continue;
+		cc->reportAction("Substituting phase-type distribution for " + node->getName(),VERBOSITY_FLOW);
+		DFT::Nodes::BasicEvent *be;
+		be = new DFT::Nodes::BasicEvent(node->getLocation(), node->getName());
+		be->setMode(DFT::Nodes::BE::CalculationMode::APH);
+		be->setFileToEmbed(ph->second);
+		be->getParents() = node->getParents();
+		for (DFT::Nodes::Gate *parent : node->getParents()) {
+			std::vector<DFT::Nodes::Node *> &children = parent->getChildren();
+			std::replace(children.begin(), children.end(), node,
+			             static_cast<DFT::Nodes::Node *>(be));
+		}
+		/* The subtree is now unreachable */
+		node->getParents().clear();
+		dft->addNode(be);
+		substituted = true;
+	}
+	if (substituted)
+		dft->removeUnreachable();
+	cc->flush();
+	return 0;
+}
+
+void DFT::Translator::transform()
+{
+	Trace::Span span(trace, "transform", "dft2lntc");
+	Arena::Scope scope(arena);
+
+	/* Add repair knowledge to gates */
+	cc->reportAction("Applying repair knowledge to DFT gates...",VERBOSITY_FLOW);
+	cc->flush();
+	dft->addRepairInfo();
+	cc->reportAction("Done applying repair knowledge to DFT gates...",VERBOSITY_FLOW);
+
+	/* Add always-active knowledge to gates */
+	cc->reportAction("Applying always-active knowledge to DFT gates...",VERBOSITY_FLOW);
+	cc->flush();
+	dft->addAlwaysActiveInfo();
+	cc->reportAction("Done applying always-active knowledge to DFT gates...",VERBOSITY_FLOW);
+
+	/* Remove superflous FDEP edges */
+	cc->reportAction("Applying FDEP cleanup to DFT gates...",VERBOSITY_FLOW);
+	cc->flush();
+	dft->checkFDEPInfo();
+	cc->reportAction("Done applying FDEP cleanup to DFT gates...",VERBOSITY_FLOW);
+
+	/* Replace sequence enforcers by SAND gates when possible. */
+	cc->reportAction("Applying SEQ cleanup to DFT gates...",VERBOSITY_FLOW);
+	cc->flush();
+	dft->replaceSEQs();
+	cc->reportAction("Done applying SEQ cleanup to DFT gates...",VERBOSITY_FLOW);
+}
+
+int DFT::Translator::generateAutomata(const std::string &dft2lntRoot,
+                                      const std::string &cacheDir)
+{
+	cc->notify("Building needed AUT files...",VERBOSITY_FLOW);
+	cc->flush();
+	Trace::Span span(trace, "generate AUT", "dft2lntc");
+	span.addArg("nodes", dft->getNodes().size());
+	std::lock_guard<std::mutex> guard(automataLock);
+	autBuilder.reset(new DFTreeAUTNodeBuilder(cacheDir, dft, cc));
+	nodeBuilder = autBuilder.get();
+	if (!autBuilder->generate())
+		return 0;
+#ifdef HAVE_CADP
+	cc->notify("Unable to make AUT files, building needed BCG files...",VERBOSITY_FLOW);
+	bcgBuilder.reset(new DFTreeBCGNodeBuilder(dft2lntRoot, dft, cc));
+	nodeBuilder = bcgBuilder.get();
+	bcgBuilder->generate();
+	return 0;
+#else
+	cc->reportError("Unable to create AUT files.");
+	return 1;
+#endif
+}
+
+int DFT::Translator::buildEXP(const std::string &dft2lntRoot,
+                              const std::string &bcgFile,
+                              const std::string &expFile,
+                              std::ostream &exp, std::ostream &svl)
+{
+	cc->notify("Building EXP...",VERBOSITY_FLOW);
+	cc->flush();
+	Trace::Span span(trace, "build EXP", "dft2lntc");
+	DFT::DFTreeEXPBuilder builder(dft2lntRoot, ".", bcgFile, expFile, dft,
+	                              nodeBuilder, cc);
+	int res = builder.build();
+	builder.printSVL(svl);
+	builder.printEXP(exp);
+	return res;
+}
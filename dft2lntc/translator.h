@@ -0,0 +1,204 @@
+/*
+ * translator.h
+ *
+ * Part of dft2lnt library - a library containing read/write operations for DFT
+ * files in Galileo format and translating DFT specifications into Lotos NT.
+ *
+ * @author Enno Ruijters
+ */
+
+#ifndef DFT2LNTC_TRANSLATOR_H
+#define DFT2LNTC_TRANSLATOR_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <ostream>
+#include <stdio.h>
+#include "compiler.h"
+#include "Arena.h"
+#include "DFTree.h"
+#include "DFTreeNodeBuilder.h"
+#include "Trace.h"
+
+class Parser;
+
+namespace DFT {
+
+namespace AST {
+class ASTNodes;
+}
+
+/**
+ * The stages of translating a DFT into an EXP and SVL file, as performed
+ * by dft2lntc. The stages are run one after the other, each only if the
+ * previous ones succeeded:
+ *   parse(), validateAST(), buildDFT(), validateDFT(), setRoot(),
+ *   applyEvidence(), substitutePhaseTypes(), transform(),
+ *   generateAutomata() and buildEXP().
+ * Since no process is needed, dftcalc uses this to translate DFTs without
+ * running dft2lntc.
+ */
+class Translator {
+private:
+	CompilerContext *cc;
+	Trace *trace;
+	/* Holds the nodes of the AST and DFT, which are all released at
+	 * once with the translator.
+	 */
+	Arena arena;
+	Parser *parser;
+	bool fastParser;
+	DFT::AST::ASTNodes *ast;
+	DFT::DFTree *dft;
+	std::unique_ptr<DFTreeNodeBuilder> autBuilder;
+	std::unique_ptr<DFTreeNodeBuilder> bcgBuilder;
+	DFTreeNodeBuilder *nodeBuilder;
+
+	/* Index of the declarations by name, used by the translators of
+	 * the modules of this DFT (see loadModule()).
+	 */
+	std::once_flag indexed;
+	std::unordered_map<std::string, size_t> declarations;
+
+	void index();
+
+public:
+	/**
+	 * Creates a translator reporting to the specified compiler
+	 * context, and adding a span for each stage to the trace (if not
+	 * NULL).
+	 */
+	Translator(CompilerContext *cc, Trace *trace = nullptr);
+	~Translator();
+
+	Translator(const Translator &) = delete;
+	Translator &operator=(const Translator &) = delete;
+
+	/**
+	 * Returns the directory in which automata are cached, creating it
+	 * if necessary.
+	 * @return The cache directory, or empty on error.
+	 */
+	static std::string getCacheDir(CompilerContext *cc);
+
+	/**
+	 * Sets whether files are parsed by FastParser where possible (the
+	 * default), or always by the generated parser.
+	 */
+	void setFastParser(bool use) { fastParser = use; }
+
+	/**
+	 * Parses a DFT.
+	 * @param input The opened input file, closed by the parser.
+	 * @param fileName The name of the file, used in error messages
+	 * 	and to find files referred to by the DFT.
+	 * @return The AST, or NULL if the syntax is incorrect.
+	 */
+	DFT::AST::ASTNodes *parse(FILE *input, const std::string &fileName);
+
+	/**
+	 * Parses the DFT in the specified file.
+	 * @return The AST, or NULL if the file could not be read or the
+	 * 	syntax is incorrect.
+	 */
+	DFT::AST::ASTNodes *parse(const std::string &fileName);
+
+	/**
+	 * Validates the parsed AST.
+	 * @return 0 if valid, non-zero otherwise
+	 */
+	int validateAST();
+
+	/**
+	 * Builds the DFT from the validated AST.
+	 * @return The DFT, or NULL on error.
+	 */
+	DFT::DFTree *buildDFT();
+
+	/**
+	 * Validates the DFT.
+	 * @return 0 if valid, non-zero otherwise
+	 */
+	int validateDFT();
+
+	/**
+	 * Loads the subtree below the specified node from a DFT already
+	 * parsed and validated by another translator, so every module of a
+	 * DFT can be translated without parsing the DFT again. Building the
+	 * module only takes time proportional to its size.
+	 * The source translator must not change its DFT while any of its
+	 * modules are being loaded, but several modules may be loaded from
+	 * it concurrently.
+	 * @param source The translator of the whole DFT.
+	 * @param root The root of the module.
+	 * @return 0 if successful, non-zero if there is no such node
+	 */
+	int loadModule(Translator &source, const std::string &root);
+
+	/**
+	 * Makes the specified node the root of the DFT, removing every
+	 * node not below it.
+	 * @return 0 if successful, non-zero if there is no such node
+	 */
+	int setRoot(const std::string &root);
+
+	/**
+	 * Marks the specified basic events as failed from the start.
+	 * @param partial Whether to skip the basic events that are not in
+	 * 	the DFT, as when applying the evidence of the whole DFT to a
+	 * 	module.
+	 * @return 0 if successful, non-zero otherwise
+	 */
+	int applyEvidence(const std::vector<std::string> &failedBEs,
+	                  bool partial = false);
+
+	/**
+	 * Replaces the (independent) subtrees below the specified nodes by
+	 * basic events failing according to phase-type distributions, i.e.
+	 * APH basic events embedding the specified automata. Nodes not in
+	 * the DFT, and its root, are left alone.
+	 * @param phaseTypes The automaton (AUT file) by name of the node.
+	 * @return 0 if successful, non-zero otherwise
+	 */
+	int substitutePhaseTypes(const std::unordered_map<std::string, std::string> &phaseTypes);
+
+	/**
+	 * Applies the repair, always-active, FDEP and SEQ transformations
+	 * needed before building the EXP.
+	 */
+	void transform();
+
+	/**
+	 * Generates the automata of the nodes of the DFT (AUT files, or
+	 * BCG files if these cannot be made).
+	 * @param dft2lntRoot The installation root, for BCG files.
+	 * @param cacheDir The directory to store AUT files in.
+	 * @return 0 if successful, non-zero otherwise
+	 */
+	int generateAutomata(const std::string &dft2lntRoot,
+	                     const std::string &cacheDir);
+
+	/**
+	 * Builds the EXP and SVL files composing the generated automata.
+	 * @param dft2lntRoot The installation root.
+	 * @param bcgFile The BCG file to be written by the SVL script.
+	 * @param expFile The name of the EXP file, as used by the SVL
+	 * 	script.
+	 * @param exp Receives the contents of the EXP file.
+	 * @param svl Receives the contents of the SVL file.
+	 * @return 0 if successful, non-zero otherwise
+	 */
+	int buildEXP(const std::string &dft2lntRoot, const std::string &bcgFile,
+	             const std::string &expFile, std::ostream &exp,
+	             std::ostream &svl);
+
+	DFT::AST::ASTNodes *getAST() { return ast; }
+	DFT::DFTree *getDFT() { return dft; }
+};
+
+} // Namespace: DFT
+
+#endif
@@ -7,6 +7,11 @@
 #include "DFTCalculationResult.h"
 #include <unordered_map>
 #include <vector>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <exception>
 
 namespace DFT {
 	extern const int VERBOSITY_FLOW; /* Defined in dftcalc.cpp */
@@ -16,12 +21,60 @@ class Checker {
 protected:
 	MessageFormatter *messageFormatter;
 	DFT::CommandExecutor *exec;
+	unsigned int jobs;
+
+	/* Runs task(0) up to task(n - 1), up to jobs of them at the same
+	 * time. Once a task fails, the tasks not yet started are skipped.
+	 * An exception thrown by a task is rethrown once all running
+	 * tasks are finished.
+	 * Returns 0 if all tasks returned 0, non-zero otherwise.
+	 */
+	int runConcurrently(size_t n, const std::function<int(size_t)> &task) {
+		std::atomic<size_t> next(0);
+		std::atomic<bool> failed(false);
+		std::exception_ptr error;
+		std::mutex errorLock;
+		auto worker = [&]() {
+			size_t i;
+			while (!failed && (i = next++) < n) {
+				try {
+					if (task(i))
+						failed = true;
+				} catch (...) {
+					std::lock_guard<std::mutex> guard(errorLock);
+					if (!error)
+						error = std::current_exception();
+					failed = true;
+				}
+			}
+		};
+		size_t nThreads = std::min((size_t)jobs, n);
+		if (nThreads > 1) {
+			std::vector<std::thread> threads;
+			for (size_t i = 0; i < nThreads; i++)
+				threads.emplace_back(worker);
+			for (std::thread &t : threads)
+				t.join();
+		} else {
+			worker();
+		}
+		if (error)
+			std::rethrow_exception(error);
+		return failed;
+	}
 
 public:
 	Checker(MessageFormatter *mf, DFT::CommandExecutor *exec)
-		:messageFormatter(mf), exec(exec)
+		:messageFormatter(mf), exec(exec), jobs(1)
 	{}
 
+	/* Sets the maximum number of checker processes run at the same
+	 * time for queries that cannot be checked in a single run.
+	 */
+	void setJobs(unsigned int jobs) {
+		this->jobs = jobs ? jobs : 1;
+	}
+
 	/* Analyze the provided queries on the given model, returning
 	 * lower and upper bounds on the results.
 	 * The returned queries need not be the same ones (in
@@ -21,6 +21,11 @@
 #include <fstream>
 #include <memory>
 #include <limits.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <algorithm>
+#include <cmath>
 
 #ifdef HAVE_CADP
 # include <CADP.h>
@@ -43,6 +48,12 @@ using namespace std;
 #include "modest.h"
 #include "imca.h"
 #include "storm.h"
+#include "service.h"
+#include "modularize.h"
+#include "interval.h"
+#include "phasetype.h"
+#include "manifest.h"
+#include "DFTreeHasher.h"
 
 const int DFT::DFTCalc::VERBOSITY_SEARCHING = 2;
 
@@ -61,8 +72,29 @@ void print_help(MessageFormatter* messageFormatter, string topic="") {
 		messageFormatter->message("  --color         Use colored messages.");
 		messageFormatter->message("  --no-color      Do not use colored messages.");
 		messageFormatter->message("  --version       Print version info and quit.");
-		messageFormatter->message("  -R              Reuse existing output files.");
+		messageFormatter->message("  -R              Reuse output files whose inputs did not change (default).");
+		messageFormatter->message("  --rebuild       Regenerate all output files, even if up to date.");
 		messageFormatter->message("  -M              Use modularization to check static parts of DFT.");
+		messageFormatter->message("  --dynamic-modules  Like -M, but also analyse independent subtrees below");
+		messageFormatter->message("                  dynamic gates on their own, substituting their time to");
+		messageFormatter->message("                  failure into their parent as a phase-type basic event.");
+		messageFormatter->message("  -j N            Calculate up to N modules concurrently (with -M), or up to");
+		messageFormatter->message("                  N DFTs concurrently in batch mode.");
+		messageFormatter->message("  --checker-jobs N  Run up to N model checker processes concurrently for the");
+		messageFormatter->message("                  queries of one DFT (or module) that need separate runs.");
+		messageFormatter->message("  --batch FILE    Also calculate the DFTs listed in FILE, one per line, each");
+		messageFormatter->message("                  in its own workspace below the -C folder.");
+		messageFormatter->message("  --time-limit [STAGE=]S");
+		messageFormatter->message("                  Terminate tools running longer than S seconds. STAGE is");
+		messageFormatter->message("                  compose or check (default: both stages).");
+		messageFormatter->message("  --memory-limit [STAGE=]M");
+		messageFormatter->message("                  Limit the memory of tools to M megabytes (per STAGE as above).");
+		messageFormatter->message("  --fallback LIST When a limit is exceeded, retry with each of the comma-separated");
+		messageFormatter->message("                  strategies in LIST: modular, dftres, or a model checker");
+		messageFormatter->message("                  (storm, modest, mrmc, imrmc, imca).");
+		messageFormatter->message("  --serve         Keep running, reading requests (one JSON object per line)");
+		messageFormatter->message("                  from stdin and writing the results to stdout.");
+		messageFormatter->message("  --serve=SOCKET  Like --serve, but read requests from a Unix domain socket.");
 		messageFormatter->message("  --storm         Use Storm. (standard setting)");
 		messageFormatter->message("  --modest        Use Modest instead of Storm.");
 #ifdef HAVE_CADP
@@ -93,8 +125,15 @@ void print_help(MessageFormatter* messageFormatter, string topic="") {
 		messageFormatter->message("  -u              Calculate P(DFT fails eventually)");
 		messageFormatter->message("  -I l u          Calculate P(DFT fails in [l,u] time units) where l can be >= 0");
 		messageFormatter->message("  -f <command>    Raw Calculation formula for the model-checker. Overrules -i, -s, -m, -t, and -u.");
-		messageFormatter->message("  -E errorbound   Error bound, to be passed to IMCA.");
+		messageFormatter->message("  -E errorbound   Error bound, to be passed to IMCA. With -M, the error bound");
+		messageFormatter->message("                  applies to the combined result, and is divided over the");
+		messageFormatter->message("                  modules by their influence on it.");
 		messageFormatter->message("  -C DIR          Temporary output files will be in this directory");
+		messageFormatter->message("  --cache DIR     Store results for reuse by later runs in this directory.");
+		messageFormatter->message("                  (default: ~/.cache/dftcalc/results)");
+		messageFormatter->message("  --no-cache      Do not reuse results from earlier runs.");
+		messageFormatter->message("  --trace FILE    Write the time spent on each module, tool and query to FILE,");
+		messageFormatter->message("                  in the Chrome trace event format.");
 		messageFormatter->message("  --min           Compute minimum time-bounded reachability (default)");
 		messageFormatter->message("  --max           Compute maximum time-bounded reachability");
 		messageFormatter->flush();
@@ -277,26 +316,64 @@ std::string DFT::DFTCalc::getCADPRoot() {
 	return cadp;
 }
 
-static bool hasHiddenLabels(const File& file) {
-	std::string* fileContents = FileSystem::load(file);
-	bool res = false;
-	if (fileContents) {
-		res = ((*fileContents).find("no transition with a hidden label", 0) ==  string::npos);
-		delete fileContents;
+static bool hasHiddenLabels(const std::string &bcgInfo) {
+	return bcgInfo.find("no transition with a hidden label", 0) == string::npos;
+}
+
+static bool hasImpossibleLabel(const std::string &bcgInfo) {
+	return bcgInfo.find("IMPOSSIBLE", 0) != string::npos;
+}
+#endif
+
+static std::string checkerName(enum DFT::checker checker) {
+	switch (checker) {
+	case DFT::checker::STORM:
+		return "storm";
+	case DFT::checker::MRMC:
+		return "mrmc";
+	case DFT::checker::IMRMC:
+		return "imrmc";
+	case DFT::checker::IMCA:
+		return "imca";
+	case DFT::checker::MODEST:
+		return "modest";
+	default:
+		return "none";
 	}
-	return res;
 }
 
-static bool hasImpossibleLabel(const File& file) {
-	std::string* fileContents = FileSystem::load(file);
-	bool res = false;
-	if (fileContents) {
-		res = ((*fileContents).find("IMPOSSIBLE", 0) != string::npos);
-		delete fileContents;
+/* Parses a [STAGE=]VALUE resource limit, setting the time (in seconds)
+ * or memory (in megabytes) limit of the given stage, or of all stages.
+ * Returns 0 if successful.
+ */
+static int parseLimit(const string &spec, vector<DFT::ResourceLimit> &limits,
+                      bool memory)
+{
+	static const char *stages[] = {"compose", "check"};
+	int first = 0, last = DFT::NUM_STAGES - 1;
+	string value = spec;
+	size_t eq = spec.find('=');
+	if (eq != string::npos) {
+		string stage = spec.substr(0, eq);
+		value = spec.substr(eq + 1);
+		while (first < DFT::NUM_STAGES && stage != stages[first])
+			first++;
+		if (first == DFT::NUM_STAGES)
+			return 1;
+		last = first;
 	}
-	return res;
+	char *end;
+	double v = strtod(value.c_str(), &end);
+	if (value.empty() || *end || v < 0)
+		return 1;
+	for (int s = first; s <= last; s++) {
+		if (memory)
+			limits[s].memory = (size_t)(v * 1024 * 1024);
+		else
+			limits[s].time = v;
+	}
+	return 0;
 }
-#endif
 
 int isReal(string s, double *res) {
 	char *end;
@@ -319,28 +396,63 @@ int DFT::DFTCalc::calcModular(const bool reuse,
 {
 	std::string dftFileName = dftOriginal.getFileBase();
 	messageFormatter->notify("Computing `"+dftFileName+"' with modularization");
-	CommandExecutor exec(messageFormatter, cwd, dftFileName);
 
 	File mod = dftOriginal.newWithPathTo(cwd).newWithExtension("mod");
 
-	if(!reuse) {
-		if(FileSystem::exists(mod))    FileSystem::remove(mod);
-	} else {
-		messageFormatter->reportAction("Preserving generated modules file.",
-		                               VERBOSITY_FLOW);
+	if(FileSystem::exists(mod))    FileSystem::remove(mod);
+	/* The DFT is parsed only once, and the translation of each module
+	 * takes its subtree from it. Modularizing takes little time, so
+	 * the modules file always follows the current DFT.
+	 */
+	CompilerContext cc(std::cerr);
+	Translator translator(&cc, trace);
+	messageFormatter->reportAction("Modularizing DFT...",VERBOSITY_FLOW);
+	int loadRes = loadDFT(translator, cc, dftOriginal, "");
+	/* Failed basic events are constant modules */
+	if (!loadRes && !evidence.empty())
+		loadRes = translator.applyEvidence(evidence);
+	if (!loadRes) {
+		Trace::Span span(trace, "modularize", "dft2lntc");
+		writeModules(mod.getFilePath(), translator.getDFT(),
+		             dynamicModules);
+	}
+	cc.flush();
+	if (loadRes || !FileSystem::exists(mod)) {
+		messageFormatter->reportError("Could not modularize `" + dftOriginal.getFileName() + "'");
+		return 1;
 	}
-	if(!reuse || !FileSystem::exists(mod)) {
-		messageFormatter->reportAction("Modularizing DFT...",VERBOSITY_FLOW);
-		std::vector<std::string> arguments;
-		arguments.push_back("--verbose=" + std::to_string(messageFormatter->getVerbosity()));
-		arguments.push_back("-m");
-		arguments.push_back(mod.getFileRealPath());
-		arguments.push_back(dftOriginal.getFileRealPath());
-		if (exec.runCommand(dft2lntcExec.getFilePath(), arguments, "dft2lntc", mod) == "")
-			return 1;
+
+	/* The MTTF is combined from the phase-type distributions of the
+	 * modules, so it is calculated without modularization if some
+	 * module does not have one.
+	 */
+	std::vector<Query> modularQueries, mttfQueries;
+	for (const Query &q : queries) {
+		if (q.type == EXPECTEDTIME)
+			mttfQueries.push_back(q);
+		else
+			modularQueries.push_back(q);
+	}
+	if (mttfQueries.empty() || modulesHavePhaseType(translator.getDFT())) {
+		modularQueries = queries;
+		mttfQueries.clear();
 	} else {
-		messageFormatter->reportAction("Reusing modules file",VERBOSITY_FLOW);
-	}
+		messageFormatter->reportWarning("Some module can be repaired, has time-dependent behaviour or may be nondeterministic: Calculating the MTTF without modularization.");
+	}
+	/* Calculated into a result of its own, since it may be cached */
+	auto calculateMTTF = [&]() {
+		DFT::DFTCalculationResult mttf;
+		int res = calculateDFT(reuse, cwd, dftOriginal, mttfQueries,
+		                       useChecker, useConverter,
+		                       warnNonDeterminism, "", mttf, expOnly,
+		                       exactMode);
+		ret.failProbs.insert(ret.failProbs.end(),
+		                     mttf.failProbs.begin(), mttf.failProbs.end());
+		ret.stats = mttf.stats;
+		return res;
+	};
+	if (modularQueries.empty())
+		return calculateMTTF();
 	std::string* tmp = FileSystem::load(mod);
 	if (!tmp) {
 		messageFormatter->reportError("Error loading modules file");
@@ -349,12 +461,47 @@ int DFT::DFTCalc::calcModular(const bool reuse,
 	std::string modules;
 	std::swap(modules, *tmp);
 	delete tmp;
-	return checkModule(reuse, cwd, dftOriginal, queries, useChecker,
-	                   useConverter, warnNonDeterminism, ret, expOnly, exactMode, modules);
+	if (modules.empty()) {
+		messageFormatter->reportError("Modules file empty.");
+		return 1;
+	}
+	DFTModule top;
+	size_t pos = 0;
+	if (parseModule(modules, pos, top))
+		return 1;
+	int res = checkModule(reuse, cwd, dftOriginal, modularQueries,
+	                      useChecker, useConverter, warnNonDeterminism,
+	                      ret, expOnly, exactMode, &translator, top);
+	if (res || mttfQueries.empty())
+		return res;
+	return calculateMTTF();
+}
+
+/**
+ * Returns the probability that at least votCount of the events with the
+ * specified probabilities occur, assuming they are independent.
+ * Takes O(N * votCount) operations: after processing some of the events,
+ * atLeast[j] is the probability that exactly j of them occurred, except
+ * for atLeast[votCount] which is the probability that at least votCount
+ * occurred.
+ */
+static interval votingProbability(const std::vector<decnumber<>> &P,
+                                  size_t votCount)
+{
+	std::vector<interval> atLeast(votCount + 1, interval(decnumber<>(0)));
+	atLeast[0] = interval(decnumber<>(1));
+	for (const decnumber<> &prob : P) {
+		interval p(prob), q = p.complement();
+		atLeast[votCount] += atLeast[votCount - 1] * p;
+		for (size_t j = votCount - 1; j > 0; j--)
+			atLeast[j] = atLeast[j] * q + atLeast[j - 1] * p;
+		atLeast[0] *= q;
+	}
+	return atLeast[votCount];
 }
 
 static void addVoteResults(DFT::DFTCalculationResultItem &ret,
-                           std::vector<DFT::DFTCalculationResultItem> P,
+                           const std::vector<DFT::DFTCalculationResultItem> &P,
 			   size_t votCount)
 {
 	if (votCount == 0) {
@@ -364,23 +511,17 @@ static void addVoteResults(DFT::DFTCalculationResultItem &ret,
 		ret.lowerBound = ret.upperBound = (uintmax_t)0;
 		return;
 	}
-	DFT::DFTCalculationResultItem cur = P[0];
-	P.erase(P.begin());
-	/* P{k/N}(X1, X2, ..., XN)
-	 * = P(X1)*P{(k-1)/(N-1)}(X2, ..., XN)
-	 *   + (1-P(X1))*P{k/(N-1)}(X2, ..., XN)
-	 */
-	addVoteResults(ret, P, votCount - 1);
-	decnumber<> loSum = cur.lowerBound * ret.lowerBound;
-	decnumber<> upSum = cur.upperBound * ret.upperBound;
-	addVoteResults(ret, P, votCount);
-	/* In the next part we swap the lower and upper bounds of the
-	 * current entry due to the subtraction.
+	/* The probability of a voting gate failing only increases with the
+	 * probabilities of its children failing, so the bounds follow from
+	 * the bounds of the children.
 	 */
-	loSum += (decnumber<>(1) - cur.upperBound) * ret.lowerBound;
-	upSum += (decnumber<>(1) - cur.lowerBound) * ret.upperBound;
-	ret.lowerBound = loSum;
-	ret.upperBound = upSum;
+	std::vector<decnumber<>> lower, upper;
+	for (const DFT::DFTCalculationResultItem &it : P) {
+		lower.push_back(it.lowerBound);
+		upper.push_back(it.upperBound);
+	}
+	ret.lowerBound = votingProbability(lower, votCount).lower();
+	ret.upperBound = votingProbability(upper, votCount).upper();
 }
 
 static void addVoteResults(std::vector<DFT::DFTCalculationResultItem> &ret,
@@ -414,110 +555,809 @@ static void addVoteResults(std::vector<DFT::DFTCalculationResultItem> &ret,
 	}
 }
 
-int DFT::DFTCalc::checkModule(const bool reuse,
-                              const std::string& cwd,
-                              const File& dft,
-                              const std::vector<Query> &queries,
-                              enum DFT::checker useChecker,
-                              enum DFT::converter useConverter,
-                              bool warnNonDeterminism,
-                              DFT::DFTCalculationResult &ret,
-                              bool expOnly,
-                              bool exactMode,
-                              std::string &module)
+int DFT::DFTCalc::parseModule(const std::string &modules,
+                              size_t &pos,
+                              DFTModule &ret)
 {
-	if (module.length() == 0) {
-		messageFormatter->reportError("Modules file empty.");
+	if (pos >= modules.length()) {
+		messageFormatter->reportError("Modules contains too few entries for module.");
 		return 1;
 	}
-	size_t eol = module.find('\n');
+	size_t eol = modules.find('\n', pos);
 	if (eol == std::string::npos)
-		eol = module.length();
-	if (module[0] == 'M') {
-		std::string root = module.substr(1, eol - 1);
-		module = module.substr(eol + 1);
-		return calculateDFT(reuse, cwd, dft, queries, useChecker,
-		                    useConverter, warnNonDeterminism, root, ret,
-		                    expOnly, exactMode);
-	} else if (module[0] == '=') {
-		decnumber<> val(module.substr(1, eol - 1));
-		module = module.substr(eol + 1);
-		std::vector<Query> tmp = queries;
-		expandRangeQueries(tmp);
-		for (Query q : tmp) {
-			DFT::DFTCalculationResultItem it(q);
-			it.exactBounds = true;
-			it.lowerBound = it.upperBound = val;
-			ret.failProbs.push_back(it);
+		eol = modules.length();
+	std::string line = modules.substr(pos, eol - pos);
+	pos = eol + 1;
+	if (line.empty()) {
+		messageFormatter->reportError("Modules contains too few entries for module.");
+		return 1;
+	}
+	ret.type = line[0];
+	if (ret.type == 'D') {
+		/* D<children>#<structure> <root> */
+		size_t hash = line.find('#');
+		size_t sp = line.find(' ');
+		if (hash == std::string::npos || sp == std::string::npos || sp < hash) {
+			messageFormatter->reportError("Improperly formatted modules file: dynamic module without name.");
+			return 1;
+		}
+		ret.structure = line.substr(hash + 1, sp - hash - 1);
+		ret.value = line.substr(sp + 1);
+		ret.children.resize(std::stoul(line.substr(1, hash - 1)));
+		for (DFTModule &child : ret.children) {
+			if (parseModule(modules, pos, child))
+				return 1;
 		}
 		return 0;
+	} else if (ret.type == 'M' && line.size() > 1 && line[1] == '#') {
+		size_t sp = line.find(' ');
+		if (sp == std::string::npos) {
+			messageFormatter->reportError("Improperly formatted modules file: module without name.");
+			return 1;
+		}
+		ret.structure = line.substr(2, sp - 2);
+		ret.value = line.substr(sp + 1);
+		return 0;
+	} else if (ret.type == 'M' || ret.type == '=') {
+		ret.value = line.substr(1);
+		return 0;
+	} else if (ret.type == 'E') {
+		size_t sp = line.find(' ');
+		if (sp == std::string::npos) {
+			messageFormatter->reportError("Improperly formatted modules file: basic event without name.");
+			return 1;
+		}
+		ret.rate = line.substr(1, sp - 1);
+		ret.value = line.substr(sp + 1);
+		return 0;
+	} else if (ret.type != '*' && ret.type != '+' && ret.type != '/') {
+		messageFormatter->reportError(std::string("Unknown module type: ") + ret.type);
+		return 1;
 	}
-	char op = module[0];
 	std::string numStr;
-	unsigned long votCount = 0;
-	if (op != '/') {
-		numStr = module.substr(1, eol);
+	if (ret.type != '/') {
+		numStr = line.substr(1);
 	} else {
-		size_t sp = module.find(' ');
+		size_t sp = line.find(' ');
 		if (sp == std::string::npos) {
 			messageFormatter->reportError("Improperly formatted modules file: voting gate without child count.");
 			return 1;
 		}
-		numStr = module.substr(sp + 1, eol);
-		votCount = std::stoul(module.substr(1, sp));
+		numStr = line.substr(sp + 1);
+		ret.votCount = std::stoul(line.substr(1, sp));
 	}
-	module = module.substr(eol + 1);
 	unsigned long num = std::stoul(numStr);
-	std::vector<DFT::DFTCalculationResultItem> gather;
-	std::vector<DFT::DFTCalculationResult> votResults;
-	for (unsigned long i = 0; i < num; i++) {
-		DFT::DFTCalculationResult tmp;
-		if (module.empty()) {
-			messageFormatter->reportError("Modules contains too few entries for module.");
+	ret.children.resize(num);
+	for (DFTModule &child : ret.children) {
+		if (parseModule(modules, pos, child))
 			return 1;
+	}
+	return 0;
+}
+
+/**
+ * Combines the results of all children of the specified module into the
+ * result of the module itself.
+ * @return 0 if successful, non-zero otherwise
+ */
+static int combineModule(DFT::DFTModule &module, MessageFormatter &mf)
+{
+	/* The margins of the checkers may extend past [0, 1], while the
+	 * error allocation (see allocateErrors()) relies on every result
+	 * being a probability.
+	 */
+	const decnumber<> zero(0), one(1);
+	for (DFT::DFTModule &child : module.children) {
+		for (DFT::DFTCalculationResultItem &it : child.result.failProbs) {
+			if (it.lowerBound < zero)
+				it.lowerBound = zero;
+			if (it.upperBound > one)
+				it.upperBound = one;
 		}
-		if (checkModule(reuse, cwd, dft, queries, useChecker, useConverter,
-		                warnNonDeterminism, tmp, expOnly, exactMode, module))
-			return 1;
-		if (op == '/') {
-			votResults.push_back(tmp);
-		} else if (i == 0) {
+	}
+	if (module.type == '/') {
+		std::vector<DFT::DFTCalculationResult> votResults;
+		for (DFT::DFTModule &child : module.children)
+			votResults.push_back(child.result);
+		addVoteResults(module.result.failProbs, votResults, mf, module.votCount);
+		return 0;
+	}
+	/* The product of the probabilities of the children (for an AND),
+	 * or of their complements (for an OR), for every result.
+	 */
+	std::vector<DFT::DFTCalculationResultItem> gather;
+	std::vector<interval> product;
+	for (size_t i = 0; i < module.children.size(); i++) {
+		DFT::DFTCalculationResult &tmp = module.children[i].result;
+		if (i == 0)
 			gather = tmp.failProbs;
+		if (gather.size() != tmp.failProbs.size()) {
+			mf.reportError("Unequal number of results for modules.");
+			return 1;
+		}
+		for (size_t j = 0; j < gather.size(); j++) {
+			const DFT::DFTCalculationResultItem &add = tmp.failProbs[j];
+			if (gather[j].missionTime != add.missionTime
+			    || gather[j].mrmcCommand != add.mrmcCommand)
+			{
+				mf.reportError("Unequal order/type of results for modules.");
+				return 1;
+			}
+			interval p(add.lowerBound, add.upperBound);
+			if (module.type != '*')
+				p = p.complement();
+			if (i == 0)
+				product.push_back(p);
+			else
+				product[j] *= p;
+		}
+	}
+	for (size_t j = 0; j < gather.size(); j++) {
+		interval p = module.type == '*' ? product[j] : product[j].complement();
+		gather[j].lowerBound = p.lower();
+		gather[j].upperBound = p.upper();
+	}
+	module.result.failProbs.insert(module.result.failProbs.begin(), gather.begin(), gather.end());
+	return 0;
+}
+
+/**
+ * Whether the results of an exponentially distributed basic event can be
+ * calculated directly (instead of by a model checker) for all queries.
+ */
+static bool isClosedForm(const std::vector<Query> &queries)
+{
+	for (const Query &q : queries) {
+		if (q.type != TIMEBOUND && q.type != UNBOUNDED && q.type != STEADY)
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Calculates the results of an exponentially distributed basic event
+ * that cannot be repaired ('E' module).
+ */
+static void calculateExponential(DFT::DFTModule &module,
+                                 const std::vector<Query> &queries)
+{
+	decnumber<> rate(module.rate), zero(0), one(1);
+	/* Relative error of the probabilities, well above the error of
+	 * long double arithmetic.
+	 */
+	decnumber<> margin("1e-14");
+	std::vector<Query> tmp = queries;
+	expandRangeQueries(tmp);
+	for (Query q : tmp) {
+		DFT::DFTCalculationResultItem it(q);
+		it.exactBounds = true;
+		if (rate.is_zero()) {
+			it.lowerBound = it.upperBound = zero;
+		} else if (q.type == TIMEBOUND) {
+			/* The event stays failed once it fails, so it fails
+			 * within [l, u] iff it fails before u.
+			 */
+			decnumber<> p = zero - expm1(zero - rate * q.upperBound);
+			it.lowerBound = p - p * margin;
+			it.upperBound = p + p * margin;
+			if (it.upperBound > one)
+				it.upperBound = one;
 		} else {
-			if (gather.size() != tmp.failProbs.size()) {
-				messageFormatter->reportError("Unequal number of results for modules.");
+			/* UNBOUNDED and STEADY */
+			it.lowerBound = it.upperBound = one;
+		}
+		module.result.failProbs.push_back(it);
+	}
+}
+
+/**
+ * Links every module to its parent and collects the modules without
+ * children (i.e., the ones that can be calculated right away).
+ */
+static void prepareModules(DFT::DFTModule &module,
+                           std::vector<DFT::DFTModule *> &ready)
+{
+	module.pending = module.children.size();
+	module.result = DFT::DFTCalculationResult();
+	module.copies.clear();
+	module.distribution.reset();
+	if (module.children.empty())
+		ready.push_back(&module);
+	for (DFT::DFTModule &child : module.children) {
+		child.parent = &module;
+		prepareModules(child, ready);
+	}
+}
+
+/**
+ * Calculates bounds on the probability of every module failing that are
+ * known before any module is calculated: the value of constant modules
+ * and of exponential basic events calculated in closed form, and [0, 1]
+ * for modules that need a model checker.
+ * The bounds hold for every query.
+ */
+static void estimateBounds(const DFT::DFTModule &module,
+                           const std::vector<Query> &queries,
+                           bool closedForm,
+                           std::unordered_map<const DFT::DFTModule *, std::pair<long double, long double>> &bounds)
+{
+	long double lower = 0, upper = 1;
+	if (module.type == '=') {
+		lower = upper = (long double)decnumber<>(module.value);
+	} else if (module.type == 'E' && closedForm) {
+		long double rate = (long double)decnumber<>(module.rate);
+		long double maxTime = 0;
+		for (const Query &q : queries) {
+			if (q.type != TIMEBOUND) {
+				maxTime = std::numeric_limits<long double>::infinity();
+				break;
+			}
+			maxTime = std::max(maxTime, (long double)q.upperBound);
+		}
+		/* Including the margin added by calculateExponential() */
+		upper = rate > 0 ? -expm1l(-rate * maxTime) * (1 + 1e-13L) : 0;
+		upper = std::min(upper, (long double)1);
+	} else if (module.type == '*' || module.type == '+') {
+		/* For an OR, the product of the complements */
+		long double lowerProduct = 1, upperProduct = 1;
+		for (const DFT::DFTModule &child : module.children) {
+			estimateBounds(child, queries, closedForm, bounds);
+			std::pair<long double, long double> b = bounds[&child];
+			if (module.type == '*') {
+				lowerProduct *= b.first;
+				upperProduct *= b.second;
+			} else {
+				lowerProduct *= 1 - b.second;
+				upperProduct *= 1 - b.first;
+			}
+		}
+		lower = module.type == '*' ? lowerProduct : 1 - upperProduct;
+		upper = module.type == '*' ? upperProduct : 1 - lowerProduct;
+	} else {
+		for (const DFT::DFTModule &child : module.children)
+			estimateBounds(child, queries, closedForm, bounds);
+	}
+	bounds[&module] = std::make_pair(lower, upper);
+}
+
+/**
+ * Finds the modules that need a model checker, with an upper bound on the
+ * sensitivity of the result of the top module to each of them (i.e., by
+ * how much the top result can change per unit change of the module).
+ * @param sensitivity The sensitivity of the top module to this module.
+ */
+static void findSensitivities(DFT::DFTModule &module,
+                              long double sensitivity,
+                              bool closedForm,
+                              const std::unordered_map<const DFT::DFTModule *, std::pair<long double, long double>> &bounds,
+                              std::vector<std::pair<DFT::DFTModule *, long double>> &checked)
+{
+	if (module.type == 'M' || module.type == 'D'
+	    || (module.type == 'E' && !closedForm))
+	{
+		checked.push_back(std::make_pair(&module, sensitivity));
+		return;
+	}
+	/* The derivative of an AND to a child is the product of the other
+	 * children, of an OR the product of the complements of the other
+	 * children, and of a voting gate the probability that exactly one
+	 * fewer than needed of the other children fail (at most 1).
+	 */
+	for (size_t i = 0; i < module.children.size(); i++) {
+		long double s = sensitivity;
+		for (size_t j = 0; j < module.children.size() && s > 0; j++) {
+			if (i == j)
+				continue;
+			const std::pair<long double, long double> &b = bounds.at(&module.children[j]);
+			if (module.type == '*')
+				s *= b.second;
+			else if (module.type == '+')
+				s *= 1 - b.first;
+		}
+		findSensitivities(module.children[i], s, closedForm, bounds, checked);
+	}
+}
+
+/**
+ * Divides the error bound of the queries over the modules that need a
+ * model checker. The error in the result of the top module is at most
+ * the sum of the errors of these modules weighted by their
+ * sensitivities, so each module gets an equal part of the error of the
+ * top module: with N such modules, a module with sensitivity s is
+ * checked with error bound E / (N * s). This keeps the top result within
+ * the requested bound E, while modules with little influence on it are
+ * checked with looser (i.e., cheaper) bounds.
+ *
+ * The sum is an upper bound including the higher-order terms of the
+ * interval products: the top result is multilinear in the results of the
+ * modules, so widening the modules one at a time changes it by at most
+ * the largest derivative to that module times its error, and the
+ * sensitivities are the largest derivatives over all results within
+ * the bounds of estimateBounds(), which contain every module's interval.
+ * The closed-form basic events share one more part for their margins,
+ * and the parts are slightly reduced to absorb the rounding of these
+ * long double calculations.
+ */
+static void allocateErrors(DFT::DFTModule &top,
+                           const std::vector<Query> &queries,
+                           bool closedForm)
+{
+	std::unordered_map<const DFT::DFTModule *, std::pair<long double, long double>> bounds;
+	estimateBounds(top, queries, closedForm, bounds);
+	std::vector<std::pair<DFT::DFTModule *, long double>> checked;
+	findSensitivities(top, 1, closedForm, bounds, checked);
+	const long double safety = 0.99L;
+	size_t n = 0;
+	for (const auto &c : checked) {
+		if (c.second > 0)
+			n++;
+	}
+	for (const auto &b : bounds) {
+		if (b.first->type == 'E' && closedForm) {
+			n++;
+			break;
+		}
+	}
+	for (auto &c : checked) {
+		/* Modules not influencing the result need no precision */
+		if (c.second <= 0)
+			c.first->errorShare = std::numeric_limits<long double>::infinity();
+		else
+			c.first->errorShare = safety / (n * std::min(c.second, (long double)1));
+	}
+}
+
+/**
+ * Returns the queries to check the specified module with, i.e. with the
+ * error bounds allotted to the module.
+ */
+static std::vector<Query> moduleQueries(const DFT::DFTModule &module,
+                                        const std::vector<Query> &queries)
+{
+	/* Looser bounds would tell us nothing about the module */
+	const decnumber<> maxError("0.1");
+	std::vector<Query> ret = queries;
+	for (Query &q : ret) {
+		if (!q.errorBoundSet || module.errorShare == 1)
+			continue;
+		decnumber<> limit = q.errorBound < maxError ? maxError : q.errorBound;
+		decnumber<> bound = limit;
+		if (module.errorShare != std::numeric_limits<long double>::infinity())
+			bound = (q.errorBound * decnumber<>(module.errorShare)).round(3, false);
+		q.errorBound = limit < bound ? limit : bound;
+	}
+	return ret;
+}
+
+/**
+ * Whether the module is analysed for its time to failure, to be
+ * substituted into its parent, rather than for the queries.
+ */
+static bool isPhaseTypeModule(const DFT::DFTModule &module)
+{
+	return module.parent && module.parent->type == 'D';
+}
+
+/**
+ * Removes the modules identical to an earlier module (by structure, or by
+ * failure rate for basic events) from the modules to be calculated,
+ * making them copies of the earlier module instead. The remaining module
+ * is calculated with the smallest error bound of all its copies.
+ */
+static void mergeIdentical(std::vector<DFT::DFTModule *> &ready,
+                           bool closedForm)
+{
+	std::unordered_map<std::string, DFT::DFTModule *> first;
+	std::vector<DFT::DFTModule *> distinct;
+	for (DFT::DFTModule *module : ready) {
+		std::string key;
+		if (module->type == 'M' && !module->structure.empty())
+			key = (isPhaseTypeModule(*module) ? "P" : "M") + module->structure;
+		else if (module->type == 'E' && !closedForm)
+			key = "E" + module->rate;
+		if (!key.empty()) {
+			auto original = first.find(key);
+			if (original != first.end()) {
+				DFT::DFTModule *o = original->second;
+				o->copies.push_back(module);
+				o->errorShare = std::min(o->errorShare, module->errorShare);
+				continue;
+			}
+			first[key] = module;
+		}
+		distinct.push_back(module);
+	}
+	ready.swap(distinct);
+}
+
+/**
+ * Returns the probability that a module has failed, given that of every
+ * module with a time-to-failure distribution, assuming the modules are
+ * independent.
+ */
+static long double failedProbability(const DFT::DFTModule &module,
+                                     const std::function<long double(const DFT::PhaseType *)> &failed)
+{
+	if (module.distribution)
+		return failed(module.distribution.get());
+	if (module.type == '=')
+		return (long double)decnumber<>(module.value);
+	if (module.type == '/') {
+		/* As votingProbability() */
+		std::vector<long double> atLeast(module.votCount + 1, 0);
+		atLeast[0] = 1;
+		for (const DFT::DFTModule &child : module.children) {
+			long double p = failedProbability(child, failed);
+			atLeast[module.votCount] += atLeast[module.votCount - 1] * p;
+			for (size_t j = module.votCount - 1; j > 0; j--)
+				atLeast[j] = atLeast[j] * (1 - p) + atLeast[j - 1] * p;
+			atLeast[0] *= 1 - p;
+		}
+		return atLeast[module.votCount];
+	}
+	long double product = 1;
+	for (const DFT::DFTModule &child : module.children) {
+		long double p = failedProbability(child, failed);
+		product *= module.type == '*' ? p : 1 - p;
+	}
+	return module.type == '*' ? product : 1 - product;
+}
+
+/**
+ * Calculates the MTTF of a tree of static modules whose leaves have
+ * known time-to-failure distributions, by integrating the probability
+ * that the top module has not failed yet over time. This probability is
+ * evaluated by transient analysis of every distribution, and integrated
+ * by adaptive Simpson quadrature.
+ * As the checkers do, the result is widened by the error bound of each
+ * query (1e-6 by default). The integration is refined until its
+ * estimated error is at most a quarter of the smallest bound, but this
+ * estimate is not a proven bound, so the results are not exact bounds.
+ * @return 0 if successful, non-zero if the MTTF is infinite
+ */
+static int integrateMTTF(const DFT::DFTModule &top,
+                         const std::vector<Query> &queries,
+                         DFT::DFTCalculationResult &ret,
+                         MessageFormatter &mf)
+{
+	/* Relative error allowed per step, so also for the total */
+	const long double tolerance = 1e-10;
+	long double maxError = 1;
+	for (const Query &q : queries) {
+		long double bound = q.errorBoundSet ? (long double)q.errorBound : 1e-6L;
+		maxError = std::min(maxError, bound);
+	}
+	std::vector<const DFT::PhaseType *> distributions;
+	std::function<void(const DFT::DFTModule &)> collect;
+	collect = [&](const DFT::DFTModule &module) {
+		if (module.distribution)
+			distributions.push_back(module.distribution.get());
+		else
+			for (const DFT::DFTModule &child : module.children)
+				collect(child);
+	};
+	collect(top);
+
+	std::unordered_map<const DFT::PhaseType *, long double> eventually;
+	for (const DFT::PhaseType *ph : distributions)
+		eventually[ph] = ph->getFailureProbability();
+	long double never = 1 - failedProbability(top,
+		[&](const DFT::PhaseType *ph) { return eventually[ph]; });
+	if (never > 1e-12L) {
+		mf.reportError("The DFT has probability " + std::to_string((double)never) + " of never failing, so its MTTF is infinite.");
+		return 1;
+	}
+	never = std::max(never, (long double)0);
+
+	std::vector<DFT::PhaseTypeTransient> transient;
+	std::unordered_map<const DFT::PhaseType *, size_t> index;
+	long double maxRate = 0;
+	for (const DFT::PhaseType *ph : distributions) {
+		if (index.emplace(ph, transient.size()).second) {
+			transient.emplace_back(*ph);
+			maxRate = std::max(maxRate, transient.back().getRate());
+		}
+	}
+	auto survival = [&]() {
+		long double s = 1 - failedProbability(top,
+			[&](const DFT::PhaseType *ph) { return transient[index[ph]].getFailed(); });
+		return std::max(s - never, (long double)0);
+	};
+
+	/* Integrates with the specified relative tolerance into mttf */
+	auto integrate = [&](long double tol, long double &mttf) {
+		mttf = 0;
+		long double h = maxRate > 0 ? 1 / (8 * maxRate) : 1;
+		long double s0 = survival();
+		for (size_t steps = 0; s0 > 0; steps++) {
+			if (steps > 10000000) {
+				mf.reportError("Could not integrate the survival function of the DFT.");
 				return 1;
 			}
-			for (size_t i = gather.size() - 1; i != SIZE_MAX; i--) {
-				DFT::DFTCalculationResultItem &old = gather[i];
-				DFT::DFTCalculationResultItem add = tmp.failProbs[i];
-				if (old.missionTime != add.missionTime
-				    || old.mrmcCommand != add.mrmcCommand)
-				{
-					messageFormatter->reportError("Unequal order/type of results for modules.");
-					return 1;
-				}
-				if (op == '*') {
-					old.lowerBound *= add.lowerBound;
-					old.upperBound *= add.upperBound;
-				} else if (op == '+') {
-					decnumber<> one(1);
-					old.lowerBound = (one - (one - old.lowerBound)
-					                      * (one - add.lowerBound));
-					old.upperBound = (one - (one - old.upperBound)
-					                      * (one - add.upperBound));
-				} else {
-					messageFormatter->reportError(std::string("Unknown module type: ") + op);
-					return 1;
+			/* Simpson's rule over the whole step and over both halves,
+			 * whose difference estimates the error.
+			 */
+			std::vector<DFT::PhaseTypeTransient> start = transient;
+			long double s[5];
+			s[0] = s0;
+			for (int i = 1; i < 5; i++) {
+				for (DFT::PhaseTypeTransient &tr : transient)
+					tr.advance(h / 4);
+				s[i] = survival();
+			}
+			long double whole = h / 6 * (s[0] + 4 * s[2] + s[4]);
+			long double halves = h / 12 * (s[0] + 4 * s[1] + 2 * s[2] + 4 * s[3] + s[4]);
+			long double error = std::fabs(halves - whole) / 15;
+			if (error > tol * halves && h * maxRate > 1e-6L) {
+				transient.swap(start);
+				h /= 2;
+				continue;
+			}
+			mttf += halves + (halves - whole) / 15;
+			/* Once the survival probability decays geometrically, the
+			 * rest of the integral is that of an exponential.
+			 */
+			if (s[4] < s[0]) {
+				long double decay = std::log(s[4] / s[0]) / h;
+				long double tail = -s[4] / decay;
+				if (tail < tol * mttf) {
+					mttf += tail;
+					break;
 				}
 			}
+			if (error < tol * halves / 32)
+				h *= 2;
+			s0 = s[4];
 		}
+		return 0;
+	};
+
+	long double mttf;
+	const std::vector<DFT::PhaseTypeTransient> initial = transient;
+	if (integrate(tolerance, mttf))
+		return 1;
+	/* Integrate again if the error may exceed a quarter of the error
+	 * bound, up to the precision of long double.
+	 */
+	if (mttf * tolerance > maxError / 4) {
+		transient = initial;
+		if (integrate(std::max(maxError / (4 * mttf), 1e-17L), mttf))
+			return 1;
 	}
-	if (op != '/') {
-		ret.failProbs.insert(ret.failProbs.begin(), gather.begin(), gather.end());
+
+	decnumber<> value(mttf);
+	for (const Query &q : queries) {
+		DFT::DFTCalculationResultItem it(q);
+		decnumber<> margin = q.errorBoundSet ? q.errorBound : decnumber<>("1e-6");
+		margin *= 0.5;
+		it.exactBounds = false;
+		it.lowerBound = (value - margin).round(12, false);
+		it.upperBound = (value + margin).round(12, true);
+		if (it.lowerBound < decnumber<>(0))
+			it.lowerBound = (intmax_t)0;
+		ret.failProbs.push_back(it);
+	}
+	return 0;
+}
+
+int DFT::DFTCalc::checkModule(const bool reuse,
+                              const std::string& cwd,
+                              const File& dft,
+                              const std::vector<Query> &queries,
+                              enum DFT::checker useChecker,
+                              enum DFT::converter useConverter,
+                              bool warnNonDeterminism,
+                              DFT::DFTCalculationResult &ret,
+                              bool expOnly,
+                              bool exactMode,
+                              Translator *source,
+                              DFTModule &top)
+{
+	/* The MTTF of static modules follows from the distributions of
+	 * their children, which are calculated instead of the queries.
+	 */
+	bool timeToFailure = false;
+	std::vector<Query> otherQueries, mttfQueries;
+	for (const Query &q : queries) {
+		if (q.type == EXPECTEDTIME)
+			mttfQueries.push_back(q);
+		else
+			otherQueries.push_back(q);
+	}
+	if (!mttfQueries.empty()
+	    && (top.type == '*' || top.type == '+' || top.type == '/'))
+	{
+		timeToFailure = true;
+		if (!otherQueries.empty()) {
+			int res = checkModule(reuse, cwd, dft, otherQueries,
+			                      useChecker, useConverter,
+			                      warnNonDeterminism, ret, expOnly,
+			                      exactMode, source, top);
+			if (res)
+				return res;
+		}
+	}
+
+	std::vector<DFTModule *> ready;
+	top.parent = nullptr;
+	prepareModules(top, ready);
+
+	Trace::Span span(trace, "modules", "module");
+	span.addArg("ready", ready.size());
+
+	/* Basic events are only sent to the model checker if some query
+	 * cannot be answered directly.
+	 */
+	bool closedForm = isClosedForm(queries);
+
+	bool errorBoundSet = false;
+	for (const Query &q : queries)
+		errorBoundSet = errorBoundSet || q.errorBoundSet;
+	if (errorBoundSet && !timeToFailure)
+		allocateErrors(top, queries, closedForm);
+	mergeIdentical(ready, closedForm);
+	span.addArg("distinct", ready.size());
+
+	std::atomic<size_t> next(0);
+	std::atomic<bool> failed(false);
+	std::atomic<bool> limited(false);
+	std::mutex pendingLock;
+
+	/* Substituted into the 'D' modules by translateDFT() */
+	const std::string dftKey = dft.getFileRealPath();
+	auto registerPhaseType = [&](const DFTModule *module) {
+		if (module->phaseType.empty())
+			return;
+		std::lock_guard<std::mutex> guard(cachedResultsLock);
+		phaseTypes[dftKey][module->value] = module->phaseType;
+	};
+
+	/* Calculates a module whose children (if any) have been calculated */
+	auto calculate = [&](DFTModule *module) {
+		int res = 0;
+		bool named = module->type == 'M' || module->type == 'D'
+		             || module->type == 'E';
+		Trace::Span moduleSpan(trace, named
+		                              ? "module " + module->value
+		                              : "constant", "module");
+		moduleSpan.addArg("root", module->value);
+		if (isPhaseTypeModule(*module)) {
+			File aut;
+			res = extractPhaseType(reuse, cwd, dft, useConverter,
+			                       module->value, source, aut, expOnly,
+			                       &failed);
+			if (!res && !expOnly)
+				module->phaseType = aut.getFileRealPath();
+		} else if (timeToFailure && (module->type == 'M' || module->type == 'D')) {
+			File aut;
+			auto ph = std::make_shared<PhaseType>();
+			res = extractPhaseType(reuse, cwd, dft, useConverter,
+			                       module->value, source, aut, expOnly,
+			                       &failed, ph.get());
+			if (!res && !expOnly)
+				module->distribution = ph;
+		} else if (timeToFailure && module->type == 'E') {
+			decnumber<> rate(module->rate);
+			module->distribution = std::make_shared<PhaseType>(PhaseType::exponential(rate));
+		} else if (timeToFailure) {
+			/* Constants and static modules are combined by
+			 * integrateMTTF()
+			 */
+		} else if (module->type == 'E' && closedForm) {
+			calculateExponential(*module, queries);
+		} else if (module->type == 'M' || module->type == 'D'
+		           || module->type == 'E')
+		{
+			std::vector<Query> mq = moduleQueries(*module, queries);
+			if (module->errorShare != 1 && !mq.empty())
+				moduleSpan.addArg("errorBound", mq[0].errorBound.str());
+			res = calculateDFT(reuse, cwd, dft, mq,
+			                   useChecker, useConverter,
+			                   warnNonDeterminism,
+			                   module->value,
+			                   module->result, expOnly,
+			                   exactMode, &failed, source);
+		} else if (module->type == '=') {
+			decnumber<> val(module->value);
+			std::vector<Query> tmp = queries;
+			expandRangeQueries(tmp);
+			for (Query q : tmp) {
+				DFT::DFTCalculationResultItem it(q);
+				it.exactBounds = true;
+				it.lowerBound = it.upperBound = val;
+				module->result.failProbs.push_back(it);
+			}
+		} else {
+			res = combineModule(*module, *messageFormatter);
+		}
+		moduleSpan.addArg("status", std::to_string(res));
+		if (!module->copies.empty())
+			moduleSpan.addArg("copies", module->copies.size());
+		return res;
+	};
+
+	/* Every worker takes the next module without children, calculates
+	 * it, and then combines each ancestor for which it finished the
+	 * last outstanding child ('D' modules are calculated with their
+	 * children substituted instead).
+	 */
+	auto worker = [&]() {
+		size_t i;
+		while (!failed && (i = next++) < ready.size()) {
+			DFTModule *module = ready[i];
+			int res = 0;
+			try {
+				res = calculate(module);
+				std::vector<DFTModule *> finished(1, module);
+				for (DFTModule *copy : module->copies) {
+					copy->result = module->result;
+					copy->phaseType = module->phaseType;
+					copy->distribution = module->distribution;
+					finished.push_back(copy);
+				}
+				for (DFTModule *done : finished) {
+					registerPhaseType(done);
+					while (!res && done->parent) {
+						DFTModule *parent = done->parent;
+						{
+							std::lock_guard<std::mutex> guard(pendingLock);
+							if (--parent->pending)
+								break;
+						}
+						done = parent;
+						if (done->type == 'D') {
+							res = calculate(done);
+							registerPhaseType(done);
+							continue;
+						}
+						if (timeToFailure)
+							continue;
+						Trace::Span combine(trace, std::string("combine ") + done->type, "module");
+						combine.addArg("children", done->children.size());
+						res = combineModule(*done, *messageFormatter);
+					}
+				}
+			} catch (std::exception &e) {
+				messageFormatter->reportError(e.what());
+				res = 1;
+			}
+			if (res == LIMIT_EXCEEDED)
+				limited = true;
+			if (res)
+				failed = true;
+		}
+	};
+
+	size_t nThreads = std::min((size_t)jobs, ready.size());
+	if (nThreads > 1) {
+		messageFormatter->reportAction("Calculating " + std::to_string(ready.size()) + " modules using " + std::to_string(nThreads) + " jobs", VERBOSITY_FLOW);
+		std::vector<std::thread> threads;
+		for (size_t i = 0; i < nThreads; i++)
+			threads.emplace_back(worker);
+		for (std::thread &t : threads)
+			t.join();
 	} else {
-		addVoteResults(ret.failProbs, votResults, *messageFormatter, votCount);
+		worker();
 	}
+	{
+		std::lock_guard<std::mutex> guard(cachedResultsLock);
+		phaseTypes.erase(dftKey);
+	}
+	if (failed)
+		return limited ? LIMIT_EXCEEDED : 1;
+
+	if (timeToFailure) {
+		if (expOnly)
+			return 0;
+		messageFormatter->reportAction("Integrating survival function...",VERBOSITY_FLOW);
+		Trace::Span integrate(trace, "integrate", "module");
+		return integrateMTTF(top, mttfQueries, ret, *messageFormatter);
+	}
+	ret.failProbs.insert(ret.failProbs.end(),
+	                     top.result.failProbs.begin(),
+	                     top.result.failProbs.end());
+	if (top.type == 'M' || top.type == 'D')
+		ret.stats = top.result.stats;
 	return 0;
 }
 
@@ -531,7 +1371,387 @@ int DFT::DFTCalc::calculateDFT(const bool reuse,
 							   std::string root,
                                DFT::DFTCalculationResult &ret,
                                bool expOnly,
-                               bool exactMode)
+                               bool exactMode,
+                               const std::atomic<bool> *cancel,
+                               Translator *source)
+{
+	std::string dftFileName = dftOriginal.newWithPathTo(cwd).getFileBase();
+	if (!root.empty())
+		dftFileName += "@" + root;
+	Trace::Span span(trace, "calculate " + dftFileName, "calculation");
+	span.addArg("root", root);
+	span.addArg("checker", checkerName(useChecker));
+	CommandExecutor exec(messageFormatter, cwd, dftFileName);
+	exec.setCancel(cancel);
+	exec.setTrace(trace);
+	int res = runCalculation(exec, reuse, cwd, dftOriginal, queries,
+	                         useChecker, useConverter, warnNonDeterminism,
+	                         root, ret, expOnly, exactMode, source);
+	if (res && exec.limitExceeded())
+		return LIMIT_EXCEEDED;
+	return res;
+}
+
+#ifdef HAVE_CADP
+int DFT::DFTCalc::buildIMC(CommandExecutor &exec, const File &svl,
+                           const File &bcg, const File &aut)
+{
+	// svl, exp -> bcg
+	messageFormatter->reportAction("Building IMC...",VERBOSITY_FLOW);
+	std::vector<std::string> arguments;
+	arguments.push_back(svl.getFileRealPath());
+	if (exec.runCommand(svlExec.getFilePath(), arguments, "svl", bcg))
+		return 1;
+
+	messageFormatter->reportAction("Applying maximal progress to IMC...",VERBOSITY_FLOW);
+	arguments = std::vector<std::string>();
+	arguments.push_back(bcg.getFileRealPath());
+	arguments.push_back(aut.getFileRealPath());
+	arguments.push_back("FAIL");
+	arguments.push_back("ONLINE");
+
+	if (exec.runCommand(maxprogExec.getFilePath(), arguments, "maxprog", aut))
+		return 1;
+
+	arguments = std::vector<std::string>();
+	arguments.push_back(aut.getFileRealPath());
+	arguments.push_back(bcg.getFileRealPath());
+
+	if (exec.runCommand(bcgioExec.getFilePath(), arguments, "bcg_io", bcg))
+		return 1;
+
+	arguments = std::vector<std::string>();
+	arguments.push_back("-branching");
+	arguments.push_back("-rate");
+	arguments.push_back("-self");
+	arguments.push_back("-epsilon");
+	arguments.push_back("5e-324");
+	arguments.push_back(bcg.getFileRealPath());
+
+	return exec.runCommand(bcgminExec.getFilePath(), arguments, "bcg_min", bcg);
+}
+#endif /* HAVE_CADP */
+
+int DFT::DFTCalc::extractPhaseType(const bool reuse,
+                                   const std::string& cwd,
+                                   const File& dftOriginal,
+                                   enum DFT::converter useConverter,
+                                   const std::string &root,
+                                   Translator *source,
+                                   File &aut,
+                                   bool expOnly,
+                                   const std::atomic<bool> *cancel,
+                                   PhaseType *distribution)
+{
+	std::string dftFileName = dftOriginal.newWithPathTo(cwd).getFileBase();
+	dftFileName += "@" + root;
+	File dft(cwd, dftFileName, "dft");
+	File svl = dft.newWithExtension("svl");
+	File exp = dft.newWithExtension("exp");
+	File bcg = dft.newWithExtension("bcg");
+	File imc = dft.newWithExtension("aut");
+	File tra = dft.newWithExtension("ph.tra");
+	File lab = dft.newWithExtension("ph.lab");
+	aut = dft.newWithExtension("ph.aut");
+
+	Trace::Span span(trace, "phase type " + dftFileName, "calculation");
+	span.addArg("root", root);
+	CommandExecutor exec(messageFormatter, cwd, dftFileName);
+	exec.setCancel(cancel);
+	exec.setTrace(trace);
+
+	messageFormatter->reportAction("Translating module " + root + " to EXP...",VERBOSITY_FLOW);
+	if (translateDFT(dftOriginal, root, source, exp, svl, bcg))
+		return 1;
+	if (expOnly)
+		return 0;
+
+	/* As in runCalculation(), the CTMC is only rebuilt if the module
+	 * (or a phase-type distribution substituted into it) changed.
+	 */
+	std::string *expContents = FileSystem::load(exp);
+	if (!expContents) {
+		messageFormatter->reportError("Could not read " + exp.getFileRealPath());
+		return 1;
+	}
+	const std::string expKey = ResultCache::getModelKey(*expContents, std::vector<std::string>());
+	delete expContents;
+	std::vector<File> outputs;
+	outputs.push_back(tra);
+	outputs.push_back(lab);
+	StageManifest stage(outputs);
+	auto record = [&](const StageManifest &stage) {
+		if (stage.record())
+			messageFormatter->reportWarning("Could not write manifest of intermediate files, they will be rebuilt next time");
+	};
+	std::vector<std::string> arguments;
+	int res = 0;
+	exec.setLimit(limits[COMPOSE]);
+	if (useConverter == DFT::converter::SVL) {
+#ifndef HAVE_CADP
+		messageFormatter->reportError("CADP support has not been compiled in, but is required by your requested analysis.");
+		return 1;
+#else
+		StageManifest imcStage(bcg);
+		imcStage.addTool(svlExec);
+		imcStage.addTool(maxprogExec);
+		imcStage.addTool(bcgioExec);
+		imcStage.addTool(bcgminExec);
+		imcStage.addSetting(expKey);
+		imcStage.addInput(svl);
+		if (reuse && imcStage.upToDate()) {
+			messageFormatter->reportAction("Reusing IMC",VERBOSITY_FLOW);
+		} else {
+			res = buildIMC(exec, svl, bcg, imc);
+			if (!res)
+				record(imcStage);
+		}
+		// bcg -> tra, lab (fails on non-determinism)
+		arguments.push_back(bcg.getFileRealPath());
+		arguments.push_back(dft.newWithExtension("ph").getFileRealPath());
+		arguments.push_back("FAIL");
+		stage.addTool(bcg2tralabExec);
+		stage.addInput(bcg);
+		for (const std::string &arg : arguments)
+			stage.addSetting(arg);
+		if (!res && reuse && stage.upToDate()) {
+			messageFormatter->reportAction("Reusing IMC to .tra/.lab translation result",VERBOSITY_FLOW);
+		} else if (!res) {
+			messageFormatter->reportAction("Translating IMC to .tra/.lab ...",VERBOSITY_FLOW);
+			res = exec.runCommand(bcg2tralabExec.getFilePath(), arguments,
+			                      "bcg2tralab", outputs);
+			if (!res)
+				record(stage);
+		}
+#endif /* HAVE_CADP */
+	} else {
+		arguments.push_back("-jar");
+		arguments.push_back(dftresJar.getFileRealPath());
+		arguments.push_back("--export-tralab");
+		arguments.push_back(dft.newWithExtension("ph").getFileRealPath());
+		arguments.push_back(exp.getFileRealPath());
+		stage.addTool(javaExec);
+		stage.addTool(dftresJar);
+		stage.addSetting(expKey);
+		for (const std::string &arg : arguments)
+			stage.addSetting(arg);
+		if (reuse && stage.upToDate()) {
+			messageFormatter->reportAction("Reusing CTMC",VERBOSITY_FLOW);
+		} else {
+			messageFormatter->reportAction("Building CTMC...",VERBOSITY_FLOW);
+			res = exec.runCommand(javaExec.getFilePath(), arguments, "dftres", outputs);
+			if (!res)
+				record(stage);
+		}
+	}
+	if (res)
+		return exec.limitExceeded() ? LIMIT_EXCEEDED : 1;
+
+	messageFormatter->reportAction("Extracting phase-type distribution...",VERBOSITY_FLOW);
+	PhaseType ph;
+	if (ph.read(tra, lab, messageFormatter))
+		return 1;
+	size_t states = ph.getStates();
+	ph.minimize();
+	messageFormatter->reportAction("Phase-type distribution of module " + root + " has " + std::to_string(ph.getStates()) + " phases (" + std::to_string(states) + " before minimization)",VERBOSITY_FLOW);
+	span.addArg("states", states);
+	span.addArg("phases", ph.getStates());
+	if (distribution) {
+		*distribution = ph;
+		return 0;
+	}
+	return ph.writeAUT(aut, messageFormatter);
+}
+
+int DFT::DFTCalc::loadDFT(Translator &translator, CompilerContext &cc,
+                          const File &dftOriginal, const std::string &root)
+{
+	cc.setVerbosity(messageFormatter->getVerbosity());
+	cc.useColoredMessages(messageFormatter->usingColoredMessages());
+	if (!translator.parse(dftOriginal.getFileRealPath())
+	    || translator.validateAST()
+	    || !translator.buildDFT()
+	    || translator.validateDFT())
+	{
+		return 1;
+	}
+	if (!root.empty() && translator.setRoot(root))
+		return 1;
+	return cc.getErrors() > 0;
+}
+
+int DFT::DFTCalc::translateDFT(const File &dftOriginal,
+                               const std::string &root,
+                               Translator *source,
+                               const File &exp, const File &svl,
+                               const File &bcg, std::string *structure)
+{
+	CompilerContext cc(std::cerr);
+	Translator translator(&cc, trace);
+	std::stringstream expContents, svlContents;
+	int res;
+	if (source && !root.empty()) {
+		cc.setVerbosity(messageFormatter->getVerbosity());
+		cc.useColoredMessages(messageFormatter->usingColoredMessages());
+		res = translator.loadModule(*source, root);
+	} else {
+		res = loadDFT(translator, cc, dftOriginal, root);
+	}
+	/* The evidence was checked against the whole DFT when it was
+	 * modularized, a module only has some of the basic events.
+	 */
+	if (!res && !evidence.empty())
+		res = translator.applyEvidence(evidence, !root.empty());
+	if (!res && structure) {
+		DFTreeModules modules(*translator.getDFT());
+		DFTreeHasher hasher(modules);
+		*structure = hasher.getHash(translator.getDFT()->getTopNode());
+	}
+	/* The structure is that of the original subtree, the analysed
+	 * modules below it are substituted afterwards.
+	 */
+	if (!res && !root.empty()) {
+		std::unordered_map<std::string, std::string> substitutes;
+		{
+			std::lock_guard<std::mutex> guard(cachedResultsLock);
+			auto found = phaseTypes.find(dftOriginal.getFileRealPath());
+			if (found != phaseTypes.end())
+				substitutes = found->second;
+		}
+		if (!substitutes.empty())
+			res = translator.substitutePhaseTypes(substitutes);
+	}
+	if (!res) {
+		translator.transform();
+		std::string cacheDir = Translator::getCacheDir(&cc);
+		res = cacheDir.empty()
+		      || translator.generateAutomata(dft2lntRoot, cacheDir)
+		      || translator.buildEXP(dft2lntRoot, bcg.getFileRealPath(),
+		                             exp.getFileRealPath(), expContents,
+		                             svlContents);
+	}
+	cc.flush();
+	if (res || cc.getErrors() > 0) {
+		messageFormatter->reportError("Could not translate `" + dftOriginal.getFileName() + "'");
+		return 1;
+	}
+
+	std::ofstream expOut(exp.getFilePath());
+	expOut << expContents.str();
+	std::ofstream svlOut(svl.getFilePath());
+	svlOut << svlContents.str();
+	if (!expOut.good() || !svlOut.good()) {
+		messageFormatter->reportError("Could not write " + exp.getFilePath() + " or " + svl.getFilePath());
+		return 1;
+	}
+	return 0;
+}
+
+int DFT::DFTCalc::applyFallback(const std::string &name, bool &modular,
+                                enum DFT::checker &useChecker,
+                                enum DFT::converter &useConverter)
+{
+	if (name == "modular")
+		modular = true;
+	else if (name == "dftres")
+		useConverter = DFTRES;
+	else if (name == "storm")
+		useChecker = STORM;
+	else if (name == "modest")
+		useChecker = MODEST;
+	else if (name == "mrmc")
+		useChecker = MRMC;
+	else if (name == "imrmc")
+		useChecker = IMRMC;
+	else if (name == "imca")
+		useChecker = IMCA;
+	else
+		return 1;
+	return 0;
+}
+
+int DFT::DFTCalc::calculate(const bool reuse,
+                            const std::string& cwd,
+                            const File& dftOriginal,
+                            const std::vector<Query> &queries,
+                            enum DFT::checker useChecker,
+                            enum DFT::converter useConverter,
+                            bool warnNonDeterminism,
+                            DFT::DFTCalculationResult &ret,
+                            bool expOnly,
+                            bool exactMode,
+                            bool modular)
+{
+	Trace::Span span(trace, "analyse " + dftOriginal.getFileName(), "calculation");
+	span.addArg("checker", checkerName(useChecker));
+	span.addArg("modular", modular ? "yes" : "no");
+	span.addArg("dft bytes", FileSystem::getFileSize(dftOriginal));
+
+	DFT::DFTCalculationResult attempt;
+	int res;
+	if (modular) {
+		res = calcModular(reuse, cwd, dftOriginal, queries, useChecker,
+		                  useConverter, warnNonDeterminism, attempt,
+		                  expOnly, exactMode);
+	} else {
+		res = calculateDFT(reuse, cwd, dftOriginal, queries, useChecker,
+		                   useConverter, warnNonDeterminism, "",
+		                   attempt, expOnly, exactMode);
+	}
+
+	/* Each fallback is a single change to the original settings */
+	for (const std::string &name : fallbacks) {
+		if (res != LIMIT_EXCEEDED)
+			break;
+		bool fbModular = modular;
+		enum DFT::checker fbChecker = useChecker;
+		enum DFT::converter fbConverter = useConverter;
+		applyFallback(name, fbModular, fbChecker, fbConverter);
+		if (fbModular == modular && fbChecker == useChecker
+		    && fbConverter == useConverter)
+		{
+			continue;
+		}
+		if ((fbConverter == DFTRES && (fbChecker == MRMC || fbChecker == IMCA))
+		    || (exactMode && fbChecker != IMRMC && fbChecker != MODEST && fbChecker != STORM))
+		{
+			messageFormatter->reportAction("Skipping fallback `" + name + "', which cannot be used for this analysis", VERBOSITY_FLOW);
+			continue;
+		}
+		messageFormatter->reportWarning("Resource limit exceeded, falling back to `" + name + "'");
+		Trace::Span fallback(trace, "fallback " + name, "calculation");
+		attempt = DFT::DFTCalculationResult();
+		if (fbModular) {
+			res = calcModular(reuse, cwd, dftOriginal, queries,
+			                  fbChecker, fbConverter,
+			                  warnNonDeterminism, attempt, expOnly,
+			                  exactMode);
+		} else {
+			res = calculateDFT(reuse, cwd, dftOriginal, queries,
+			                   fbChecker, fbConverter,
+			                   warnNonDeterminism, "", attempt,
+			                   expOnly, exactMode);
+		}
+	}
+	ret.failProbs.insert(ret.failProbs.end(), attempt.failProbs.begin(),
+	                     attempt.failProbs.end());
+	ret.stats = attempt.stats;
+	return res;
+}
+
+int DFT::DFTCalc::runCalculation(CommandExecutor &exec,
+                                 const bool reuse,
+                                 const std::string& cwd,
+                                 const File& dftOriginal,
+                                 const std::vector<Query> &queries,
+                                 enum DFT::checker useChecker,
+                                 enum DFT::converter useConverter,
+                                 bool warnNonDeterminism,
+                                 std::string root,
+                                 DFT::DFTCalculationResult &ret,
+                                 bool expOnly,
+                                 bool exactMode,
+                                 Translator *source)
 {
 	File dft    = dftOriginal.newWithPathTo(cwd);
 	std::string dftFileName = dft.getFileBase();
@@ -580,135 +1800,138 @@ int DFT::DFTCalc::calculateDFT(const bool reuse,
 		messageFormatter->reportAction("Preserving generated files",VERBOSITY_FLOW);
 	}
 
-	CommandExecutor exec(messageFormatter, cwd, dftFileName);
-	this->exec = &exec;
-
-	if(!reuse || !FileSystem::exists(dft)) {
-		messageFormatter->reportAction("Canonicalizing DFT...",VERBOSITY_FLOW);
-		std::vector<std::string> arguments;
-		arguments.push_back("--verbose=" + std::to_string(messageFormatter->getVerbosity()));
-		arguments.push_back("-t");
-		arguments.push_back(dft.getFileRealPath());
-		if (!root.empty()) {
-			arguments.push_back("-r");
-			arguments.push_back(root);
-		}
-		arguments.push_back(dftOriginal.getFileRealPath());
-		if (exec.runCommand(dft2lntcExec.getFilePath(), arguments, "dft2lntc", dft) == "")
-			return 1;
-	} else {
-		messageFormatter->reportAction("Reusing copy of original dft file",VERBOSITY_FLOW);
-	}
-
 	if (root == "")
 		messageFormatter->notify("Calculating `"+dftFileName+"'");
 
-	if(!reuse || !FileSystem::exists(exp) || !FileSystem::exists(svl)) {
-		// dft -> exp, svl
-		messageFormatter->reportAction("Translating DFT to EXP...",VERBOSITY_FLOW);
-		std::vector<std::string> arguments;
-		arguments.push_back("--verbose=" + std::to_string(messageFormatter->getVerbosity()));
-		arguments.push_back("-s");
-		arguments.push_back(svl.getFileRealPath());
-		arguments.push_back("-x");
-		arguments.push_back(exp.getFileRealPath());
-		arguments.push_back("-b");
-		arguments.push_back(bcg.getFileRealPath());
-		arguments.push_back("-n");
-		arguments.push_back(dftOriginal.getFileRealPath());
-		if(!evidence.empty()) {
-			arguments.push_back("-e");
-			std::stringstream ss;
-			for(std::string e: evidence) {
-				ss << e << ",";
-			}
-			arguments.push_back(ss.str());
-		}
-		if (!messageFormatter->usingColoredMessages())
-			arguments.push_back(" --no-color");
-		arguments.push_back(dft.getFileRealPath());
-        std::vector<File> outputs;
-		outputs.push_back(exp);
-		outputs.push_back(svl);
-		if (exec.runCommand(dft2lntcExec.getFilePath(), arguments, "dft2lntc", outputs) == "")
-			return 1;
-	} else {
-		messageFormatter->reportAction("Reusing DFT to EXP translation result",VERBOSITY_FLOW);
-	}
+	/* Translating takes little time, and decides whether the later
+	 * stages can be reused.
+	 */
+	std::string structure;
+	// dft -> exp, svl
+	messageFormatter->reportAction("Translating DFT to EXP...",VERBOSITY_FLOW);
+	if (translateDFT(dftOriginal, root, source, exp, svl, bcg, &structure))
+		return 1;
 
 	if (expOnly)
 		return 0;
 
+	/* Structurally identical (sub)trees, e.g. replicated subsystems or
+	 * the same subsystem in other DFTs, have the same results.
+	 */
+	std::string structureKey;
+	if (!structure.empty()) {
+		structureKey = getStructureKey(structure, queries, useChecker,
+		                               useConverter, exactMode);
+		std::lock_guard<std::mutex> guard(cachedResultsLock);
+		auto cached = structuralResults.find(structureKey);
+		if (cached != structuralResults.end()) {
+			messageFormatter->reportAction("Reusing results of a structurally identical DFT",VERBOSITY_FLOW);
+			ret = cached->second;
+			return 0;
+		}
+	}
+
 	std::string* tmpContents = FileSystem::load(exp);
-	if (cachedResults.find(*tmpContents) != cachedResults.end()) {
-		ret = cachedResults[*tmpContents];
-		delete tmpContents;
-		return 0;
+	if (!tmpContents) {
+		messageFormatter->reportError("Could not read `" + exp.getFileRealPath() + "'");
+		return 1;
 	}
 	std::string expContents = *tmpContents;
 	delete tmpContents;
+	const std::string resultKey = getResultKey(expContents, queries, useChecker,
+	                                           useConverter, exactMode);
+	{
+		std::lock_guard<std::mutex> guard(cachedResultsLock);
+		auto cached = cachedResults.find(resultKey);
+		if (cached != cachedResults.end()) {
+			ret = cached->second;
+			return 0;
+		}
+	}
 
+	/* Look up the individual queries in the persistent cache. IMCA
+	 * handles time intervals itself instead of returning one result
+	 * per time point, so its results cannot be cached per query.
+	 */
+	std::string modelKey;
+	std::vector<Query> expanded = queries;
+	std::vector<Query> missing;
+	std::vector<DFT::DFTCalculationResultItem> results;
+	std::vector<bool> found;
+	if (resultCache && useChecker != IMCA) {
+		modelKey = ResultCache::getModelKey(expContents,
+				getCacheSettings(useChecker, useConverter, exactMode));
+		expandRangeQueries(expanded);
+		found = resultCache->lookup(modelKey, expanded, results);
+		for (size_t i = 0; i < expanded.size(); i++) {
+			if (!found[i])
+				missing.push_back(expanded[i]);
+		}
+		if (missing.empty()) {
+			messageFormatter->reportAction("Reusing cached results",VERBOSITY_FLOW);
+			ret.failProbs.insert(ret.failProbs.end(), results.begin(), results.end());
+			storeResult(resultKey, structureKey, ret);
+			return 0;
+		}
+		messageFormatter->reportAction("Reusing " + std::to_string(expanded.size() - missing.size()) + " of " + std::to_string(expanded.size()) + " cached results",VERBOSITY_FLOW);
+	} else {
+		missing = queries;
+	}
+
+	/* The stages from the EXP file onwards are only rerun if their
+	 * inputs changed (see StageManifest).
+	 */
+	const std::string expKey = ResultCache::getModelKey(expContents, std::vector<std::string>());
+	auto reusable = [&](const StageManifest &stage, const std::string &msg) {
+		if (!reuse || !stage.upToDate())
+			return false;
+		messageFormatter->reportAction(msg,VERBOSITY_FLOW);
+		return true;
+	};
+	auto record = [&](const StageManifest &stage) {
+		if (stage.record())
+			messageFormatter->reportWarning("Could not write manifest of intermediate files, they will be rebuilt next time");
+	};
+
+	exec.setLimit(limits[COMPOSE]);
 	if (useConverter == DFT::converter::SVL) {
 #ifndef HAVE_CADP
 		messageFormatter->reportError("CADP support has not been compiled in, but is required by your requested analysis.");
 		return 1;
 #else
-		if (!reuse || !FileSystem::exists(bcg)) {
-			// svl, exp -> bcg
-			messageFormatter->reportAction("Building IMC...",VERBOSITY_FLOW);
-			std::vector<std::string> arguments;
-			arguments.push_back(svl.getFileRealPath());
-			if (exec.runCommand(svlExec.getFilePath(), arguments, "svl", bcg) == "")
-				return 1;
-
-			messageFormatter->reportAction("Applying maximal progress to IMC...",VERBOSITY_FLOW);
-			arguments = std::vector<std::string>();
-			arguments.push_back(bcg.getFileRealPath());
-			arguments.push_back(aut.getFileRealPath());
-			arguments.push_back("FAIL");
-			arguments.push_back("ONLINE");
-
-			if (exec.runCommand(maxprogExec.getFilePath(), arguments, "maxprog", aut) == "")
+		StageManifest stage(bcg);
+		stage.addTool(svlExec);
+		stage.addTool(maxprogExec);
+		stage.addTool(bcgioExec);
+		stage.addTool(bcgminExec);
+		stage.addSetting(expKey);
+		stage.addInput(svl);
+		if (!reusable(stage, "Reusing IMC")) {
+			if (buildIMC(exec, svl, bcg, aut))
 				return 1;
-
-			arguments = std::vector<std::string>();
-			arguments.push_back(aut.getFileRealPath());
-			arguments.push_back(bcg.getFileRealPath());
-
-			if (exec.runCommand(bcgioExec.getFilePath(), arguments, "bcg_io", bcg) == "")
-				return 1;
-
-			arguments = std::vector<std::string>();
-			arguments.push_back("-branching");
-			arguments.push_back("-rate");
-			arguments.push_back("-self");
-			arguments.push_back("-epsilon");
-			arguments.push_back("5e-324");
-			arguments.push_back(bcg.getFileRealPath());
-
-			if (exec.runCommand(bcgminExec.getFilePath(), arguments, "bcg_min", bcg) == "")
-				return 1;
-		} else {
-			messageFormatter->reportAction("Reusing IMC",VERBOSITY_FLOW);
+			record(stage);
 		}
 
-		// obtain memtime result from svl
-		if(Shell::readMemtimeStatisticsFromLog(svlLog,stats)) {
+		// obtain memtime result from svl, only its memory usage is
+		// used since the time of svl is measured by the executor
+		Shell::RunStatistics svlStats;
+		if(Shell::readMemtimeStatisticsFromLog(svlLog,svlStats)) {
 			messageFormatter->reportWarning("Could not read from svl log file `" + svlLog.getFileRealPath() + "'");
 		}
+		stats.maxMem(svlStats);
 
 		// test for non-determinism
 		messageFormatter->reportAction("Testing for non-determinism...",VERBOSITY_FLOW);
 		std::vector<std::string> arguments;
 		arguments.push_back("-hidden");
 		arguments.push_back(bcg.getFileRealPath());
-		std::string hids = exec.runCommand(
-				bcginfoExec.getFilePath(),
-				arguments,
-				"bcg_info");
-		if (hids == "")
+		DFT::CommandOutput hids;
+		if (exec.runCommand(bcginfoExec.getFilePath(), arguments,
+		                    "bcg_info", hids))
+		{
 			return 1;
-		if (hasHiddenLabels(File(hids))) {
+		}
+		if (hasHiddenLabels(hids.getOutput())) {
 			if (warnNonDeterminism) {
 				messageFormatter->reportWarning("Non-determinism detected... you will want to ask for both 'min' and 'max' analysis results!");
 			} else {
@@ -724,25 +1947,21 @@ int DFT::DFTCalc::calculateDFT(const bool reuse,
 		arguments.push_back("-labels");
 		arguments.push_back(bcg.getFileRealPath());
 
-		std::string labs = exec.runCommand(
-				bcginfoExec.getFilePath(),
-				arguments,
-				"bcg_info");
-		if (labs == "")
+		DFT::CommandOutput labs;
+		if (exec.runCommand(bcginfoExec.getFilePath(), arguments,
+		                    "bcg_info", labs))
+		{
 			return 1;
+		}
 
-		if (hasImpossibleLabel(File(labs))) {
+		if (hasImpossibleLabel(labs.getOutput())) {
 			messageFormatter->reportError("Error composing model: 'IMPOSSIBLE' transitions reachable!");
 			return 1;
 		} else {
 			messageFormatter->notify("No impossible labels detected.");
 		}
 #endif /* HAVE_CADP */
-	} else if (!reuse
-	           || (useChecker == IMRMC && !FileSystem::exists(exactTra))
-	           || (useChecker == STORM && !FileSystem::exists(jani))
-	           || (useChecker == MODEST && !FileSystem::exists(jani)))
-	{
+	} else {
 		/* DFTRES Converter to tra/lab */
 		std::vector<File> outputs;
 		std::vector<std::string> arguments;
@@ -763,8 +1982,17 @@ int DFT::DFTCalc::calculateDFT(const bool reuse,
 		}
 		arguments.push_back(exp.getFileRealPath());
 
-		if (exec.runCommand(javaExec.getFilePath(), arguments, "dftres", outputs) == "")
-			return 1;
+		StageManifest stage(outputs);
+		stage.addTool(javaExec);
+		stage.addTool(dftresJar);
+		for (const std::string &arg : arguments)
+			stage.addSetting(arg);
+		stage.addSetting(expKey);
+		if (!reusable(stage, "Reusing DFTRES translation result")) {
+			if (exec.runCommand(javaExec.getFilePath(), arguments, "dftres", outputs))
+				return 1;
+			record(stage);
+		}
 	}
 
 	std::unique_ptr<Checker> checker;
@@ -775,44 +2003,57 @@ int DFT::DFTCalc::calculateDFT(const bool reuse,
 		messageFormatter->reportError("CADP is not compiled in, but is required for MRMC analysis.");
 		return 1;
 #else
-		if(!reuse || !FileSystem::exists(ctmdpi)) {
+		{
 			// bcg -> ctmdpi, lab
-			messageFormatter->reportAction("Translating IMC to CTMDPI...",VERBOSITY_FLOW);
 			std::vector<std::string> arguments;
 			arguments.push_back("-a");
 			arguments.push_back("FAIL");
 			arguments.push_back("-o");
 			arguments.push_back(ctmdpi.getFileRealPath());
 			arguments.push_back(bcg.getFileRealPath());
-
-			if (exec.runCommand(imc2ctmdpExec.getFilePath(), arguments, "imc2ctmdpi", ctmdpi) == "")
-				return 1;
-		} else {
-			messageFormatter->reportAction("Reusing IMC to CTMDPI translation result",VERBOSITY_FLOW);
+			StageManifest stage(ctmdpi);
+			stage.addTool(imc2ctmdpExec);
+			for (const std::string &arg : arguments)
+				stage.addSetting(arg);
+			stage.addInput(bcg);
+			if (!reusable(stage, "Reusing IMC to CTMDPI translation result")) {
+				messageFormatter->reportAction("Translating IMC to CTMDPI...",VERBOSITY_FLOW);
+				if (exec.runCommand(imc2ctmdpExec.getFilePath(), arguments, "imc2ctmdpi", ctmdpi))
+					return 1;
+				record(stage);
+			}
 		}
 
 		checker = std::unique_ptr<Checker>(new MRMCRunner(messageFormatter, &exec, false, mrmcExec, ctmdpi, lab));
 		break;
 #endif /* HAVE_CADP */
 	case IMRMC:
-		if(useConverter != DFTRES && (!reuse || !FileSystem::exists(tra))) {
+		if(useConverter != DFTRES) {
 #ifndef HAVE_CADP
 			messageFormatter->reportError("Internal error: tried to use bcg2jani in non-CADP program.");
 			return 1;
 #else
 			// bcg -> tra, lab
-			messageFormatter->reportAction("Translating IMC to .tra/.lab ...",VERBOSITY_FLOW);
 			std::vector<std::string> arguments;
 			arguments.push_back(bcg.getFileRealPath());
 			arguments.push_back(tra.newWithExtension("").getFileRealPath());
 			arguments.push_back("FAIL");
 			arguments.push_back("ONLINE");
-
-			if (exec.runCommand(bcg2tralabExec.getFilePath(), arguments, "bcg2tralab", tra) == "")
-				return 1;
+			std::vector<File> outputs;
+			outputs.push_back(tra);
+			outputs.push_back(lab);
+			StageManifest stage(outputs);
+			stage.addTool(bcg2tralabExec);
+			for (const std::string &arg : arguments)
+				stage.addSetting(arg);
+			stage.addInput(bcg);
+			if (!reusable(stage, "Reusing IMC to .tra/.lab translation result")) {
+				messageFormatter->reportAction("Translating IMC to .tra/.lab ...",VERBOSITY_FLOW);
+				if (exec.runCommand(bcg2tralabExec.getFilePath(), arguments, "bcg2tralab", outputs))
+					return 1;
+				record(stage);
+			}
 #endif /* HAVE_CADP */
-		} else {
-			messageFormatter->reportAction("Reusing IMC to .tra/.lab translation result",VERBOSITY_FLOW);
 		}
 		{
 			File tmpTra, tmpLab;
@@ -831,42 +2072,52 @@ int DFT::DFTCalc::calculateDFT(const bool reuse,
 		messageFormatter->reportError("CADP is not compiled in, but is required for IMCA analysis.");
 		return 1;
 #else
-		if(!reuse || !FileSystem::exists(ma)) {
+		{
 			// bcg -> ma
-			messageFormatter->reportAction("Translating IMC to IMCA format...",VERBOSITY_FLOW);
 			std::vector<std::string> arguments;
 			arguments.push_back(bcg.getFileRealPath());
 			arguments.push_back(ma.getFileRealPath());
 			arguments.push_back("FAIL");
-
-			if (exec.runCommand(bcg2imcaExec.getFilePath(), arguments, "bcg2imca", ma) == "")
-				return 1;
-		} else {
-			messageFormatter->reportAction("Reusing IMC to IMCA format translation result",VERBOSITY_FLOW);
+			StageManifest stage(ma);
+			stage.addTool(bcg2imcaExec);
+			for (const std::string &arg : arguments)
+				stage.addSetting(arg);
+			stage.addInput(bcg);
+			if (!reusable(stage, "Reusing IMC to IMCA format translation result")) {
+				messageFormatter->reportAction("Translating IMC to IMCA format...",VERBOSITY_FLOW);
+				if (exec.runCommand(bcg2imcaExec.getFilePath(), arguments, "bcg2imca", ma))
+					return 1;
+				record(stage);
+			}
 		}
 		checker = std::unique_ptr<Checker>(new IMCARunner(messageFormatter, &exec, imcaExec, ma));
 
 		break;
 #endif /* HAVE_CADP */
 	case STORM: {
-		if(useConverter == SVL && (!reuse || !FileSystem::exists(jani))) {
+		if(useConverter == SVL) {
 #ifndef HAVE_CADP
 			messageFormatter->reportError("Internal error: tried to use bcg2jani in non-CADP program.");
 			return 1;
 #else
 			// bcg -> jani
-			messageFormatter->reportAction("Translating IMC to JANI format...",VERBOSITY_FLOW);
 			std::vector<std::string> arguments;
 			arguments.push_back(bcg.getFileRealPath());
 			arguments.push_back(jani.getFileRealPath());
 			arguments.push_back("FAIL");
 			arguments.push_back("ONLINE");
-
-			if (exec.runCommand(bcg2janiExec.getFilePath(), arguments, "bcg2jani", jani) == "")
-				return 1;
+			StageManifest stage(jani);
+			stage.addTool(bcg2janiExec);
+			for (const std::string &arg : arguments)
+				stage.addSetting(arg);
+			stage.addInput(bcg);
+			if (!reusable(stage, "Reusing IMC to JANI format translation result")) {
+				messageFormatter->reportAction("Translating IMC to JANI format...",VERBOSITY_FLOW);
+				if (exec.runCommand(bcg2janiExec.getFilePath(), arguments, "bcg2jani", jani))
+					return 1;
+				record(stage);
+			}
 #endif /* HAVE_CADP */
-		} else if (useConverter == SVL) {
-			messageFormatter->reportAction("Reusing IMC to JANI format translation result",VERBOSITY_FLOW);
 		}
 		
 		StormRunner *sr = new StormRunner(messageFormatter, &exec, stormExec, jani, exactMode, useConverter == DFTRES);
@@ -874,29 +2125,33 @@ int DFT::DFTCalc::calculateDFT(const bool reuse,
 		break;
 	}
 	case MODEST:
-		if(useConverter == SVL && (!reuse || !FileSystem::exists(jani))) {
+		if(useConverter == SVL) {
 #ifndef HAVE_CADP
 			messageFormatter->reportError("Internal error: tried to use bcg2jani in non-CADP program.");
 			return 1;
 #else
 			// bcg -> jani
-			messageFormatter->reportAction("Translating IMC to JANI format...",VERBOSITY_FLOW);
 			std::vector<std::string> arguments;
 			arguments.push_back(bcg.getFileRealPath());
 			arguments.push_back(jani.getFileRealPath());
 			arguments.push_back("FAIL");
 			arguments.push_back("ONLINE");
-
-			if (exec.runCommand(bcg2janiExec.getFilePath(), arguments, "bcg2jani", jani) == "")
-
-				return 1;
+			StageManifest stage(jani);
+			stage.addTool(bcg2janiExec);
+			for (const std::string &arg : arguments)
+				stage.addSetting(arg);
+			stage.addInput(bcg);
+			if (!reusable(stage, "Reusing IMC to JANI format translation result")) {
+				messageFormatter->reportAction("Translating IMC to JANI format...",VERBOSITY_FLOW);
+				if (exec.runCommand(bcg2janiExec.getFilePath(), arguments, "bcg2jani", jani))
+					return 1;
+				record(stage);
+			}
 #endif /* HAVE_CADP */
-		} else if (useConverter == SVL) {
-			messageFormatter->reportAction("Reusing IMC to JANI format translation result",VERBOSITY_FLOW);
 		}
 		
 		{
-			ModestRunner *sr = new ModestRunner(messageFormatter, &exec, "mcsta", jani);
+			ModestRunner *sr = new ModestRunner(messageFormatter, &exec, modestExec.getFilePath(), jani);
 			checker = std::unique_ptr<Checker>(sr);
 		}
 		break;
@@ -904,9 +2159,40 @@ int DFT::DFTCalc::calculateDFT(const bool reuse,
 		messageFormatter->reportError("Unexpected checker type");
 	}
 
-	std::vector<DFT::DFTCalculationResultItem> results;
-	results = checker->analyze(queries);
+	std::vector<DFT::DFTCalculationResultItem> computed;
+	exec.setLimit(limits[CHECK]);
+	checker->setJobs(checkerJobs);
+	{
+		Trace::Span span(trace, "check", "checker");
+		span.addArg("checker", checkerName(useChecker));
+		std::string text;
+		for (Query &q : missing)
+			text += (text.empty() ? "" : "; ") + q.toString();
+		span.addArg("queries", missing.size());
+		span.addArg("query", text);
+		computed = checker->analyze(missing);
+	}
+	if (exec.limitExceeded())
+		return 1;
+	if (modelKey.empty()) {
+		results = computed;
+	} else {
+		if (computed.size() == missing.size())
+			resultCache->store(modelKey, computed);
+		/* Merge the computed results between the cached ones */
+		size_t next = 0;
+		for (size_t i = 0; i < results.size(); i++) {
+			if (found[i])
+				continue;
+			if (next == computed.size()) {
+				results.resize(i);
+				break;
+			}
+			results[i] = computed[next++];
+		}
+	}
 	ret.failProbs.insert(ret.failProbs.end(), results.begin(), results.end());
+	stats.addTimeMaxMem(exec.getStatistics());
 	ret.stats = stats;
 
 	if(!buildDot.empty()) {
@@ -920,7 +2206,7 @@ int DFT::DFTCalc::calculateDFT(const bool reuse,
 		arguments.push_back(bcg.getFileRealPath());
 		arguments.push_back(dot.getFileRealPath());
 		
-		if (exec.runCommand(bcgioExec.getFilePath(), arguments, "bcg_io", dot) == "")
+		if (exec.runCommand(bcgioExec.getFilePath(), arguments, "bcg_io", dot))
 			return 1;
 		
 		// dot -> png
@@ -931,15 +2217,132 @@ int DFT::DFTCalc::calculateDFT(const bool reuse,
 		arguments.push_back(dot.getFileRealPath());
 		arguments.push_back("-o");
 		arguments.push_back(png.getFileRealPath());
-		if (exec.runCommand(dotExec.getFilePath(), arguments, "dot", png) == "")
+		if (exec.runCommand(dotExec.getFilePath(), arguments, "dot", png))
 			return 1;
 #endif /* HAVE_CADP */
 	}
 
-	cachedResults[expContents] = ret;
+	storeResult(resultKey, structureKey, ret);
 	return 0;
 }
 
+std::vector<std::string> DFT::DFTCalc::getCacheSettings(enum DFT::checker useChecker,
+                                                        enum DFT::converter useConverter,
+                                                        bool exactMode)
+{
+	std::vector<std::string> ret;
+	ret.push_back("checker=" + std::to_string(useChecker));
+	ret.push_back("converter=" + std::to_string(useConverter));
+	ret.push_back(exactMode ? "exact" : "approximate");
+
+	/* Results may change when any of the tools converting or checking
+	 * the model is updated.
+	 */
+	std::vector<File> tools;
+	if (useConverter == DFTRES) {
+		tools.push_back(javaExec);
+		tools.push_back(dftresJar);
+	}
+#ifdef HAVE_CADP
+	if (useConverter == SVL) {
+		tools.push_back(svlExec);
+		tools.push_back(maxprogExec);
+		tools.push_back(bcgioExec);
+		tools.push_back(bcginfoExec);
+		tools.push_back(bcgminExec);
+		if (useChecker == MRMC)
+			tools.push_back(imc2ctmdpExec);
+		else if (useChecker == IMRMC)
+			tools.push_back(bcg2tralabExec);
+		else if (useChecker == IMCA)
+			tools.push_back(bcg2imcaExec);
+		else if (useChecker == STORM || useChecker == MODEST)
+			tools.push_back(bcg2janiExec);
+	}
+#endif
+	switch (useChecker) {
+	case STORM:
+		tools.push_back(stormExec);
+		break;
+	case MODEST:
+		tools.push_back(modestExec);
+		break;
+	case MRMC:
+		tools.push_back(mrmcExec);
+		break;
+	case IMRMC:
+		tools.push_back(imrmcExec);
+		break;
+	case IMCA:
+		tools.push_back(imcaExec);
+		break;
+	default:
+		break;
+	}
+	for (const File &tool : tools) {
+		if (!tool.getFilePath().empty() && FileSystem::exists(tool)) {
+			ret.push_back(tool.getFileRealPath() + "@"
+			              + std::to_string(FileSystem::getLastModificationTime(tool)));
+		}
+	}
+	return ret;
+}
+
+std::string DFT::DFTCalc::getStructureKey(const std::string &structure,
+                                          const std::vector<Query> &queries,
+                                          enum DFT::checker useChecker,
+                                          enum DFT::converter useConverter,
+                                          bool exactMode)
+{
+	std::string ret = structure;
+	for (const std::string &setting : getResultSettings(queries, useChecker, useConverter, exactMode))
+		ret += "\n" + setting;
+	return ret;
+}
+
+std::string DFT::DFTCalc::getResultKey(const std::string &expContents,
+                                       const std::vector<Query> &queries,
+                                       enum DFT::checker useChecker,
+                                       enum DFT::converter useConverter,
+                                       bool exactMode)
+{
+	return ResultCache::getModelKey(expContents,
+			getResultSettings(queries, useChecker, useConverter, exactMode));
+}
+
+std::vector<std::string> DFT::DFTCalc::getResultSettings(const std::vector<Query> &queries,
+                                                         enum DFT::checker useChecker,
+                                                         enum DFT::converter useConverter,
+                                                         bool exactMode)
+{
+	std::vector<std::string> ret = getCacheSettings(useChecker, useConverter, exactMode);
+	/* The query keys do not include the step of a time range, so the
+	 * ranges are keyed by the time points they expand to.
+	 */
+	std::vector<Query> expanded = queries;
+	expandRangeQueries(expanded);
+	for (const Query &q : expanded)
+		ret.push_back(ResultCache::getQueryKey(q));
+	return ret;
+}
+
+void DFT::DFTCalc::storeResult(const std::string &resultKey,
+                               const std::string &structureKey,
+                               const DFTCalculationResult &result)
+{
+	std::lock_guard<std::mutex> guard(cachedResultsLock);
+	/* In service mode the caches live as long as the process, so they
+	 * are simply emptied once they grow too large.
+	 */
+	if (cachedResults.size() >= MAX_CACHED_RESULTS)
+		cachedResults.clear();
+	if (structuralResults.size() >= MAX_CACHED_RESULTS)
+		structuralResults.clear();
+	cachedResults[resultKey] = result;
+	if (!structureKey.empty())
+		structuralResults[structureKey] = result;
+}
+
 int main(int argc, char** argv) {
 	/* Command line arguments and their default settings */
 	string timeSpec           = "1";
@@ -964,12 +2367,25 @@ int main(int argc, char** argv) {
 	int    mttf               = 0;
 	string errorBound         = "";
 	int    errorBoundSet      = 0;
+	string jobsSpec           = "1";
+	vector<string> timeLimitSpecs;
+	vector<string> memoryLimitSpecs;
+	string fallbackSpec       = "";
+	string checkerJobsSpec    = "1";
+	string batchFileName      = "";
+	int    batchFileSet       = 0;
+	bool   serve              = false;
+	string serveSocket        = "";
+	string cacheDir           = "";
+	bool   useCache           = true;
+	string traceFileName      = "";
 
 	int verbosity            = 0;
 	bool warnNonDeterminism  = true;
 	bool modularize          = false;
+	bool dynamicModules      = false;
 	int print                = 0;
-	int reuse                = 0;
+	int reuse                = 1;
 	int useColoredMessages   = 1;
 	int printHelp            = 0;
 	string printHelpTopic    = "";
@@ -1016,6 +2432,8 @@ int main(int argc, char** argv) {
 			expOnly = true;
 		} else if (!strcmp(argv[argi], "-R")) {
 			reuse = 1;
+		} else if (!strcmp(argv[argi], "--rebuild")) {
+			reuse = 0;
 		} else if (!strcmp(argv[argi], "-E")) {
 			// -E Error bound
 			errorBound = string(argv[++argi]);
@@ -1028,6 +2446,9 @@ int main(int argc, char** argv) {
 			mttf = 1;
 		} else if (!strcmp(argv[argi], "-M")) {
 			modularize = 1;
+		} else if (!strcmp(argv[argi], "-j")) {
+			// -j NUMBER of concurrent module calculations
+			jobsSpec = string(argv[++argi]);
 		} else if (!strcmp(argv[argi], "-s")) {
 			steadyState = 1;
 		} else if (!strcmp(argv[argi], "-t")) {
@@ -1103,6 +2524,39 @@ int main(int argc, char** argv) {
 			useColoredMessages = false;
 		} else if(!strcmp("--no-nd-warning", argv[argi])) {
 			warnNonDeterminism = false;
+		} else if(!strncmp("--serve", argv[argi], 7)) {
+			serve = true;
+			if(strlen(argv[argi]) > 8 && argv[argi][7]=='=') {
+				serveSocket = string(argv[argi] + 8);
+			}
+		} else if(!strcmp("--checker-jobs", argv[argi])) {
+			// --checker-jobs NUMBER of concurrent checker processes
+			checkerJobsSpec = string(argv[++argi]);
+		} else if(!strcmp("--time-limit", argv[argi])) {
+			// --time-limit [STAGE=]SECONDS
+			timeLimitSpecs.push_back(string(argv[++argi]));
+		} else if(!strcmp("--memory-limit", argv[argi])) {
+			// --memory-limit [STAGE=]MEGABYTES
+			memoryLimitSpecs.push_back(string(argv[++argi]));
+		} else if(!strcmp("--fallback", argv[argi])) {
+			// --fallback STRATEGY,STRATEGY,...
+			fallbackSpec = string(argv[++argi]);
+		} else if(!strcmp("--batch", argv[argi])) {
+			// --batch FILE
+			batchFileName = string(argv[++argi]);
+			batchFileSet = 1;
+		} else if(!strcmp("--cache", argv[argi])) {
+			// --cache DIR
+			cacheDir = string(argv[++argi]);
+			useCache = true;
+		} else if(!strcmp("--no-cache", argv[argi])) {
+			useCache = false;
+		} else if(!strcmp("--dynamic-modules", argv[argi])) {
+			modularize = true;
+			dynamicModules = true;
+		} else if(!strcmp("--trace", argv[argi])) {
+			// --trace FILE
+			traceFileName = string(argv[++argi]);
 		} else if(!strcmp("--min", argv[argi])) {
 			checkMin = true;
 			minMaxSet = true;
@@ -1171,10 +2625,45 @@ int main(int argc, char** argv) {
 	else if (useChecker != DFT::checker::MODEST)
 		q.min = false;
 
-	if (mttf && modularize) {
-		messageFormatter->reportWarningAt(Location("commandline"),"MTTF flag (-m) has been given: Disabling modularization.");
-		modularize = false;
+	char *jobsEnd;
+	long jobs = strtol(jobsSpec.c_str(), &jobsEnd, 10);
+	if (*jobsEnd || jobs < 1) {
+		messageFormatter->reportErrorAt(Location("commandline -j flag"),"Given number of jobs is not a positive integer: "+jobsSpec);
+		jobs = 1;
+	}
+
+	long checkerJobs = strtol(checkerJobsSpec.c_str(), &jobsEnd, 10);
+	if (*jobsEnd || checkerJobs < 1) {
+		messageFormatter->reportErrorAt(Location("commandline --checker-jobs flag"),"Given number of checker jobs is not a positive integer: "+checkerJobsSpec);
+		checkerJobs = 1;
 	}
+
+	vector<DFT::ResourceLimit> limits(DFT::NUM_STAGES);
+	for (const string &spec : timeLimitSpecs) {
+		if (parseLimit(spec, limits, false))
+			messageFormatter->reportErrorAt(Location("commandline --time-limit flag"),"Given time limit is not of the form [STAGE=]SECONDS: "+spec);
+	}
+	for (const string &spec : memoryLimitSpecs) {
+		if (parseLimit(spec, limits, true))
+			messageFormatter->reportErrorAt(Location("commandline --memory-limit flag"),"Given memory limit is not of the form [STAGE=]MEGABYTES: "+spec);
+	}
+
+	vector<string> fallbacks;
+	for (size_t start = 0; start < fallbackSpec.length(); ) {
+		size_t end = fallbackSpec.find(',', start);
+		if (end == string::npos)
+			end = fallbackSpec.length();
+		string name = fallbackSpec.substr(start, end - start);
+		bool m;
+		DFT::checker c;
+		DFT::converter conv;
+		if (DFT::DFTCalc::applyFallback(name, m, c, conv))
+			messageFormatter->reportErrorAt(Location("commandline --fallback flag"),"Unknown fallback strategy: "+name);
+		else
+			fallbacks.push_back(name);
+		start = end + 1;
+	}
+
 	if (mttf && useChecker == DFT::checker::MRMC) {
 		messageFormatter->reportWarningAt(Location("commandline"), "MTTF flag cannot be used with MRMC model checker, defaulting to Storm.");
 		useChecker = DFT::checker::STORM;
@@ -1318,6 +2807,30 @@ int main(int argc, char** argv) {
 			dfts.push_back(File(string(argv[argi])).fix());
 		}
 	}
+
+	/* Read the batch manifest: one DFT file per line, relative to the
+	 * directory of the manifest. Empty lines and lines starting with
+	 * '#' are ignored.
+	 */
+	if (batchFileSet) {
+		File batchFile = File(batchFileName).fix();
+		std::ifstream manifest(batchFile.getFileRealPath());
+		if (!manifest.is_open()) {
+			messageFormatter->reportErrorAt(Location(batchFileName),"could not open batch manifest");
+			return -1;
+		}
+		std::string line;
+		while (std::getline(manifest, line)) {
+			size_t b = line.find_first_not_of(" \t\r");
+			size_t e = line.find_last_not_of(" \t\r");
+			if (b == string::npos || line[b] == '#')
+				continue;
+			std::string path = line.substr(b, e - b + 1);
+			if (!File(path).isAbsolute())
+				path = batchFile.getPathTo() + "/" + path;
+			dfts.push_back(File(path).fix());
+		}
+	}
 	
 	/* Enable Shell messages */
 	Shell::messageFormatter = messageFormatter;
@@ -1325,15 +2838,55 @@ int main(int argc, char** argv) {
 	/* Create the DFTCalc class */
 	DFT::DFTCalc calc(messageFormatter);
 	if(dotToTypeSet) calc.setBuildDOT(dotToType);
+	calc.setJobs(jobs);
+	calc.setCheckerJobs(checkerJobs);
+	for (int s = 0; s < DFT::NUM_STAGES; s++)
+		calc.setLimit((DFT::stage)s, limits[s]);
+	calc.setFallbacks(fallbacks);
+	calc.setDynamicModules(dynamicModules);
 	
 	/* Check if all needed tools are available */
 	if(calc.checkNeededTools(useChecker, useConverter)) {
 		messageFormatter->reportError("There was an error with the environment");
 		return -1;
 	}
+	for (const string &name : fallbacks) {
+		bool m = modularize;
+		DFT::checker c = useChecker;
+		DFT::converter conv = useConverter;
+		DFT::DFTCalc::applyFallback(name, m, c, conv);
+		if (calc.checkNeededTools(c, conv)) {
+			messageFormatter->reportError("The tools for fallback `" + name + "' are not available");
+			return -1;
+		}
+	}
 
 	calc.setEvidence(failedBEs);
 
+	if (useCache && !expOnly) {
+		if (cacheDir.empty()) {
+			cacheDir = DFT::ResultCache::getDefaultRoot(messageFormatter);
+		} else {
+			cacheDir = File(cacheDir).fix().getFileRealPath();
+			if (!FileSystem::isDir(File(cacheDir)) && FileSystem::mkdir(File(cacheDir)))
+				messageFormatter->reportErrorAt(Location("commandline --cache flag"),"Could not create result cache directory: " + cacheDir);
+		}
+		calc.setResultCache(cacheDir);
+	}
+
+	/* Relative to the current directory, not the output folder */
+	std::unique_ptr<Trace> trace;
+	File traceFile;
+	if (!traceFileName.empty()) {
+		traceFile = File(traceFileName).fix();
+		trace.reset(new Trace("dftcalc"));
+		calc.setTrace(trace.get());
+	}
+	auto writeTrace = [&]() {
+		if (trace && trace->write(traceFile))
+			messageFormatter->reportErrorAt(Location("commandline --trace flag"),"Could not write trace file: " + traceFile.getFilePath());
+	};
+
 	/* Check if all went OK so far */
 	if(messageFormatter->getErrors()>0) {
 		return -1;
@@ -1343,35 +2896,98 @@ int main(int argc, char** argv) {
 	File outputFolderFile = File(outputFolder).fix();
 	FileSystem::mkdir(outputFolderFile);
 	PushD workdir(outputFolderFile);
+
+	/* Resident mode: handle requests until the input is closed */
+	if (serve) {
+		DFT::DFTService service(messageFormatter, calc, outputFolderFile.getFileRealPath() + "/serve", q, useChecker);
+		service.setToolsChecked(useChecker, useConverter);
+		int res;
+		if (serveSocket.empty())
+			res = service.serve(std::cin, std::cout);
+		else
+			res = service.serveSocket(serveSocket);
+		workdir.popd();
+		writeTrace();
+		delete messageFormatter;
+		return res;
+	}
 			
 	/// A map containing the results of the calculation. <filename> --> <result>
 	map<std::string,DFT::DFTCalculationResult> results;
-		
-	/* Calculate DFTs */
-	bool hasInput = false;
-	bool hasErrors = false;
-	for(File dft: dfts) {
-		hasInput = true;
-		if(FileSystem::exists(dft)) {
-			DFT::DFTCalculationResult ret;
+
+	/* In batch mode, every DFT gets its own workspace in the output
+	 * folder, so that files with the same name (and their reused
+	 * intermediate files) cannot collide. The workspaces are numbered,
+	 * so their names are unique whatever the names of the DFTs. The
+	 * results of files with the same name are reported under the
+	 * given path.
+	 * Otherwise, the DFTs are calculated one after the other in the
+	 * output folder itself.
+	 */
+	const bool batch = batchFileSet;
+	vector<std::string> workspaces;
+	vector<std::string> resultNames;
+	for (size_t i = 0; i < dfts.size(); i++) {
+		std::string workspace = outputFolderFile.getFileRealPath();
+		std::string name = dfts[i].getFileName();
+		if (batch) {
+			workspace += "/batch";
+			FileSystem::mkdir(File(workspace));
+			workspace += "/" + std::to_string(i) + "-" + dfts[i].getFileBase();
+			FileSystem::mkdir(File(workspace));
+			if (std::find(resultNames.begin(), resultNames.end(), name) != resultNames.end())
+				name = dfts[i].getFilePath();
+		}
+		workspaces.push_back(workspace);
+		resultNames.push_back(name);
+	}
+
+	/* Calculate DFTs, in batch mode up to jobs at the same time.
+	 * Modules of the DFTs are only calculated concurrently if the DFTs
+	 * themselves are not.
+	 */
+	bool hasInput = !dfts.empty();
+	std::atomic<bool> hasErrors(false);
+	std::atomic<size_t> nextDft(0);
+	vector<DFT::DFTCalculationResult> dftResults(dfts.size());
+	auto calcWorker = [&]() {
+		size_t i;
+		while ((i = nextDft++) < dfts.size()) {
+			File dft = dfts[i];
+			if(!FileSystem::exists(dft)) {
+				messageFormatter->reportError("DFT File `" + dft.getFileRealPath() + "' does not exist");
+				continue;
+			}
+			DFT::DFTCalculationResult &ret = dftResults[i];
 			bool res;
 			try {
-				if (!modularize) {
-					res = calc.calculateDFT(reuse, outputFolderFile.getFileRealPath(),dft, queries, useChecker, useConverter, warnNonDeterminism, "", ret, expOnly, exactMode);
-				} else {
-					res = calc.calcModular(reuse, outputFolderFile.getFileRealPath(),dft, queries, useChecker, useConverter, warnNonDeterminism, ret, expOnly, exactMode);
-				}
+				res = calc.calculate(reuse, workspaces[i], dft, queries, useChecker, useConverter, warnNonDeterminism, ret, expOnly, exactMode, modularize);
 			} catch (std::exception &e) {
 				messageFormatter->reportError(e.what());
 				res = true;
 			}
-			results[dft.getFileName()] = ret;
-			hasErrors = hasErrors || res;
-		} else {
-			messageFormatter->reportError("DFT File `" + dft.getFileRealPath() + "' does not exist");
+			if (res)
+				hasErrors = true;
 		}
+	};
+	size_t nThreads = batch ? std::min((size_t)jobs, dfts.size()) : 1;
+	if (nThreads > 1) {
+		calc.setJobs(1);
+		messageFormatter->reportAction("Calculating " + std::to_string(dfts.size()) + " DFTs using " + std::to_string(nThreads) + " jobs", DFT::VERBOSITY_FLOW);
+		vector<std::thread> threads;
+		for (size_t i = 0; i < nThreads; i++)
+			threads.emplace_back(calcWorker);
+		for (std::thread &t : threads)
+			t.join();
+	} else {
+		calcWorker();
+	}
+	for (size_t i = 0; i < dfts.size(); i++) {
+		if (FileSystem::exists(dfts[i]))
+			results[resultNames[i]] = dftResults[i];
 	}
 	workdir.popd();
+	writeTrace();
 	if (expOnly)
 		return 0;
 
@@ -1415,8 +3031,8 @@ int main(int argc, char** argv) {
 	}
     
 	if (useConverter != DFT::converter::DFTRES) {
-		for(File dft: dfts) {
-			File svlLogFile = File(outputFolderFile.getFileRealPath(),dft.getFileBase(),"log");
+		for(size_t i = 0; i < dfts.size(); i++) {
+			File svlLogFile = File(workspaces[i],dfts[i].getFileBase(),"log");
 			Shell::SvlStatistics svlStats;
 			if(Shell::readSvlStatisticsFromLog(svlLogFile,svlStats)) {
 				messageFormatter->reportWarning("Could not read from svl log file `" + svlLogFile.getFileRealPath() + "'");
@@ -1449,19 +3065,29 @@ int main(int argc, char** argv) {
 	/* Write csv file */
 	if(csvFileSet) {
 		std::stringstream out;
+		// Only name the DFT of each row in batch mode
+		bool csvNames = batch;
 		if (mttf) {
+			if (csvNames)
+				out << "DFT" << ", ";
 			out << "Mean Time to Failure" << std::endl;
 			for(auto it: results) {
 				std::string fName = it.first;
 				for(auto it2: it.second.failProbs) {
+					if (csvNames)
+						out << fName << ", ";
 					out << it2.valStr() << std::endl;
 				}
 			}
 		} else {
+			if (csvNames)
+				out << "DFT" << ", ";
 			out << "Time" << ", " << "Unreliability" << std::endl;
 			for(auto it: results) {
 				std::string fName = it.first;
 				for(auto it2: it.second.failProbs) {
+					if (csvNames)
+						out << fName << ", ";
 					out << it2.missionTime << ", " << it2.valStr() << std::endl;
 				}
 			}
@@ -1524,10 +3150,9 @@ bool DFT::DFTCalc::checkNeededTools(DFT::checker checker, converter conv) {
 		bcg2imcaExec = File(imcaRoot+"/bin/bcg2imca");
 	} else if (checker == STORM || checker == MODEST) {
 		bcg2janiExec = File(dft2lntRoot+"/bin/bcg2jani");
-	} else if (checker == IMRMC) {
-		bcg2tralabExec = File(dft2lntRoot+"/bin/bcg2tralab");
-		maxprogExec = File(dft2lntRoot+"/bin/maxprog");
 	}
+	/* Also used to extract phase-type distributions of modules */
+	bcg2tralabExec = File(dft2lntRoot+"/bin/bcg2tralab");
 	maxprogExec = File(dft2lntRoot+"/bin/maxprog");
 
 	cadpRoot = getCADPRoot();
@@ -1535,30 +3160,17 @@ bool DFT::DFTCalc::checkNeededTools(DFT::checker checker, converter conv) {
 		svlExec = File(cadpRoot+"/com/svl");
 #endif
 
-	/* These tools should be easy to find in the roots. Note that an added
-	 * bonus would be to locate them using PATH as well.
+	/* DFTs are translated in-process, but the node files are still
+	 * found in (and generated into) DFT2LNTROOT.
 	 */
-	dft2lntcExec = File(dft2lntRoot+"/bin/dft2lntc");
-	if (!FileSystem::exists(dft2lntcExec)) {
-		if (FileSystem::exists(File(dft2lntRoot + "/bin/dft2lntc.exe")))
-			dft2lntcExec = File(dft2lntRoot + "/bin/dft2lntc.exe");
-	}
-
-	/* Find dft2lntc executable (based on DFT2LNTROOT environment variable) */
 	if(dft2lntRoot.empty()) {
-		messageFormatter->reportError("Environment variable `DFT2LNTROOT' not set. Please set it to where /bin/dft2lntc can be found.");
+		messageFormatter->reportError("Environment variable `DFT2LNTROOT' not set. Please set it to where dft2lnt is installed.");
 		ok = false;
 	} else if(!FileSystem::isDir(File(dft2lntRoot))) {
 		messageFormatter->reportError("Could not enter dft2lntroot directory (environment variable `DFT2LNTROOT': " + dft2lntRoot + ")");
 		ok = false;
-	} else if(!FileSystem::exists(dft2lntcExec)) {
-		messageFormatter->reportError("dft2lntc not found (in " + dft2lntRoot + "/bin)");
-		ok = false;
-	} else if(!FileSystem::hasAccessTo(dft2lntcExec,X_OK)) {
-		messageFormatter->reportError("dft2lntc not executable (in " + dft2lntRoot+"/bin)");
-		ok = false;
 	} else {
-		messageFormatter->reportAction("Using dft2lntc [" + dft2lntcExec.getFilePath() + "]",VERBOSITY_SEARCHING);
+		messageFormatter->reportAction("Using DFT2LNTROOT [" + dft2lntRoot + "]",VERBOSITY_SEARCHING);
 	}
 
 	/* Find imc2ctmdpi executable (based on CORAL environment variable) */
@@ -1640,6 +3252,10 @@ bool DFT::DFTCalc::checkNeededTools(DFT::checker checker, converter conv) {
 	if (checker == STORM)
 		ok &= findInPath("storm" + executable_suffix, stormExec);
 
+	/* Find an mcsta executable (based on PATH environment variable) */
+	if (checker == MODEST)
+		ok &= findInPath("mcsta" + executable_suffix, modestExec);
+
 	/* Find an mrmc executable (based on PATH environment variable) */
 	if (checker == MRMC)
 		ok &= findInPath("mrmc" + executable_suffix, mrmcExec);
@@ -13,21 +13,79 @@
 #include <string>
 #include <unordered_map>
 #include <vector>
+#include <mutex>
+#include <atomic>
+#include <memory>
 #include "DFTCalculationResult.h"
 #include "executor.h"
+#include "Trace.h"
+#include "translator.h"
+#include "resultcache.h"
+#include "phasetype.h"
 
 namespace DFT {
 	extern const int VERBOSITY_FLOW;
 
 	enum checker {STORM, MRMC, IMRMC, IMCA, MODEST, EXP_ONLY};
 	enum converter {SVL, DFTRES};
+	/// Stages of a calculation that have their own resource limits
+	enum stage {COMPOSE, CHECK, NUM_STAGES};
+
+	/**
+	 * A node in the tree of modules, as described by the modules file
+	 * written by dft2lntc -m.
+	 */
+	class DFTModule {
+	public:
+		/// 'M' (module to analyse), 'D' (module to analyse after
+		/// substituting its children as phase-type basic events),
+		/// 'E' (exponential basic event), '=' (constant), '*', '+' or '/'
+		char type;
+		/// The root node of an 'M', 'D' or 'E' module, the probability
+		/// of a '=' module
+		std::string value;
+		/// The structural hash of an 'M' or 'D' module (see
+		/// DFTreeHasher), empty if not known
+		std::string structure;
+		/// The failure rate of an 'E' module
+		std::string rate;
+		/// The number of children that need to fail for a '/' module
+		unsigned long votCount;
+		std::vector<DFTModule> children;
+
+		/// The enclosing module, nullptr for the top module
+		DFTModule *parent;
+		/// The number of children that have not been calculated yet
+		size_t pending;
+		/// The fraction of the error bound of each query allotted to
+		/// this module
+		long double errorShare;
+		/// Modules identical to this one, which take over its result
+		std::vector<DFTModule *> copies;
+		DFT::DFTCalculationResult result;
+		/// For the children of a 'D' module, the automaton describing
+		/// its time to failure (see PhaseType)
+		std::string phaseType;
+		/// The time to failure of a module combined by the static
+		/// modules above it to calculate the MTTF, shared by its copies
+		std::shared_ptr<PhaseType> distribution;
+
+		DFTModule()
+			:type(0), votCount(0), parent(nullptr), pending(0),
+			 errorShare(1)
+		{}
+	};
 
 	class DFTCalc {
 	public:
 		static const int VERBOSITY_SEARCHING;
 
+		/// Returned by calculations failing due to a resource limit
+		static const int LIMIT_EXCEEDED = 2;
+
 		DFTCalc(MessageFormatter *mf)
-			:messageFormatter(mf), exec(nullptr)
+			:messageFormatter(mf), jobs(1), checkerJobs(1), trace(nullptr),
+			 dynamicModules(false)
 		{}
 
 		~DFTCalc()
@@ -40,10 +98,30 @@ namespace DFT {
 		std::string buildDot;
 		
 		MessageFormatter * const messageFormatter;
+
+		/// The maximum number of modules calculated concurrently
+		unsigned int jobs;
+
+		/// The maximum number of checker processes per calculation
+		unsigned int checkerJobs;
+
+		/// The limits of the tools run in each stage
+		ResourceLimit limits[NUM_STAGES];
+
+		/// Strategies tried when a resource limit is exceeded
+		std::vector<std::string> fallbacks;
+
+		/// Receives the spans of the calculations, if not null
+		Trace *trace;
+
+		/// Whether modularization splits dynamic modules as well
+		bool dynamicModules;
+		/// The automata of the modules substituted as phase-type basic
+		/// events, by DFT file and name of the root of the module
+		std::unordered_map<std::string, std::unordered_map<std::string, std::string>> phaseTypes;
 		std::string dft2lntRoot;
 		std::string coralRoot;
 		std::string imcaRoot;
-		File dft2lntcExec;
 #ifdef HAVE_CADP
 		std::string cadpRoot;
 		File imc2ctmdpExec;
@@ -56,8 +134,18 @@ namespace DFT {
 		File bcginfoExec;
 		File bcgminExec;
 		std::string getCADPRoot();
+
+		/**
+		 * Composes the IMC of a translated DFT using its SVL script,
+		 * and minimizes it after applying maximal progress.
+		 * @param aut Intermediate file for maximal progress.
+		 * @return 0 if successful, non-zero otherwise
+		 */
+		int buildIMC(CommandExecutor &exec, const File &svl,
+		             const File &bcg, const File &aut);
 #endif
 		File stormExec;
+		File modestExec;
 		File mrmcExec;
 		File imrmcExec;
 		File imcaExec;
@@ -71,9 +159,86 @@ namespace DFT {
 		File getDftresJar();
 
 		std::vector<std::string> evidence;
+		/// Maximum number of entries in each of the in-memory result caches
+		static const size_t MAX_CACHED_RESULTS = 4096;
+		/// Results by EXP file and analysis settings, see getResultKey()
 		std::unordered_map<std::string, DFTCalculationResult> cachedResults;
-		CommandExecutor *exec;
+		/// Results by structure of the (sub)tree, see getStructureKey()
+		std::unordered_map<std::string, DFTCalculationResult> structuralResults;
+		std::mutex cachedResultsLock;
+		std::unique_ptr<ResultCache> resultCache;
+
+		/**
+		 * Returns the settings (besides the EXP file) that determine
+		 * the results of an analysis, to be included in the key of the
+		 * result cache.
+		 */
+		std::vector<std::string> getCacheSettings(enum DFT::checker useChecker,
+		                                          enum DFT::converter useConverter,
+		                                          bool exactMode);
+
+		/**
+		 * Returns the key of the results of a (sub)tree with the
+		 * specified structural hash, for the specified queries and
+		 * settings. Structurally identical trees have the same key,
+		 * even in different DFTs.
+		 */
+		std::string getStructureKey(const std::string &structure,
+		                            const std::vector<Query> &queries,
+		                            enum DFT::checker useChecker,
+		                            enum DFT::converter useConverter,
+		                            bool exactMode);
 
+		/**
+		 * Returns the key of the results of the model described by
+		 * the specified EXP file (and the automata it references), for
+		 * the specified queries and settings.
+		 */
+		std::string getResultKey(const std::string &expContents,
+		                         const std::vector<Query> &queries,
+		                         enum DFT::checker useChecker,
+		                         enum DFT::converter useConverter,
+		                         bool exactMode);
+
+		/**
+		 * Returns the cache settings (see getCacheSettings()) followed
+		 * by the keys of the individual queries, including their error
+		 * bounds and the time points of time ranges.
+		 */
+		std::vector<std::string> getResultSettings(const std::vector<Query> &queries,
+		                                           enum DFT::checker useChecker,
+		                                           enum DFT::converter useConverter,
+		                                           bool exactMode);
+
+		/**
+		 * Stores the result of an analysis in the in-memory caches
+		 * under the specified keys (the structure key may be empty).
+		 */
+		void storeResult(const std::string &resultKey,
+		                 const std::string &structureKey,
+		                 const DFTCalculationResult &result);
+
+		/**
+		 * Parses the next module (including its submodules) from the
+		 * contents of a modules file.
+		 * @param modules The contents of the modules file.
+		 * @param pos The position to start parsing, will be moved past
+		 * 	the parsed module.
+		 * @param ret The module tree to fill in.
+		 * @return 0 if successful, non-zero otherwise
+		 */
+		int parseModule(const std::string &modules,
+		                size_t &pos,
+		                DFTModule &ret);
+
+		/**
+		 * Calculates all modules in the specified tree, running up to
+		 * jobs modules concurrently. Each module is combined as soon as
+		 * all of its children have been calculated.
+		 * @param source The already loaded DFT to take the modules
+		 * 	from.
+		 * @return 0 if successful, non-zero otherwise
+		 */
 		int checkModule(const bool reuse,
 		                const std::string& cwd,
 		                const File& dftOriginal,
@@ -84,7 +249,80 @@ namespace DFT {
 		                DFT::DFTCalculationResult &ret,
 		                bool expOnly,
 		                bool exactMode,
-		                std::string &module);
+		                Translator *source,
+		                DFTModule &module);
+
+		/**
+		 * Performs the calculation of calculateDFT(), running all
+		 * tools using the specified executor.
+		 */
+		int runCalculation(CommandExecutor &exec,
+		                   const bool reuse,
+		                   const std::string& cwd,
+		                   const File& dftOriginal,
+		                   const std::vector<Query> &queries,
+		                   enum DFT::checker useChecker,
+		                   enum DFT::converter useConverter,
+		                   bool warnNonDeterminism,
+		                   std::string root,
+		                   DFT::DFTCalculationResult &ret,
+		                   bool expOnly,
+		                   bool exactMode,
+		                   Translator *source);
+
+		/**
+		 * Parses and validates a DFT, restricted to the subtree of the
+		 * specified root (if not empty).
+		 * @param cc Receives the messages of the translator.
+		 * @return 0 if successful, non-zero otherwise
+		 */
+		int loadDFT(Translator &translator, CompilerContext &cc,
+		            const File &dftOriginal, const std::string &root);
+
+		/**
+		 * Translates a DFT into EXP and SVL files (and the automata
+		 * these refer to), as dft2lntc would, but without running it.
+		 * @param root The root of the subtree to translate, or empty
+		 * 	for the whole DFT.
+		 * @param source If not NULL, the already loaded DFT to take
+		 * 	the subtree from instead of parsing the file again.
+		 * @param bcg The BCG file the SVL script should produce.
+		 * @param structure Receives the structural hash of the
+		 * 	translated (sub)tree, if not NULL.
+		 * @return 0 if successful, non-zero otherwise
+		 */
+		int translateDFT(const File &dftOriginal, const std::string &root,
+		                 Translator *source,
+		                 const File &exp, const File &svl, const File &bcg,
+		                 std::string *structure = nullptr);
+
+		/**
+		 * Calculates the time to failure of a module that cannot be
+		 * repaired, as a minimized phase-type distribution, to be
+		 * substituted into its parent module as an APH basic event
+		 * (see Translator::substitutePhaseTypes()).
+		 * @param root The root of the module.
+		 * @param source If not NULL, the already loaded DFT to take
+		 * 	the module from.
+		 * @param aut Receives the automaton describing the
+		 * 	distribution, not written if expOnly is set.
+		 * @param cancel If not null, the calculation is aborted (with
+		 * 	a non-zero result) once this becomes true.
+		 * @param distribution If not null, receives the distribution
+		 * 	instead of it being written to aut.
+		 * @return 0 if successful, LIMIT_EXCEEDED if failed due to the
+		 * 	resource limits, other non-zero values otherwise
+		 */
+		int extractPhaseType(const bool reuse,
+		                     const std::string& cwd,
+		                     const File& dftOriginal,
+		                     enum DFT::converter useConverter,
+		                     const std::string &root,
+		                     Translator *source,
+		                     File &aut,
+		                     bool expOnly,
+		                     const std::atomic<bool> *cancel,
+		                     PhaseType *distribution = nullptr);
 
 		bool findInPath(std::string tool, File &ret);
 	public:
@@ -104,10 +342,86 @@ namespace DFT {
 		void setBuildDOT(const std::string& buildDot) {
 			this->buildDot = buildDot;
 		}
+
+		/**
+		 * Sets the maximum number of modules that are calculated
+		 * concurrently during modular analysis.
+		 * @param jobs The maximum number of concurrent modules (>= 1).
+		 */
+		void setJobs(unsigned int jobs) {
+			this->jobs = jobs ? jobs : 1;
+		}
+
+		/**
+		 * Sets the maximum number of checker processes run
+		 * concurrently for the queries of a single calculation, when
+		 * these cannot be checked in a single run.
+		 * @param jobs The maximum number of processes (>= 1).
+		 */
+		void setCheckerJobs(unsigned int jobs) {
+			this->checkerJobs = jobs ? jobs : 1;
+		}
+
+		/**
+		 * Sets the resource limits of each tool run in a stage of the
+		 * calculation. A calculation exceeding these fails with
+		 * LIMIT_EXCEEDED.
+		 */
+		void setLimit(enum stage s, const ResourceLimit &limit) {
+			limits[s] = limit;
+		}
+
+		/**
+		 * Sets the strategies tried, in order, by calculate() when a
+		 * resource limit is exceeded. See applyFallback().
+		 */
+		void setFallbacks(const std::vector<std::string> &fallbacks) {
+			this->fallbacks = fallbacks;
+		}
+
+		/**
+		 * Changes the analysis settings according to a fallback
+		 * strategy: "modular" (use modularization), "dftres" (convert
+		 * using DFTRES) or the name of a model checker.
+		 * @return 0 if successful, non-zero if the name is unknown.
+		 */
+		static int applyFallback(const std::string &name, bool &modular,
+		                         enum DFT::checker &useChecker,
+		                         enum DFT::converter &useConverter);
+
+		/**
+		 * Sets whether modularization also analyses independent
+		 * subtrees below dynamic gates on their own, substituting
+		 * their time to failure into their parents.
+		 */
+		void setDynamicModules(bool dynamic) {
+			dynamicModules = dynamic;
+		}
+
+		/**
+		 * Sets the trace receiving a span for every module, tool and
+		 * checker run, or NULL to not trace the calculations.
+		 */
+		void setTrace(Trace *trace) {
+			this->trace = trace;
+		}
+
+		/**
+		 * Enables the persistent result cache in the specified
+		 * directory, or disables it if the directory is empty.
+		 * @param dir The directory to store cached results in.
+		 */
+		void setResultCache(const std::string& dir) {
+			if (dir.empty())
+				resultCache.reset();
+			else
+				resultCache.reset(new ResultCache(messageFormatter, dir));
+		}
 		
 		/**
 		 * Calculates the specified DFT file with modularization.
-		 * @param reuse Whether to reuse intermediate files.
+		 * @param reuse Whether to reuse intermediate files whose inputs
+		 * 	did not change (see StageManifest).
 		 * @param cwd The directory to work in.
 		 * @param dftOriginal The DFT to analyze.
 		 * @param queries The queries to model check.
@@ -117,7 +431,8 @@ namespace DFT {
 		 * @param warnNonDeterminism Whether to issue a warning
 		 * 	if the BCG file contains nondeterminism.
 		 * @param ret Will have the calculated result added.
-		 * @return 0 if successful, non-zero otherwise
+		 * @return 0 if successful, LIMIT_EXCEEDED if failed due to the
+		 * 	resource limits, other non-zero values otherwise
 		 */
 		int calcModular(const bool reuse,
 		                const std::string& cwd,
@@ -131,7 +446,8 @@ namespace DFT {
 		                bool exactMode);
 		/**
 		 * Calculates the specified DFT file.
-		 * @param reuse Whether to reuse intermediate files.
+		 * @param reuse Whether to reuse intermediate files whose inputs
+		 * 	did not change (see StageManifest).
 		 * @param cwd The directory to work in.
 		 * @param dftOriginal The DFT to analyze.
 		 * @param queries The queries to model check.
@@ -143,7 +459,12 @@ namespace DFT {
 		 * @param root Which FT element to use as the root
 		 *      (toplevel if empty).
 		 * @param ret Will have the calculated result added.
-		 * @return 0 if successful, non-zero otherwise
+		 * @param cancel If not null, the calculation is aborted (with
+		 * 	a non-zero result) once this becomes true.
+		 * @param source If not null, the already loaded DFT to take
+		 * 	the subtree of root from instead of parsing the file.
+		 * @return 0 if successful, LIMIT_EXCEEDED if failed due to the
+		 * 	resource limits, other non-zero values otherwise
 		 */
 		int calculateDFT(const bool reuse,
 		                 const std::string& cwd,
@@ -155,7 +476,28 @@ namespace DFT {
 		                 std::string root,
 		                 DFT::DFTCalculationResult &ret,
 		                 bool expOnly,
-		                 bool exactMode);
+		                 bool exactMode,
+		                 const std::atomic<bool> *cancel = nullptr,
+		                 Translator *source = nullptr);
+
+		/**
+		 * Calculates the specified DFT with or without modularization,
+		 * retrying with the fallback strategies whenever a resource
+		 * limit is exceeded. The parameters are as for calculateDFT().
+		 * @param modular Whether to use modularization.
+		 * @return 0 if successful, non-zero otherwise
+		 */
+		int calculate(const bool reuse,
+		              const std::string& cwd,
+		              const File& dftOriginal,
+		              const std::vector<Query> &queries,
+		              enum DFT::checker useChecker,
+		              enum DFT::converter useConverter,
+		              bool warnNonDeterminism,
+		              DFT::DFTCalculationResult &ret,
+		              bool expOnly,
+		              bool exactMode,
+		              bool modular);
 
 		void setEvidence(const std::vector<std::string>& evidence) {this->evidence = evidence;}
 		const std::vector<std::string>& getEvidence() const {return evidence;}
@@ -1,63 +1,174 @@
 #include "executor.h"
-#include "Shell.h"
 #include <string>
+#include <sstream>
+#include <fstream>
+#ifndef WIN32
+# include <sys/wait.h>
+# include <signal.h>
+#endif
 
 using std::string;
 const int VERBOSITY_EXECUTIONS = 2;
+const size_t DFT::CommandExecutor::SPILL_LIMIT = 16 * 1024 * 1024;
 
-void DFT::CommandExecutor::printOutput(const File& file, int status) {
-	string* outContents = FileSystem::load(file);
+string DFT::CommandOutput::getOutput() const {
+	if (!out.spilled)
+		return out.contents;
+	string* contents = FileSystem::load(File(outFile));
+	if (!contents)
+		return "";
+	string ret = *contents;
+	delete contents;
+	return ret;
+}
+
+std::unique_ptr<std::istream> DFT::CommandOutput::openOutput() const {
+	if (out.spilled)
+		return std::unique_ptr<std::istream>(new std::ifstream(outFile));
+	return std::unique_ptr<std::istream>(new std::istringstream(out.contents));
+}
+
+/* Returns the signal that killed the command, or 0 */
+static int killedBy(int status) {
+#ifndef WIN32
+	if (status > 0 && WIFSIGNALED(status))
+		return WTERMSIG(status);
+#endif
+	return 0;
+}
+
+/* Returns whether the command exited normally with a non-zero status */
+static bool exitedWithError(int status) {
+#ifndef WIN32
+	return status > 0 && WIFEXITED(status) && WEXITSTATUS(status) != 0;
+#else
+	return status != 0;
+#endif
+}
+
+/* Returns whether the command was killed by the kernel's OOM killer */
+static bool killedForMemory(int status) {
+#ifndef WIN32
+	return killedBy(status) == SIGKILL;
+#else
+	return false;
+#endif
+}
+
+void DFT::CommandExecutor::printOutput(const std::string &name,
+                                       const Shell::Capture &output,
+                                       const std::string &file, int status)
+{
+	string* outContents = nullptr;
+	if (output.spilled)
+		outContents = FileSystem::load(File(file));
+	else if (!output.contents.empty())
+		outContents = new string(output.contents);
 	if(outContents) {
-		mf->notifyHighlighted("** OUTPUT of " + file.getFileName() + " **");
+		mf->notifyHighlighted("** OUTPUT of " + name + " **");
 		if (status)
 			mf->message(*outContents, MessageFormatter::MessageType::Error);
 		else
 			mf->message(*outContents);
-		mf->notifyHighlighted("** END output of " + file.getFileName() + " **");
+		mf->notifyHighlighted("** END output of " + name + " **");
 		delete outContents;
 	}
 }
 
 string DFT::CommandExecutor::genInputFile(std::string extension) {
+	std::lock_guard<std::mutex> guard(lock);
 	return workingDir + "/" + baseFile + "."
-	              + std::to_string(commandNum) + "." + extension;
+	              + std::to_string(commandNum++) + "." + extension;
 }
 
-string DFT::CommandExecutor::runCommand(std::string command,
-                                        std::vector<std::string> arguments,
-                                        std::string cmdName,
-                                        std::vector<File> outputFiles,
-                                        File *inputFile)
+int DFT::CommandExecutor::runCommand(std::string command,
+                                     std::vector<std::string> arguments,
+                                     std::string cmdName,
+                                     CommandOutput &output,
+                                     std::vector<File> outputFiles,
+                                     File *inputFile)
 {
 	Shell::SystemOptions sysOps;
 	sysOps.verbosity = VERBOSITY_EXECUTIONS;
 	sysOps.cwd = workingDir;
 	sysOps.command = command;
 	sysOps.arguments = arguments;
-	string base = workingDir + "/" + baseFile + "."
-	              + std::to_string(commandNum++) + "." + cmdName;
-	sysOps.reportFile = base + ".report";
+	int num;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		num = commandNum++;
+	}
+	string name = baseFile + "." + std::to_string(num) + "." + cmdName;
+	string base = workingDir + "/" + name;
 	sysOps.errFile    = base + ".err";
 	sysOps.outFile    = base + ".out";
+	sysOps.spillLimit = SPILL_LIMIT;
+	sysOps.timeout    = limit.time;
+	sysOps.memoryLimit = limit.memory;
+	sysOps.cancel     = cancel;
+	/* Never wait for the user, a killed command just fails */
+	sysOps.signalHandler = nullptr;
 	if (inputFile != nullptr)
 		sysOps.inFile     = inputFile->getFileRealPath();
-	int result = Shell::system(sysOps);
+	output.outFile = sysOps.outFile;
+	output.errFile = sysOps.errFile;
+	if (cancel && *cancel)
+		return 1;
 
-	if(result) {
-		printOutput(File(sysOps.outFile), result);
-		printOutput(File(sysOps.errFile), result);
-		return "";
+	Trace::Span span(trace, cmdName, "command");
+	span.addArg("file", baseFile);
+	span.addArg("command", (uint64_t)num);
+	Shell::RunStatistics runStats;
+	int result = Shell::spawn(sysOps, &output.out, &output.err, &runStats);
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stats.addTimeMaxMem(runStats);
+	}
+
+	bool failed = result != 0;
+	bool limitable = failed && !(cancel && *cancel);
+	if (killedBy(result)) {
+		mf->reportError(cmdName + " was killed by signal "
+		                + std::to_string(killedBy(result)));
+	}
+	/* Whether a limit was hit is decided from how the command ended and
+	 * its resource usage, not from its output. A command that fails to
+	 * allocate memory under the limit (set with setrlimit()) exits with
+	 * an error, which is only recognised if it came close to the limit.
+	 * Crashes on other signals are plain failures, so they are not
+	 * hidden behind a fallback.
+	 */
+	if (limitable && limit.time > 0 && runStats.time_elapsed >= limit.time) {
+		mf->reportError(cmdName + " exceeded the time limit of "
+		                + std::to_string(limit.time) + " seconds");
+		exceeded = true;
+	} else if (limitable && limit.memory
+	           && (killedForMemory(result)
+	               || (exitedWithError(result)
+	                   && runStats.mem_resident * 1024 >= limit.memory * 0.8)))
+	{
+		mf->reportError(cmdName + " exceeded the memory limit of "
+		                + std::to_string(limit.memory / (1024 * 1024)) + " MB");
+		exceeded = true;
 	}
 	for (File expected : outputFiles) {
-		if (!FileSystem::exists(expected)) {
-			printOutput(File(sysOps.outFile), result);
-			printOutput(File(sysOps.errFile), result);
-			return "";
+		if (!failed && !FileSystem::exists(expected))
+			failed = true;
+	}
+	if (trace) {
+		span.addArg("status", std::to_string(result));
+		span.addArg("max rss KB", (uint64_t)runStats.mem_resident);
+		span.addArg("stdout bytes", output.out.spilled
+		            ? FileSystem::getFileSize(File(sysOps.outFile))
+		            : output.out.contents.length());
+		for (File &produced : outputFiles) {
+			span.addArg(produced.getFileExtension() + " bytes",
+			            FileSystem::getFileSize(produced));
 		}
 	}
-	if (mf->getVerbosity() >= 5) {
-		printOutput(File(sysOps.outFile), result);
-		printOutput(File(sysOps.errFile), result);
+	if (failed || mf->getVerbosity() >= 5) {
+		printOutput(name + ".out", output.out, sysOps.outFile, result);
+		printOutput(name + ".err", output.err, sysOps.errFile, result);
 	}
-	return sysOps.outFile;
+	return failed;
 }
@@ -2,34 +2,147 @@
 #define DFTCALC_EXECUTOR_H
 #include "MessageFormatter.h"
 #include "FileSystem.h"
+#include "Shell.h"
+#include "Trace.h"
+#include <atomic>
+#include <mutex>
+#include <istream>
+#include <memory>
 
 namespace DFT{
+
+/**
+ * The output of a command run by the CommandExecutor. The output is kept
+ * in memory, unless it is too large, in which case it is in a file.
+ */
+class CommandOutput {
+public:
+	Shell::Capture out;
+	Shell::Capture err;
+	std::string outFile;
+	std::string errFile;
+
+	/**
+	 * Returns the complete standard output of the command.
+	 */
+	std::string getOutput() const;
+
+	/**
+	 * Opens the standard output of the command for reading.
+	 */
+	std::unique_ptr<std::istream> openOutput() const;
+};
+
+/**
+ * Limits on the resources of each command run by a CommandExecutor.
+ */
+class ResourceLimit {
+public:
+	/// Wall-clock time in seconds, or 0 for no limit
+	double time;
+	/// Memory in bytes, or 0 for no limit
+	size_t memory;
+
+	ResourceLimit(): time(0), memory(0) {}
+};
+
 class CommandExecutor {
 private:
 	MessageFormatter *mf;
 	int commandNum;
+	ResourceLimit limit;
+	std::atomic<bool> exceeded;
+	const std::atomic<bool> *cancel;
+	Trace *trace;
+	Shell::RunStatistics stats;
+	/// Protects commandNum and stats, so commands may run concurrently
+	std::mutex lock;
+
+	void printOutput(const std::string &name, const Shell::Capture &output,
+	                 const std::string &file, int status);
 
 public:
+	/// Output larger than this is written to file instead of kept in memory
+	static const size_t SPILL_LIMIT;
+
 	const std::string baseFile;
 	const std::string workingDir;
 	CommandExecutor(MessageFormatter *mf, std::string workingDir,
 	                std::string baseFile)
-		: mf(mf), commandNum(0),
-		  baseFile(baseFile), workingDir(workingDir)
+		: mf(mf), commandNum(0), exceeded(false), cancel(nullptr),
+		  trace(nullptr), baseFile(baseFile), workingDir(workingDir)
 	{}
 
-	void printOutput(const File& file, int status);
+	/**
+	 * Sets the limits for the commands run from now on. By default,
+	 * there are no limits.
+	 */
+	void setLimit(const ResourceLimit &limit) { this->limit = limit; }
+
+	/**
+	 * Returns whether a command has failed by exceeding its limits.
+	 */
+	bool limitExceeded() const { return exceeded; }
+
+	/**
+	 * Sets a flag that terminates the running command (and makes
+	 * further commands fail) when it becomes true.
+	 */
+	void setCancel(const std::atomic<bool> *flag) { cancel = flag; }
+
+	/**
+	 * Sets the trace receiving a span for every command run, or NULL
+	 * to not trace the commands.
+	 */
+	void setTrace(Trace *trace) { this->trace = trace; }
+
+	/**
+	 * Returns the trace set by setTrace(), or NULL.
+	 */
+	Trace *getTrace() const { return trace; }
 
+	/**
+	 * Returns the total time and maximum memory of the commands run.
+	 */
+	Shell::RunStatistics getStatistics() {
+		std::lock_guard<std::mutex> guard(lock);
+		return stats;
+	}
+
+	/**
+	 * Returns a new file name in the working directory, not used by
+	 * any other command.
+	 */
 	std::string genInputFile(std::string extension);
 
-	std::string runCommand(std::string command,
-	                       std::vector<std::string> arguments,
-                           std::string cmdName,
-                           std::vector<File> outputFiles = std::vector<File>(),
-	                   File *inputFile = nullptr
-	);
+	/**
+	 * Runs a command, keeping its output.
+	 * @param output Receives the output of the command.
+	 * @param outputFiles Files the command should produce, the command
+	 * 	is considered to have failed if any of these is missing.
+	 * @param inputFile If not null, the file given to the command as
+	 * 	standard input.
+	 * @return 0 if successful, non-zero otherwise.
+	 */
+	int runCommand(std::string command,
+	               std::vector<std::string> arguments,
+	               std::string cmdName,
+	               CommandOutput &output,
+	               std::vector<File> outputFiles = std::vector<File>(),
+	               File *inputFile = nullptr);
+
+	int runCommand(std::string command,
+	               std::vector<std::string> arguments,
+	               std::string cmdName,
+	               std::vector<File> outputFiles = std::vector<File>(),
+	               File *inputFile = nullptr)
+	{
+		CommandOutput output;
+		return runCommand(command, arguments, cmdName, output,
+		                  outputFiles, inputFile);
+	}
 
-	std::string runCommand(std::string command,
+	int runCommand(std::string command,
 		std::vector<std::string> arguments,
 		std::string cmdName,
 		File outputFile)
@@ -39,17 +152,17 @@ public:
 		return runCommand(command, arguments, cmdName, outputs);
 	}
 
-	std::string runCommand(std::string command,
-	                       std::string cmdName,
-			       File outputFile)
+	int runCommand(std::string command,
+	               std::string cmdName,
+	               File outputFile)
 	{
 		std::vector<File> outputs;
 		outputs.push_back(outputFile);
 		return runCommand(command, std::vector<std::string>(), cmdName, outputs);
 	}
 
-	std::string runCommand(std::string command,
-	                       std::string cmdName)
+	int runCommand(std::string command,
+	               std::string cmdName)
 	{
 		return runCommand(command, std::vector<std::string>(), cmdName, std::vector<File>());
 	}
@@ -55,31 +55,17 @@ static void getOptions(Query q, std::vector<std::string> &options) {
 	}
 }
 
-bool parseOutputFile(File file, Query q,
-                     vector<DFT::DFTCalculationResultItem> &ret)
+bool parseOutput(const std::string &output, Query q,
+                 vector<DFT::DFTCalculationResultItem> &ret)
 {
 	/* This function assumes that the answer to only the given query is
 	 * in the result file. It is entirely possible in IMCA to have
 	 * multiple queries in one file, and if we ever need to include that
 	 * optimization, we need to change this parser.
 	 */
-	FILE* fp;
-	long len;
-	char* buffer;
-
-	fp = fopen(file.getFileRealPath().c_str(),"rb");
-	if (!fp)
-		return 0;
-	fseek(fp,0,SEEK_END);
-	len = ftell(fp)+1;
-	fseek(fp,0,SEEK_SET);
-	buffer = (char *)malloc(len);
-	if (buffer)
-		len = fread(buffer,len,1,fp); //read into buffer
-
-	fclose(fp);
-
-	if (len != 1)
+	/* The parser below modifies the buffer, so work on a copy */
+	char* buffer = strdup(output.c_str());
+	if (!buffer)
 		return 0;
 
 	decnumber<> margin = q.errorBound;
@@ -231,22 +217,33 @@ std::vector<DFT::DFTCalculationResultItem> IMCARunner::analyze(vector<Query> que
 {
 	std::vector<DFT::DFTCalculationResultItem> ret;
 	messageFormatter->reportAction("Calculating probability with IMCA...",DFT::VERBOSITY_FLOW);
-	for(Query query: queries) {
+	/* IMCA checks one query per run, so the queries are run
+	 * concurrently and their results concatenated afterwards.
+	 */
+	std::vector<std::vector<DFT::DFTCalculationResultItem>> results(queries.size());
+	std::vector<char> done(queries.size(), false);
+	runConcurrently(queries.size(), [&](size_t i) {
+		const Query &query = queries[i];
 		// imca -> calculation
 		std::vector<std::string> arguments;
 		arguments.push_back(modelFile.getFileRealPath());
 		getOptions(query, arguments);
 
-		std::string out = exec->runCommand(imcaExec.getFilePath(),
-				arguments, "imca");
-		if (out == "")
-			return ret;
+		DFT::CommandOutput output;
+		if (exec->runCommand(imcaExec.getFilePath(), arguments,
+		                     "imca", output))
+		{
+			return 1;
+		}
 
-		File outFile(out);
-		if (!parseOutputFile(outFile, query, ret)) {
+		if (!parseOutput(output.getOutput(), query, results[i])) {
 			messageFormatter->reportError("Could not calculate");
-			return ret;
+			return 1;
 		}
-	}
+		done[i] = true;
+		return 0;
+	});
+	for (size_t i = 0; i < results.size() && done[i]; i++)
+		ret.insert(ret.end(), results[i].begin(), results[i].end());
 	return ret;
 }
@@ -0,0 +1,167 @@
+/*
+ * manifest.cpp
+ *
+ * Part of dft2lnt library - a library containing read/write operations for DFT
+ * files in Galileo format and translating DFT specifications into Lotos NT.
+ *
+ * @author Enno Ruijters
+ */
+
+#include "manifest.h"
+
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+/* 64-bit FNV-1a, as used by the result cache */
+static uint64_t hashAppend(uint64_t hash, const char *data, size_t len)
+{
+	for (size_t i = 0; i < len; i++) {
+		hash ^= (unsigned char)data[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+static uint64_t hashAppend(uint64_t hash, const std::string &data)
+{
+	hash = hashAppend(hash, data.data(), data.size());
+	/* Separator, so that ("ab", "c") and ("a", "bc") differ */
+	hash ^= 0xff;
+	hash *= 0x100000001b3ULL;
+	return hash;
+}
+
+static std::string toHex(uint64_t hash)
+{
+	std::stringstream ss;
+	ss << std::hex << std::setw(16) << std::setfill('0') << hash;
+	return ss.str();
+}
+
+static File manifestOf(const File &file)
+{
+	return File(file.getFileRealPath() + ".manifest");
+}
+
+/* Missing files hash differently from every (empty) file */
+static std::string hashContents(const File &file)
+{
+	std::ifstream in(file.getFileRealPath(), std::ios::binary);
+	if (!in.good())
+		return "missing";
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	std::vector<char> buffer(1 << 20);
+	while (in) {
+		in.read(buffer.data(), buffer.size());
+		hash = hashAppend(hash, buffer.data(), in.gcount());
+	}
+	return toHex(hash);
+}
+
+/**
+ * The contents of the manifest of a file, if it describes the current
+ * contents of the file.
+ */
+struct Manifest {
+	std::string key;
+	std::string hash;
+};
+
+static bool readManifest(const File &file, Manifest &ret)
+{
+	if (!FileSystem::exists(file))
+		return false;
+	std::ifstream in(manifestOf(file).getFileRealPath());
+	uint64_t size = 0;
+	time_t mtime = 0;
+	std::string field;
+	while (in >> field) {
+		if (field == "key")
+			in >> ret.key;
+		else if (field == "size")
+			in >> size;
+		else if (field == "mtime")
+			in >> mtime;
+		else if (field == "hash")
+			in >> ret.hash;
+	}
+	if (ret.key.empty() || ret.hash.empty()
+	    || size != FileSystem::getFileSize(file)
+	    || mtime != FileSystem::getLastModificationTime(file))
+	{
+		return false;
+	}
+	/* Modification times have a resolution of a second, so a file
+	 * modified in the second its manifest was written (or later) may
+	 * have changed without its modification time changing. Its
+	 * contents are then checked instead, as git does for racily clean
+	 * files.
+	 */
+	if (mtime >= FileSystem::getLastModificationTime(manifestOf(file)))
+		return hashContents(file) == ret.hash;
+	return true;
+}
+
+DFT::StageManifest::StageManifest(const std::vector<File> &outputs)
+	:outputs(outputs), key(0xcbf29ce484222325ULL)
+{
+}
+
+DFT::StageManifest::StageManifest(const File &output)
+	:outputs(1, output), key(0xcbf29ce484222325ULL)
+{
+}
+
+void DFT::StageManifest::addSetting(const std::string &setting)
+{
+	key = hashAppend(key, setting);
+}
+
+void DFT::StageManifest::addTool(const File &tool)
+{
+	key = hashAppend(key, tool.getFileRealPath() + "@"
+	                 + std::to_string(FileSystem::getLastModificationTime(tool)));
+}
+
+void DFT::StageManifest::addInput(const File &input)
+{
+	key = hashAppend(key, hashFile(input));
+}
+
+bool DFT::StageManifest::upToDate() const
+{
+	std::string k = toHex(key);
+	for (const File &output : outputs) {
+		Manifest m;
+		if (!readManifest(output, m) || m.key != k)
+			return false;
+	}
+	return true;
+}
+
+int DFT::StageManifest::record() const
+{
+	int ret = 0;
+	std::string k = toHex(key);
+	for (const File &output : outputs) {
+		std::string hash = hashFile(output);
+		std::ofstream out(manifestOf(output).getFileRealPath());
+		out << "key " << k << "\n"
+		    << "size " << FileSystem::getFileSize(output) << "\n"
+		    << "mtime " << FileSystem::getLastModificationTime(output) << "\n"
+		    << "hash " << hash << "\n";
+		out.close();
+		if (!out.good())
+			ret = 1;
+	}
+	return ret;
+}
+
+std::string DFT::StageManifest::hashFile(const File &file)
+{
+	Manifest m;
+	if (readManifest(file, m))
+		return m.hash;
+	return hashContents(file);
+}
@@ -0,0 +1,79 @@
+/*
+ * manifest.h
+ *
+ * Part of dft2lnt library - a library containing read/write operations for DFT
+ * files in Galileo format and translating DFT specifications into Lotos NT.
+ *
+ * @author Enno Ruijters
+ */
+
+#ifndef DFTCALC_MANIFEST_H
+#define DFTCALC_MANIFEST_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "FileSystem.h"
+
+namespace DFT {
+
+/**
+ * Decides whether the outputs of a stage of the analysis (e.g., composing
+ * the IMC) can be reused, as make or ninja would, but by the contents of
+ * the inputs instead of their modification times.
+ * Every output has a manifest (its file name with ".manifest" appended)
+ * recording a hash over the inputs, tools and settings of the stage that
+ * produced it, and the size, modification time and hash of the output
+ * itself. A later stage using the output as its input takes its hash from
+ * the manifest instead of reading it again, unless the output has been
+ * modified since.
+ */
+class StageManifest {
+private:
+	std::vector<File> outputs;
+	uint64_t key;
+
+public:
+	StageManifest(const std::vector<File> &outputs);
+	StageManifest(const File &output);
+
+	/**
+	 * Includes a setting (e.g., an argument or the contents of a
+	 * file generated in memory) in the key of the stage.
+	 */
+	void addSetting(const std::string &setting);
+
+	/**
+	 * Includes a tool in the key of the stage, by its location and
+	 * modification time (so updating the tool reruns the stage).
+	 */
+	void addTool(const File &tool);
+
+	/**
+	 * Includes the contents of an input file in the key of the stage.
+	 */
+	void addInput(const File &input);
+
+	/**
+	 * Returns whether every output exists, has not been modified since
+	 * it was produced, and was produced from the same key.
+	 */
+	bool upToDate() const;
+
+	/**
+	 * Writes the manifests of the outputs, after the stage has
+	 * produced them.
+	 * @return 0 if successful, non-zero otherwise
+	 */
+	int record() const;
+
+	/**
+	 * Returns the hash of the contents of a file, from its manifest if
+	 * it has an up-to-date one.
+	 */
+	static std::string hashFile(const File &file);
+};
+
+} // Namespace: DFT
+
+#endif
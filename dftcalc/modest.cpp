@@ -12,22 +12,24 @@
 #include "FileSystem.h"
 #include "FileWriter.h"
 #include <fstream>
+#include <sstream>
 #include <vector>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <iostream>
 #include <stdexcept>
+#include <algorithm>
 
-std::vector<std::string> ModestRunner::getCommandOptions(Query q)
+std::vector<std::string> ModestRunner::getCommandOptions(const std::string &times,
+                                                        const Query &q)
 {
 	std::vector<std::string> ret;
 	ret.push_back("-E");
-	if (q.type == TIMEBOUND) {
-		ret.push_back("T=" + q.upperBound.str() + ",L=" + q.lowerBound.str());
-	} else {
-		ret.push_back("T=1,L=0");
-	}
+	if (q.type == TIMEBOUND)
+		ret.push_back("T=" + times + ",L=" + q.lowerBound.str());
+	else
+		ret.push_back("T=" + times + ",L=0");
 	if (q.errorBoundSet) {
 		ret.push_back("--epsilon");
 		ret.push_back(q.errorBound.str());
@@ -63,16 +65,17 @@ static std::string getQuery(Query q)
 	return ret;
 }
 
-static int readOutputFile(File file, DFT::DFTCalculationResultItem &it) {
-	if(!FileSystem::exists(file))
-		return -1;
-
+/* Reads the result of the query of the item from the specified
+ * experiment, i.e., the specified occurrence of its property in the
+ * output.
+ */
+static int readOutput(std::istream &input, DFT::DFTCalculationResultItem &it,
+                      size_t experiment) {
 	std::string needle = "+ Property " + getQuery(it.query);
-	std::ifstream input(file.getFileRealPath());
 	std::string line;
 	std::getline(input, line);
 	while (input.good()) {
-		if (line.find(needle) == 0) {
+		if (line.find(needle) == 0 && experiment-- == 0) {
 			std::getline(input, line);
 			std::getline(input, line);
 			if (!input.good())
@@ -101,29 +104,114 @@ std::vector<DFT::DFTCalculationResultItem> ModestRunner::analyze(std::vector<Que
 	std::vector<DFT::DFTCalculationResultItem> ret;
 	expandRangeQueries(queries);
 	messageFormatter->reportAction("Calculating probability with Modest", DFT::VERBOSITY_FLOW);
-	for (Query q : queries) {
-		std::vector<std::string> arguments = getCommandOptions(q);
-		arguments.push_back(janiFile.getFileRealPath());
-		DFT::DFTCalculationResultItem it(q);
-		int result;
-		if (q.type != TIMEBOUND || q.upperBound != 0) {
-			std::string of = exec->runCommand(modestCmd, arguments, "modest");
-			if (of == "")
-				return ret; /* Exec should have reported already */
-			result = readOutputFile(of, it);
-			if (result == -1) {
-				messageFormatter->reportError("Could not calculate.");
-				return ret;
-			}
-		} else {
+
+	/* mcsta checks all properties of the model in every run, and runs
+	 * one experiment per value of a constant given as a range (e.g.,
+	 * T=0:100:1). Queries with the same lower time bound L and error
+	 * bound are therefore grouped, and each evenly spaced sequence of
+	 * their upper time bounds T is answered from a single run. Queries
+	 * not depending on T are read from the first experiment. Runs are
+	 * independent and may run concurrently.
+	 */
+	struct Run {
+		std::vector<std::string> options;
+		/* The query and the experiment answering it */
+		std::vector<std::pair<size_t, size_t>> items;
+	};
+	std::vector<std::pair<std::string, std::vector<size_t>>> groups;
+	std::vector<DFT::DFTCalculationResultItem> results;
+	std::vector<char> done(queries.size(), false);
+	for (size_t i = 0; i < queries.size(); i++) {
+		const Query &q = queries[i];
+		results.push_back(DFT::DFTCalculationResultItem(q));
+		if (q.type == TIMEBOUND && q.upperBound == 0) {
 			/* Incorrect for models with prob= BEs, but needed since
 			 * Modest doesn't handle the query otherwise.
 			 */
-			it.exactBounds = 1;
-			it.lowerBound = it.upperBound = (uintmax_t)0;
-			result = 0;
+			results[i].exactBounds = 1;
+			results[i].lowerBound = results[i].upperBound = (uintmax_t)0;
+			done[i] = true;
+			continue;
+		}
+		std::string key = q.type == TIMEBOUND ? q.lowerBound.str() : "0";
+		if (q.errorBoundSet)
+			key += " " + q.errorBound.str();
+		size_t g = 0;
+		while (g < groups.size() && groups[g].first != key)
+			g++;
+		if (g == groups.size())
+			groups.push_back(std::make_pair(key, std::vector<size_t>()));
+		groups[g].second.push_back(i);
+	}
+
+	std::vector<Run> runs;
+	for (auto &group : groups) {
+		const Query &first = queries[group.second[0]];
+		std::vector<decnumber<>> times;
+		for (size_t i : group.second) {
+			if (queries[i].type == TIMEBOUND)
+				times.push_back(queries[i].upperBound);
+		}
+		std::sort(times.begin(), times.end());
+		times.erase(std::unique(times.begin(), times.end()), times.end());
+
+		/* The run and experiment of each time bound */
+		std::vector<std::pair<size_t, size_t>> slots(times.size());
+		size_t firstRun = runs.size();
+		size_t start = 0;
+		while (start < times.size()) {
+			size_t end = start + 1;
+			std::string range = times[start].str();
+			if (end < times.size()) {
+				decnumber<> step = times[end] - times[start];
+				while (end + 1 < times.size()
+				       && times[end + 1] - times[end] == step)
+				{
+					end++;
+				}
+				range += ":" + times[end].str() + ":" + step.str();
+				end++;
+			}
+			for (size_t t = start; t < end; t++)
+				slots[t] = std::make_pair(runs.size(), t - start);
+			runs.push_back(Run());
+			runs.back().options = getCommandOptions(range, first);
+			start = end;
+		}
+		if (runs.size() == firstRun) {
+			runs.push_back(Run());
+			runs.back().options = getCommandOptions("1", first);
+		}
+
+		for (size_t i : group.second) {
+			if (queries[i].type != TIMEBOUND) {
+				runs[firstRun].items.push_back(std::make_pair(i, 0));
+				continue;
+			}
+			size_t t = std::lower_bound(times.begin(), times.end(),
+			                            queries[i].upperBound)
+			           - times.begin();
+			runs[slots[t].first].items.push_back(std::make_pair(i, slots[t].second));
 		}
-		if (result == 0 && !it.exactBounds) {
+	}
+
+	runConcurrently(runs.size(), [&](size_t r) {
+		Run &run = runs[r];
+		std::vector<std::string> arguments = run.options;
+		arguments.push_back(janiFile.getFileRealPath());
+		DFT::CommandOutput output;
+		if (exec->runCommand(modestCmd, arguments, "modest", output))
+			return 1; /* Exec should have reported already */
+		std::string contents = output.getOutput();
+		for (auto &item : run.items) {
+			size_t i = item.first;
+			const Query &q = queries[i];
+			DFT::DFTCalculationResultItem &it = results[i];
+			std::istringstream input(contents);
+			if (readOutput(input, it, item.second) == -1) {
+				messageFormatter->reportError("Could not calculate.");
+				return 1;
+			}
 			decnumber<> margin = q.errorBound;
 			if (q.errorBoundSet)
 				margin *= 0.5;
@@ -140,9 +228,16 @@ std::vector<DFT::DFTCalculationResultItem> ModestRunner::analyze(std::vector<Que
 			}
 			if (it.lowerBound < decnumber<>(0) && q.type != CUSTOM)
 				it.lowerBound = (intmax_t)0;
+			done[i] = true;
 		}
-		ret.push_back(it);
-	}
+		return 0;
+	});
+
+	/* On failure, only the results up to the first missing one are
+	 * returned.
+	 */
+	for (size_t i = 0; i < results.size() && done[i]; i++)
+		ret.push_back(results[i]);
 	messageFormatter->reportAction("Done calculating probability with Modest", DFT::VERBOSITY_FLOW);
 	return ret;
 }
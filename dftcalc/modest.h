@@ -19,7 +19,8 @@ class ModestRunner : public Checker{
 private:
 	const File janiFile;
 	const std::string modestCmd;
-	std::vector<std::string> getCommandOptions(Query q);
+	std::vector<std::string> getCommandOptions(const std::string &times,
+	                                           const Query &q);
 public:
 	ModestRunner(MessageFormatter *mf, DFT::CommandExecutor *exec,
 	             std::string modestCmd, File model)
@@ -36,7 +36,7 @@ static std::string getQuery(Query q, std::string goalLabel) {
 		ret += "S" + minMax + "[" + goalLabel + "]";
 		break;
 	case TIMEBOUND:
-		ret = "P" + minMax + "[tt U[";
+		ret += "P" + minMax + "[tt U[";
 		if (q.step == -1)
 			ret += q.lowerBound.str() + ", " + q.upperBound.str();
 		else
@@ -44,7 +44,7 @@ static std::string getQuery(Query q, std::string goalLabel) {
 		ret += "] " + goalLabel + "]";
 		break;
 	case UNBOUNDED:
-		ret = "P" + minMax + "[tt U " + goalLabel + "]";
+		ret += "P" + minMax + "[tt U " + goalLabel + "]";
 		break;
 	default:
 		throw std::logic_error("Unsupported query type for IMCA.");
@@ -53,51 +53,19 @@ static std::string getQuery(Query q, std::string goalLabel) {
 	return ret;
 }
 
-static std::pair<decnumber<>, decnumber<>> readOutputFile(const File& file) {
-	std::pair<decnumber<>, decnumber<>> ret(-1, -1);
-
-	FILE* fp;
-	long len;
-	char* buffer;
-
-	fp = fopen(file.getFileRealPath().c_str(),"rb");
-	if (!fp)
-		return ret;
-	fseek(fp,0,SEEK_END);
-	len = ftell(fp);
-	fseek(fp,0,SEEK_SET);
-	buffer = (char *)malloc(len + 1);
-	if (fread(buffer, len, 1, fp) != 1) {
-		fclose(fp);
-		free(buffer);
-		throw std::ios_base::failure("Error reading IMRMC output file");
-	}
-	buffer[len] = 0;
-	fclose(fp);
-
-	const char *resultString, *c;
-	resultString = strstr(buffer, "$MIN_RESULT");
-	if (resultString)
-		c = resultString + 15;
-	if (!resultString) {
-		resultString = strstr(buffer, "$MAX_RESULT");
-		if (resultString)
-			c = resultString + 15;
-	}
-	if (!resultString) {
-		resultString = strstr(buffer, "$RESULT[1]");
-		if (resultString)
-			c = resultString + 13;
-	}
-	if (!resultString) {
-		resultString = strstr(buffer, "$RESULT:");
-		if (resultString)
-			c = resultString + 11;
-	}
-
-	if(!resultString)
-		return ret;
+static const struct {
+	const char *needle;
+	size_t skip;
+} resultNeedles[] = {
+	{"$MIN_RESULT", 15},
+	{"$MAX_RESULT", 15},
+	{"$RESULT[1]", 13},
+	{"$RESULT:", 11},
+};
 
+/* Parses the result value starting at c */
+static std::pair<decnumber<>, decnumber<>> parseResult(const char *c) {
+	std::pair<decnumber<>, decnumber<>> ret(-1, -1);
 	const char *end = c;
 	while (*end && *end != '\n' && *end != '\r')
 		end++;
@@ -127,7 +95,39 @@ static std::pair<decnumber<>, decnumber<>> readOutputFile(const File& file) {
 		ret = std::pair<decnumber<>, decnumber<>>(low, up);
 	}
 
-	free(buffer);
+	return ret;
+}
+
+/* Reads the result of a script checking a single formula */
+static std::pair<decnumber<>, decnumber<>> readOutput(const std::string &output) {
+	for (auto &r : resultNeedles) {
+		size_t pos = output.find(r.needle);
+		if (pos != std::string::npos && pos + r.skip <= output.length())
+			return parseResult(output.c_str() + pos + r.skip);
+	}
+	return std::pair<decnumber<>, decnumber<>>(-1, -1);
+}
+
+/* Reads the results of a script checking several formulas, taking each
+ * result from the first result line after the previous one.
+ */
+static std::vector<std::pair<decnumber<>, decnumber<>>> readOutputs(const std::string &output) {
+	std::vector<std::pair<decnumber<>, decnumber<>>> ret;
+	size_t pos = 0;
+	while (pos < output.length()) {
+		size_t first = std::string::npos, skip = 0;
+		for (auto &r : resultNeedles) {
+			size_t found = output.find(r.needle, pos);
+			if (found < first) {
+				first = found;
+				skip = r.skip;
+			}
+		}
+		if (first == std::string::npos || first + skip > output.length())
+			break;
+		ret.push_back(parseResult(output.c_str() + first + skip));
+		pos = output.find('\n', first);
+	}
 	return ret;
 }
 
@@ -153,40 +153,75 @@ void expandRangeQueries(std::vector<Query> &queries) {
 	}
 }
 
+int MRMCRunner::runScript(const std::vector<Query> &queries,
+                          std::vector<std::pair<decnumber<>, decnumber<>>> &results)
+{
+	File inputFile = exec->genInputFile("query");
+	std::ofstream out(inputFile.getFileRealPath());
+	if(!out.is_open()) {
+		messageFormatter->reportError("Could not open "
+		                + inputFile.getFileRealPath());
+		return 1;
+	}
+	out << "set print off\n";
+	for (const Query &q : queries) {
+		out << getQuery(q, goalLabel);
+		out << "$RESULT[1]\n";
+	}
+	out << "quit\n";
+	out.close();
+	std::vector<std::string> arguments;
+	arguments.push_back(isCtmdp ? "ctmdpi" : "ctmc");
+	arguments.push_back(modelFile.getFileRealPath());
+	arguments.push_back(labFile.getFileRealPath());
+
+	DFT::CommandOutput output;
+	if (exec->runCommand(mrmcExec.getFilePath(), arguments,
+	                     mrmcExec.getFileName(), output,
+	                     std::vector<File>(), &inputFile))
+	{
+		return 1; /* Exec should have reported already */
+	}
+	if (queries.size() == 1)
+		results.push_back(readOutput(output.getOutput()));
+	else
+		results = readOutputs(output.getOutput());
+	return 0;
+}
+
 std::vector<DFT::DFTCalculationResultItem> MRMCRunner::analyze(
 		std::vector<Query> queries)
 {
 	std::vector<DFT::DFTCalculationResultItem> ret;
 	expandRangeQueries(queries);
 	messageFormatter->reportAction("Calculating probability with " + mrmcExec.getFileName(), DFT::VERBOSITY_FLOW);
-	for (Query q : queries) {
-		File inputFile = exec->genInputFile("query");
-		std::string qText = getQuery(q, goalLabel);
-		std::ofstream out(inputFile.getFileRealPath());
-		if(!out.is_open()) {
-			messageFormatter->reportError("Could not open "
-			                + inputFile.getFileRealPath());
+
+	/* All formulas are checked by a single script, so the model is only
+	 * read once. If the results cannot be matched to the formulas, each
+	 * formula is checked by its own script instead, running these
+	 * scripts concurrently.
+	 */
+	std::vector<std::pair<decnumber<>, decnumber<>>> results;
+	if (queries.size() > 1) {
+		if (runScript(queries, results))
 			return ret;
+		if (results.size() != queries.size()) {
+			messageFormatter->reportAction("Could not match " + mrmcExec.getFileName() + " results to formulas, checking them one at a time", DFT::VERBOSITY_FLOW);
+			results.clear();
 		}
-		out << "set print off\n";
-		out << qText;
-		out << "$RESULT[1]\n";
-		out << "quit\n";
-		out.close();
-		std::vector<std::string> arguments;
-		arguments.push_back(isCtmdp ? "ctmdpi" : "ctmc");
-		arguments.push_back(modelFile.getFileRealPath());
-		arguments.push_back(labFile.getFileRealPath());
+	}
+	if (results.empty()) {
+		std::vector<std::vector<std::pair<decnumber<>, decnumber<>>>> single(queries.size());
+		runConcurrently(queries.size(), [&](size_t i) {
+			return runScript(std::vector<Query>(1, queries[i]), single[i]);
+		});
+		for (size_t i = 0; i < single.size() && !single[i].empty(); i++)
+			results.push_back(single[i][0]);
+	}
 
-		std::string res = exec->runCommand(
-				mrmcExec.getFilePath(),
-				arguments,
-				mrmcExec.getFileName(),
-				std::vector<File>(),
-				&inputFile);
-		if (res == "")
-			return ret; /* Exec should have reported already */
-		auto result = readOutputFile(res);
+	for (size_t i = 0; i < results.size(); i++) {
+		const Query &q = queries[i];
+		auto &result = results[i];
 		if (result.first == -1) {
 			messageFormatter->reportError("Could not calculate.");
 			return ret;
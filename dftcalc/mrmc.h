@@ -23,6 +23,10 @@ private:
 	const File modelFile, labFile;
 	const bool isCtmdp;
 	const File mrmcExec;
+
+	/* Checks all queries in one run, appending their results */
+	int runScript(const std::vector<Query> &queries,
+	              std::vector<std::pair<decnumber<>, decnumber<>>> &results);
 public:
 	MRMCRunner(MessageFormatter *mf, DFT::CommandExecutor *exec,
 	           bool imrmc, File executable, File model, File lab)
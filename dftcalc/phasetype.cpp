@@ -0,0 +1,344 @@
+/*
+ * phasetype.cpp
+ *
+ * Part of dft2lnt library - a library containing read/write operations for DFT
+ * files in Galileo format and translating DFT specifications into Lotos NT.
+ *
+ * @author Enno Ruijters
+ */
+
+#include "phasetype.h"
+
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+/* The class of the absorbing state during minimization */
+static const size_t ABSORBED = std::numeric_limits<size_t>::max();
+
+static void addRate(std::map<size_t, decnumber<>> &rates, size_t to,
+                    const decnumber<> &rate)
+{
+	rates.emplace(to, decnumber<>(0)).first->second += rate;
+}
+
+DFT::PhaseType DFT::PhaseType::exponential(const decnumber<> &rate)
+{
+	PhaseType ret;
+	ret.rates.emplace_back();
+	ret.absorptionRates.push_back(rate);
+	return ret;
+}
+
+int DFT::PhaseType::read(const File &tra, const File &lab, MessageFormatter *mf)
+{
+	std::ifstream labIn(lab.getFileRealPath());
+	if (!labIn.good()) {
+		mf->reportError("Could not open " + lab.getFileRealPath());
+		return 1;
+	}
+	std::vector<bool> failed;
+	std::string line;
+	bool declarations = true;
+	while (std::getline(labIn, line)) {
+		if (declarations) {
+			declarations = line.compare(0, 4, "#END") != 0;
+			continue;
+		}
+		std::istringstream ss(line);
+		size_t state;
+		std::string label;
+		if (!(ss >> state))
+			continue;
+		while (ss >> label) {
+			if (label != "marked")
+				continue;
+			if (failed.size() <= state)
+				failed.resize(state + 1);
+			failed[state] = true;
+		}
+	}
+
+	std::ifstream traIn(tra.getFileRealPath());
+	if (!traIn.good()) {
+		mf->reportError("Could not open " + tra.getFileRealPath());
+		return 1;
+	}
+	size_t nStates = 0;
+	/* The transient state of each state of the CTMC */
+	std::vector<size_t> transient;
+	rates.clear();
+	absorptionRates.clear();
+	try {
+		while (std::getline(traIn, line)) {
+			std::istringstream ss(line);
+			std::string from, to, rate, extra;
+			if (!(ss >> from))
+				continue;
+			if (from == "STATES") {
+				ss >> nStates;
+				failed.resize(nStates + 1);
+				transient.resize(nStates + 1);
+				for (size_t s = 1; s <= nStates; s++) {
+					if (failed[s])
+						continue;
+					transient[s] = rates.size();
+					rates.emplace_back();
+					absorptionRates.push_back(0);
+				}
+				continue;
+			} else if (from == "TRANSITIONS") {
+				continue;
+			} else if (from == "MODES" || from == "TIMES") {
+				mf->reportError("Module has time-dependent behaviour, cannot extract a phase-type distribution.");
+				return 1;
+			}
+			if (!(ss >> to >> rate) || (ss >> extra)) {
+				mf->reportError("Unexpected transition in " + tra.getFileRealPath() + ": " + line);
+				return 1;
+			}
+			size_t s = std::stoul(from), t = std::stoul(to);
+			if (s == 0 || t == 0 || s > nStates || t > nStates) {
+				mf->reportError("Transition between nonexistent states in " + tra.getFileRealPath() + ": " + line);
+				return 1;
+			}
+			if (failed[s] && !failed[t]) {
+				mf->reportError("Module can be repaired, cannot extract a phase-type distribution.");
+				return 1;
+			} else if (failed[s] || s == t) {
+				continue;
+			}
+			decnumber<> r(rate);
+			if (failed[t])
+				absorptionRates[transient[s]] += r;
+			else
+				addRate(rates[transient[s]], transient[t], r);
+		}
+	} catch (std::exception &e) {
+		mf->reportError("Could not parse " + tra.getFileRealPath() + ": " + e.what());
+		return 1;
+	}
+	if (nStates == 0) {
+		mf->reportError("No states in " + tra.getFileRealPath());
+		return 1;
+	}
+	failedInitially = failed[1];
+	initial = failedInitially ? 0 : transient[1];
+	return 0;
+}
+
+void DFT::PhaseType::minimize()
+{
+	size_t n = rates.size();
+	if (n == 0)
+		return;
+	std::vector<size_t> block(n, 0);
+	size_t nBlocks = 1;
+	for (;;) {
+		/* The new block of each state follows from its old block
+		 * and its rates into each (other) old block.
+		 */
+		typedef std::vector<std::pair<size_t, decnumber<>>> Signature;
+		std::map<std::pair<size_t, Signature>, size_t> blocks;
+		std::vector<size_t> next(n);
+		for (size_t s = 0; s < n; s++) {
+			std::map<size_t, decnumber<>> toBlock;
+			for (const auto &r : rates[s]) {
+				if (block[r.first] != block[s])
+					addRate(toBlock, block[r.first], r.second);
+			}
+			if (!absorptionRates[s].is_zero())
+				addRate(toBlock, ABSORBED, absorptionRates[s]);
+			std::pair<size_t, Signature> key(block[s],
+				Signature(toBlock.begin(), toBlock.end()));
+			next[s] = blocks.emplace(key, blocks.size()).first->second;
+		}
+		block.swap(next);
+		if (blocks.size() == nBlocks)
+			break;
+		nBlocks = blocks.size();
+	}
+
+	/* Any state of a block has the same rates into the other blocks */
+	std::vector<std::map<size_t, decnumber<>>> lumped(nBlocks);
+	std::vector<decnumber<>> lumpedAbsorption(nBlocks, decnumber<>(0));
+	std::vector<bool> done(nBlocks);
+	for (size_t s = 0; s < n; s++) {
+		size_t b = block[s];
+		if (done[b])
+			continue;
+		done[b] = true;
+		for (const auto &r : rates[s]) {
+			if (block[r.first] != b)
+				addRate(lumped[b], block[r.first], r.second);
+		}
+		lumpedAbsorption[b] = absorptionRates[s];
+	}
+	rates.swap(lumped);
+	absorptionRates.swap(lumpedAbsorption);
+	initial = block[initial];
+}
+
+int DFT::PhaseType::writeAUT(const File &aut, MessageFormatter *mf) const
+{
+	std::stringstream transitions;
+	size_t nTransitions = 0, nStates;
+	if (failedInitially) {
+		transitions << "(0, \"ACTIVATE\", 0)\n"
+		            << "(0, \"FAIL\", 1)\n"
+		            << "(1, \"ACTIVATE\", 1)\n";
+		nTransitions = 3;
+		nStates = 2;
+	} else {
+		/* The initial state must be state 0 */
+		size_t n = rates.size();
+		auto number = [&](size_t s) {
+			return s == initial ? 0 : s == 0 ? initial : s;
+		};
+		bool absorbing = false;
+		for (size_t s = 0; s < n; s++) {
+			size_t from = number(s);
+			transitions << "(" << from << ", \"ACTIVATE\", " << from << ")\n";
+			nTransitions++;
+			for (const auto &r : rates[s]) {
+				transitions << "(" << from << ", \"rate " << r.second.str()
+				            << "\", " << number(r.first) << ")\n";
+				nTransitions++;
+			}
+			if (!absorptionRates[s].is_zero()) {
+				transitions << "(" << from << ", \"rate "
+				            << absorptionRates[s].str() << "\", " << n << ")\n";
+				nTransitions++;
+				absorbing = true;
+			}
+		}
+		nStates = n;
+		/* The module fails immediately once absorbed */
+		if (absorbing) {
+			transitions << "(" << n << ", \"ACTIVATE\", " << n << ")\n"
+			            << "(" << n << ", \"FAIL\", " << n + 1 << ")\n"
+			            << "(" << n + 1 << ", \"ACTIVATE\", " << n + 1 << ")\n";
+			nTransitions += 3;
+			nStates += 2;
+		}
+	}
+
+	std::ofstream out(aut.getFileRealPath());
+	out << "des (0, " << nTransitions << ", " << nStates << ")\n"
+	    << transitions.str();
+	out.close();
+	if (!out.good()) {
+		mf->reportError("Could not write " + aut.getFileRealPath());
+		return 1;
+	}
+	return 0;
+}
+
+long double DFT::PhaseType::getFailureProbability() const
+{
+	if (failedInitially)
+		return 1;
+	size_t n = rates.size();
+	std::vector<long double> exit(n), absorb(n), x(n, 0);
+	std::vector<std::vector<std::pair<size_t, long double>>> to(n);
+	for (size_t s = 0; s < n; s++) {
+		absorb[s] = (long double)absorptionRates[s];
+		exit[s] = absorb[s];
+		for (const auto &r : rates[s]) {
+			to[s].emplace_back(r.first, (long double)r.second);
+			exit[s] += to[s].back().second;
+		}
+	}
+	/* Gauss-Seidel iteration of the absorption probabilities, which
+	 * converges in one sweep for the (usually acyclic) models of
+	 * modules without repairs if the later states come last.
+	 */
+	long double change = 1;
+	for (size_t sweep = 0; sweep < 100000 && change > 1e-18L; sweep++) {
+		change = 0;
+		for (size_t i = n; i-- > 0; ) {
+			if (exit[i] == 0)
+				continue;
+			long double v = absorb[i];
+			for (const auto &t : to[i])
+				v += t.second * x[t.first];
+			v /= exit[i];
+			change = std::max(change, std::fabs(v - x[i]));
+			x[i] = v;
+		}
+	}
+	return x[initial];
+}
+
+DFT::PhaseTypeTransient::PhaseTypeTransient(const PhaseType &ph)
+	:rate(0)
+{
+	size_t n = ph.getStates();
+	std::vector<long double> exit(n, 0);
+	for (size_t s = 0; s < n; s++) {
+		exit[s] = (long double)ph.getAbsorptionRates()[s];
+		for (const auto &r : ph.getRates()[s])
+			exit[s] += (long double)r.second;
+		rate = std::max(rate, exit[s]);
+	}
+	probs.resize(n);
+	stay.resize(n, 1);
+	for (size_t s = 0; s < n && rate > 0; s++) {
+		stay[s] = 1 - exit[s] / rate;
+		for (const auto &r : ph.getRates()[s])
+			probs[s].emplace_back(r.first, (long double)r.second / rate);
+	}
+	dist.resize(n, 0);
+	if (!ph.isFailedInitially())
+		dist[ph.getInitial()] = 1;
+}
+
+void DFT::PhaseTypeTransient::advance(long double time)
+{
+	if (rate == 0 || time <= 0 || getFailed() == 1)
+		return;
+	/* Split into parts short enough for the Poisson probabilities not
+	 * to underflow.
+	 */
+	long double total = rate * time;
+	size_t parts = (size_t)std::ceil(total / 64);
+	long double lambda = total / parts;
+	std::vector<long double> term, next, result;
+	for (size_t part = 0; part < parts; part++) {
+		long double weight = std::exp(-lambda);
+		long double sum = weight;
+		term = dist;
+		result.assign(dist.size(), 0);
+		for (size_t s = 0; s < dist.size(); s++)
+			result[s] = weight * term[s];
+		for (size_t k = 1; 1 - sum > 1e-19L || k <= lambda; k++) {
+			next.assign(term.size(), 0);
+			for (size_t s = 0; s < term.size(); s++) {
+				if (term[s] == 0)
+					continue;
+				next[s] += term[s] * stay[s];
+				for (const auto &p : probs[s])
+					next[p.first] += term[s] * p.second;
+			}
+			term.swap(next);
+			weight *= lambda / k;
+			sum += weight;
+			for (size_t s = 0; s < dist.size(); s++)
+				result[s] += weight * term[s];
+			if (weight == 0)
+				break;
+		}
+		dist.swap(result);
+	}
+}
+
+long double DFT::PhaseTypeTransient::getFailed() const
+{
+	long double alive = 0;
+	for (long double p : dist)
+		alive += p;
+	return std::max((long double)0, 1 - alive);
+}
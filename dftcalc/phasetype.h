@@ -0,0 +1,135 @@
+/*
+ * phasetype.h
+ *
+ * Part of dft2lnt library - a library containing read/write operations for DFT
+ * files in Galileo format and translating DFT specifications into Lotos NT.
+ *
+ * @author Enno Ruijters
+ */
+
+#ifndef DFTCALC_PHASETYPE_H
+#define DFTCALC_PHASETYPE_H
+
+#include <map>
+#include <vector>
+#include "FileSystem.h"
+#include "MessageFormatter.h"
+#include "decnumber.h"
+
+namespace DFT {
+
+/**
+ * The time until a module fails, as a phase-type distribution: the time
+ * until absorption of a CTMC whose transient states are the states in
+ * which the module has not failed, and whose absorbing state collects
+ * the states in which it has.
+ * The distribution is read from the CTMC of the module (in .tra/.lab
+ * format), and written as an automaton to be embedded as an APH basic
+ * event in the parent of the module.
+ */
+class PhaseType {
+private:
+	/// The rates from each transient state to the other transient states
+	std::vector<std::map<size_t, decnumber<>>> rates;
+	/// The rate from each transient state to the absorbing state
+	std::vector<decnumber<>> absorptionRates;
+	/// The initial transient state
+	size_t initial;
+	/// Whether the module has failed from the start
+	bool failedInitially;
+
+public:
+	PhaseType(): initial(0), failedInitially(false) {}
+
+	/**
+	 * Returns the distribution of a basic event failing after an
+	 * exponentially distributed time with the specified rate.
+	 */
+	static PhaseType exponential(const decnumber<> &rate);
+
+	/**
+	 * Reads the CTMC of a module from .tra and .lab files (as written
+	 * by bcg2tralab or DFTRES), with the failed states labelled
+	 * 'marked'. The initial state is state 1.
+	 * @return 0 if successful, non-zero if the files could not be read
+	 * 	or do not describe a phase-type distribution (e.g., because
+	 * 	the module can be repaired).
+	 */
+	int read(const File &tra, const File &lab, MessageFormatter *mf);
+
+	/**
+	 * Merges the transient states that are lumpable (i.e., have the
+	 * same rates to every class of merged states), which does not
+	 * change the distribution. Each round of refinement takes time
+	 * linear in the number of transitions, and at most one round is
+	 * needed per state.
+	 */
+	void minimize();
+
+	/**
+	 * Returns the number of transient states.
+	 */
+	size_t getStates() const { return rates.size(); }
+
+	const std::vector<std::map<size_t, decnumber<>>> &getRates() const { return rates; }
+	const std::vector<decnumber<>> &getAbsorptionRates() const { return absorptionRates; }
+	size_t getInitial() const { return initial; }
+	bool isFailedInitially() const { return failedInitially; }
+
+	/**
+	 * Returns the probability that the module eventually fails, which
+	 * is less than 1 if it can end up in a transient state without
+	 * outgoing transitions.
+	 */
+	long double getFailureProbability() const;
+
+	/**
+	 * Writes the distribution as an automaton for an APH basic event:
+	 * it fails (FAIL) after the time to absorption, whether or not it
+	 * is activated (ACTIVATE).
+	 * @return 0 if successful, non-zero otherwise
+	 */
+	int writeAUT(const File &aut, MessageFormatter *mf) const;
+};
+
+/**
+ * Transient analysis of a phase-type distribution by uniformization, to
+ * find the probability of having failed at increasing times.
+ */
+class PhaseTypeTransient {
+private:
+	/// The rates between transient states, divided by the uniformization rate
+	std::vector<std::vector<std::pair<size_t, long double>>> probs;
+	/// The probability of staying in each state per uniformization step
+	std::vector<long double> stay;
+	/// The uniformization rate (the largest exit rate)
+	long double rate;
+	/// The probability of being in each transient state
+	std::vector<long double> dist;
+
+public:
+	/**
+	 * Starts at time 0 in the initial state of the distribution.
+	 */
+	PhaseTypeTransient(const PhaseType &ph);
+
+	/**
+	 * Advances the time by the specified amount. Takes time linear
+	 * in the amount times the uniformization rate.
+	 */
+	void advance(long double time);
+
+	/**
+	 * Returns the probability of having failed at the current time.
+	 */
+	long double getFailed() const;
+
+	/**
+	 * Returns the uniformization rate.
+	 */
+	long double getRate() const { return rate; }
+};
+
+} // Namespace: DFT
+
+#endif
@@ -0,0 +1,251 @@
+/*
+ * resultcache.cpp
+ *
+ * Part of dft2lnt library - a library containing read/write operations for DFT
+ * files in Galileo format and translating DFT specifications into Lotos NT.
+ *
+ * @author Enno Ruijters
+ */
+
+#include "resultcache.h"
+
+#include "FileSystem.h"
+#include "System.h"
+#include "dft2lnt.h"
+#include "yaml-cpp/yaml.h"
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#ifndef WIN32
+# include <fcntl.h>
+# include <sys/file.h>
+# include <unistd.h>
+#endif
+
+/* 64-bit FNV-1a, chosen since the keys must be stable across builds and
+ * platforms (which std::hash does not guarantee).
+ */
+static uint64_t hashAppend(uint64_t hash, const std::string &data)
+{
+	for (unsigned char c : data) {
+		hash ^= c;
+		hash *= 0x100000001b3ULL;
+	}
+	/* Separator, so that ("ab", "c") and ("a", "bc") differ */
+	hash ^= 0xff;
+	hash *= 0x100000001b3ULL;
+	return hash;
+}
+
+static std::string toHex(uint64_t hash)
+{
+	std::stringstream ss;
+	ss << std::hex << std::setw(16) << std::setfill('0') << hash;
+	return ss.str();
+}
+
+/* Holds an exclusive lock on a cache file for as long as it exists, so
+ * concurrent runs do not overwrite each other's entries. The lock is
+ * taken on a separate file, since the cache file itself is replaced.
+ */
+class FileLock {
+private:
+#ifndef WIN32
+	int fd;
+#endif
+public:
+	FileLock(const std::string &file)
+	{
+#ifndef WIN32
+		fd = open((file + ".lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+		if (fd >= 0) {
+			while (flock(fd, LOCK_EX) && errno == EINTR)
+				;
+		}
+#endif
+	}
+
+	~FileLock()
+	{
+#ifndef WIN32
+		if (fd >= 0)
+			close(fd);
+#endif
+	}
+
+	FileLock(const FileLock &) = delete;
+	FileLock &operator=(const FileLock &) = delete;
+};
+
+std::string DFT::ResultCache::getDefaultRoot(MessageFormatter *mf)
+{
+	std::string root;
+#ifdef WIN32
+	const char *base = getenv("LOCALAPPDATA");
+	if (!base) {
+		mf->reportError("Unable to lookup Application Data directory");
+		return "";
+	}
+	root = base;
+#elif defined __APPLE__
+	root = getenv("HOME");
+	root += "/Library/Caches";
+#else
+	const char *home = getenv("HOME");
+	if (!home) {
+		mf->reportError("Environment variable `HOME' not set, cannot locate result cache");
+		return "";
+	}
+	root = home;
+	root += "/.cache";
+#endif
+	std::string dirs[] = {root,
+	                      root + "/dftcalc",
+	                      root + "/dftcalc" + DFT2LNT::RESULT_CACHE_DIR};
+	for (std::string &dir : dirs) {
+		if (!FileSystem::isDir(File(dir)) && FileSystem::mkdir(File(dir))) {
+			mf->reportError("Could not create result cache directory (" + dir + ")");
+			return "";
+		}
+	}
+	return dirs[2];
+}
+
+std::string DFT::ResultCache::getModelKey(const std::string &expContents,
+                                          const std::vector<std::string> &settings)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	hash = hashAppend(hash, expContents);
+
+	/* The automata are referenced by (quoted) file name, and their
+	 * contents may change between versions of dft2lntc.
+	 */
+	size_t start = expContents.find('"');
+	while (start != std::string::npos) {
+		size_t end = expContents.find('"', start + 1);
+		if (end == std::string::npos)
+			break;
+		std::string name = expContents.substr(start + 1, end - start - 1);
+		std::string ext = FileSystem::getFileExtension(name);
+		if (ext == "aut" || ext == "bcg") {
+			std::string *contents = FileSystem::load(File(name));
+			if (contents) {
+				hash = hashAppend(hash, *contents);
+				delete contents;
+			}
+		}
+		start = expContents.find('"', end + 1);
+	}
+
+	for (const std::string &setting : settings)
+		hash = hashAppend(hash, setting);
+	return toHex(hash);
+}
+
+std::string DFT::ResultCache::getQueryKey(const Query &q)
+{
+	std::stringstream ss;
+	ss << q.type << (q.min ? " min " : " max ");
+	ss << q.lowerBound.str() << ' ' << q.upperBound.str();
+	if (q.errorBoundSet)
+		ss << " eb " << q.errorBound.str();
+	if (q.type == CUSTOM)
+		ss << ' ' << q.customQuery;
+	return ss.str();
+}
+
+std::string DFT::ResultCache::getFileName(const std::string &model) const
+{
+	return root + "/" + model + ".yaml";
+}
+
+std::vector<bool> DFT::ResultCache::lookup(const std::string &model,
+                                           const std::vector<Query> &queries,
+                                           std::vector<DFTCalculationResultItem> &results)
+{
+	std::vector<bool> found(queries.size(), false);
+	results.resize(queries.size());
+
+	std::lock_guard<std::mutex> guard(lock);
+	File file(getFileName(model));
+	if (!FileSystem::exists(file))
+		return found;
+	YAML::Node entries;
+	try {
+		entries = YAML::LoadFile(file.getFileRealPath());
+	} catch (YAML::Exception &e) {
+		messageFormatter->reportWarning("Ignoring unreadable result cache file `" + file.getFileRealPath() + "'");
+		return found;
+	}
+	for (size_t i = 0; i < queries.size(); i++) {
+		const YAML::Node entry = entries[getQueryKey(queries[i])];
+		if (!entry)
+			continue;
+		try {
+			DFTCalculationResultItem it(queries[i]);
+			it.lowerBound = decnumber<>(entry["lowerBound"].as<std::string>());
+			it.upperBound = decnumber<>(entry["upperBound"].as<std::string>());
+			it.exactBounds = entry["exactBounds"].as<bool>();
+			if (entry["exactString"])
+				it.exactString = entry["exactString"].as<std::string>();
+			results[i] = it;
+			found[i] = true;
+		} catch (std::exception &e) {
+			messageFormatter->reportWarning("Ignoring malformed entry in result cache file `" + file.getFileRealPath() + "'");
+		}
+	}
+	return found;
+}
+
+void DFT::ResultCache::store(const std::string &model,
+                             const std::vector<DFTCalculationResultItem> &results)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	File file(getFileName(model));
+	/* Without a lock, the entries written by another run between
+	 * loading and replacing the file would be lost. Failing to take
+	 * the lock only risks losing entries, so it is not an error.
+	 */
+	FileLock fileLock(file.getFilePath());
+	YAML::Node entries;
+	if (FileSystem::exists(file)) {
+		try {
+			entries = YAML::LoadFile(file.getFileRealPath());
+		} catch (YAML::Exception &e) {
+			entries = YAML::Node();
+		}
+	}
+	for (const DFTCalculationResultItem &it : results) {
+		YAML::Node entry;
+		entry["lowerBound"] = it.lowerBound.str();
+		entry["upperBound"] = it.upperBound.str();
+		entry["exactBounds"] = it.exactBounds;
+		if (!it.exactString.empty())
+			entry["exactString"] = it.exactString;
+		entries[getQueryKey(it.query)] = entry;
+	}
+
+	/* Write to a temporary file first, so that concurrent runs never
+	 * see a partially written cache file.
+	 */
+	std::string uuid;
+	System::generateUUID(8, uuid);
+	File tmp(file.getFilePath() + "." + uuid + ".tmp");
+	{
+		std::ofstream out(tmp.getFilePath());
+		out << entries << std::endl;
+		if (!out.good()) {
+			messageFormatter->reportWarning("Could not write result cache file `" + tmp.getFilePath() + "'");
+			out.close();
+			FileSystem::remove(tmp);
+			return;
+		}
+	}
+	if (FileSystem::move(tmp, file)) {
+		messageFormatter->reportWarning("Could not write result cache file `" + file.getFilePath() + "'");
+		FileSystem::remove(tmp);
+	}
+}
@@ -0,0 +1,86 @@
+/*
+ * resultcache.h
+ *
+ * Part of dft2lnt library - a library containing read/write operations for DFT
+ * files in Galileo format and translating DFT specifications into Lotos NT.
+ *
+ * @author Enno Ruijters
+ */
+
+#ifndef DFTCALC_RESULTCACHE_H
+#define DFTCALC_RESULTCACHE_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include "MessageFormatter.h"
+#include "DFTCalculationResult.h"
+#include "query.h"
+
+namespace DFT {
+
+/**
+ * On-disk cache of checker results that persists across runs.
+ * Results are stored per (single) query, in one file per model. A model is
+ * identified by a hash over the EXP contents, the automata it refers to,
+ * and the tools and settings used to analyse it (see getModelKey()).
+ */
+class ResultCache {
+private:
+	MessageFormatter *messageFormatter;
+	std::string root;
+	std::mutex lock;
+
+	std::string getFileName(const std::string &model) const;
+public:
+	ResultCache(MessageFormatter *mf, const std::string &root)
+		:messageFormatter(mf), root(root)
+	{}
+
+	/**
+	 * Returns the default location of the result cache, creating it
+	 * if necessary.
+	 * @return The cache directory, or empty on error.
+	 */
+	static std::string getDefaultRoot(MessageFormatter *mf);
+
+	/**
+	 * Computes the key of a model to be analysed.
+	 * @param expContents The contents of the EXP file of the model.
+	 * 	The automata referenced from it are hashed as well.
+	 * @param settings Additional settings influencing the result
+	 * 	(e.g., checker, converter, tool versions).
+	 * @return The key identifying the model in the cache.
+	 */
+	static std::string getModelKey(const std::string &expContents,
+	                               const std::vector<std::string> &settings);
+
+	/**
+	 * Computes the key identifying a single (non-range) query.
+	 */
+	static std::string getQueryKey(const Query &q);
+
+	/**
+	 * Looks up the results of the specified queries for a model.
+	 * @param model The key of the model, from getModelKey().
+	 * @param queries The queries to look up, ranges already expanded.
+	 * @param results Will be resized to the number of queries, with
+	 * 	each found result at the index of its query.
+	 * @return For each query, whether its result was found.
+	 */
+	std::vector<bool> lookup(const std::string &model,
+	                         const std::vector<Query> &queries,
+	                         std::vector<DFTCalculationResultItem> &results);
+
+	/**
+	 * Adds the specified results for a model to the cache.
+	 * @param model The key of the model, from getModelKey().
+	 * @param results The results to store, each carrying its query.
+	 */
+	void store(const std::string &model,
+	           const std::vector<DFTCalculationResultItem> &results);
+};
+
+} // Namespace: DFT
+
+#endif
@@ -0,0 +1,321 @@
+/*
+ * service.cpp
+ *
+ * Part of dft2lnt library - a library containing read/write operations for DFT
+ * files in Galileo format and translating DFT specifications into Lotos NT.
+ *
+ * @author Enno Ruijters
+ */
+
+#include "service.h"
+
+#include "FileSystem.h"
+#include <fstream>
+#include <string.h>
+#include <errno.h>
+
+#ifndef WIN32
+# include <sys/socket.h>
+# include <sys/un.h>
+# include <unistd.h>
+#endif
+
+int DFT::DFTService::parseChecker(const std::string &name,
+                                  enum DFT::checker &ret)
+{
+	if (name == "storm")
+		ret = STORM;
+	else if (name == "modest")
+		ret = MODEST;
+	else if (name == "mrmc")
+		ret = MRMC;
+	else if (name == "imrmc")
+		ret = IMRMC;
+	else if (name == "imca")
+		ret = IMCA;
+	else
+		return 1;
+	return 0;
+}
+
+int DFT::DFTService::parseQueries(const YAML::Node &node,
+                                  std::vector<Query> &queries,
+                                  std::string &error)
+{
+	if (!node) {
+		Query q = defaultQuery;
+		q.type = TIMEBOUND;
+		q.lowerBound = (uintmax_t)0;
+		q.upperBound = (uintmax_t)1;
+		q.step = (intmax_t)-1;
+		queries.push_back(q);
+		return 0;
+	}
+	if (!node.IsSequence()) {
+		error = "queries should be a list";
+		return 1;
+	}
+	for (const YAML::Node &qNode : node) {
+		Query q = defaultQuery;
+		std::string type = qNode["type"] ? qNode["type"].as<std::string>() : "timebound";
+		if (qNode["min"])
+			q.min = qNode["min"].as<bool>();
+		if (qNode["errorBound"]) {
+			q.errorBound = decnumber<>(qNode["errorBound"].as<std::string>());
+			q.errorBoundSet = true;
+		}
+		q.step = (intmax_t)-1;
+		if (type == "timebound") {
+			q.type = TIMEBOUND;
+			q.lowerBound = (uintmax_t)0;
+			q.upperBound = qNode["time"] ? qNode["time"].as<std::string>() : "1";
+		} else if (type == "interval") {
+			if (!qNode["lower"] || !qNode["upper"]) {
+				error = "interval query without lower or upper bound";
+				return 1;
+			}
+			q.type = TIMEBOUND;
+			q.lowerBound = qNode["lower"].as<std::string>();
+			q.upperBound = qNode["upper"].as<std::string>();
+		} else if (type == "unbounded") {
+			q.type = UNBOUNDED;
+		} else if (type == "steady") {
+			q.type = STEADY;
+		} else if (type == "mttf") {
+			q.type = EXPECTEDTIME;
+		} else if (type == "custom") {
+			if (!qNode["formula"]) {
+				error = "custom query without formula";
+				return 1;
+			}
+			q.type = CUSTOM;
+			q.customQuery = qNode["formula"].as<std::string>();
+		} else {
+			error = "unknown query type: " + type;
+			return 1;
+		}
+		queries.push_back(q);
+	}
+	return 0;
+}
+
+static std::string errorResponse(const YAML::Node &id, const std::string &error)
+{
+	YAML::Emitter out;
+	out.SetMapFormat(YAML::Flow);
+	out.SetSeqFormat(YAML::Flow);
+	out.SetStringFormat(YAML::DoubleQuoted);
+	out << YAML::BeginMap;
+	if (id)
+		out << YAML::Key << "id" << YAML::Value << id;
+	out << YAML::Key << "status" << YAML::Value << "error";
+	out << YAML::Key << "message" << YAML::Value << error;
+	out << YAML::EndMap;
+	return out.c_str();
+}
+
+std::string DFT::DFTService::handleRequest(const std::string &request)
+{
+	YAML::Node req;
+	try {
+		req = YAML::Load(request);
+	} catch (YAML::Exception &e) {
+		return errorResponse(YAML::Node(), std::string("malformed request: ") + e.what());
+	}
+	/* Subscripting a scalar or sequence throws, so anything that is
+	 * not a map is rejected before looking at its fields.
+	 */
+	if (!req.IsMap())
+		return errorResponse(YAML::Node(), "request is not a map");
+	YAML::Node id = req["id"];
+	if (!req["dft"])
+		return errorResponse(id, "request without dft");
+
+	std::vector<Query> queries;
+	enum DFT::checker useChecker = defaultChecker;
+	bool exactMode = false;
+	bool modular = false;
+	std::vector<std::string> evidence = defaultEvidence;
+	std::string dftText;
+	try {
+		std::string error;
+		dftText = req["dft"].as<std::string>();
+		if (parseQueries(req["queries"], queries, error))
+			return errorResponse(id, error);
+		if (req["checker"] && parseChecker(req["checker"].as<std::string>(), useChecker))
+			return errorResponse(id, "unknown checker: " + req["checker"].as<std::string>());
+		if (req["exact"])
+			exactMode = req["exact"].as<bool>();
+		if (req["modular"])
+			modular = req["modular"].as<bool>();
+		if (req["evidence"])
+			evidence = req["evidence"].as<std::vector<std::string>>();
+	} catch (YAML::Exception &e) {
+		return errorResponse(id, std::string("malformed request: ") + e.what());
+	}
+
+#ifdef HAVE_CADP
+	enum DFT::converter useConverter = DFT::converter::SVL;
+#else
+	enum DFT::converter useConverter = DFT::converter::DFTRES;
+#endif
+	if (exactMode) {
+		useConverter = DFT::converter::DFTRES;
+		if (useChecker != IMRMC && useChecker != MODEST && useChecker != STORM)
+			useChecker = IMRMC;
+	}
+
+	unsigned int errors = messageFormatter->getErrors();
+	std::pair<int, int> tools((int)useChecker, (int)useConverter);
+	if (!checkedTools.count(tools)) {
+		if (calc.checkNeededTools(useChecker, useConverter))
+			return errorResponse(id, "required tools not found");
+		checkedTools.insert(tools);
+	}
+
+	/* Requests are handled one at a time, so they can all share the
+	 * same files. The input is kept apart from the working directory,
+	 * since the working directory gets its own copy of the DFT.
+	 */
+	File dft(workDir, "request", "dft");
+	std::string cwd = workDir + "/work";
+	FileSystem::mkdir(File(workDir));
+	{
+		std::ofstream out(dft.getFilePath());
+		out << dftText;
+		if (!out.good())
+			return errorResponse(id, "could not write " + dft.getFilePath());
+	}
+
+	calc.setEvidence(evidence);
+	DFT::DFTCalculationResult ret;
+	int res;
+	try {
+		res = calc.calculate(true, cwd, dft, queries, useChecker,
+		                     useConverter, true, ret, false, exactMode,
+		                     modular);
+	} catch (std::exception &e) {
+		messageFormatter->reportError(e.what());
+		res = 1;
+	}
+	calc.setEvidence(defaultEvidence);
+	if (res || messageFormatter->getErrors() > errors)
+		return errorResponse(id, "calculation failed");
+
+	YAML::Emitter out;
+	out.SetMapFormat(YAML::Flow);
+	out.SetSeqFormat(YAML::Flow);
+	out.SetStringFormat(YAML::DoubleQuoted);
+	out << YAML::BeginMap;
+	if (id)
+		out << YAML::Key << "id" << YAML::Value << id;
+	out << YAML::Key << "status" << YAML::Value << "ok";
+	out << YAML::Key << "results" << YAML::Value << YAML::BeginSeq;
+	for (const DFT::DFTCalculationResultItem &it : ret.failProbs) {
+		out << YAML::BeginMap;
+		out << YAML::Key << "query" << YAML::Value << it.mrmcCommand;
+		out << YAML::Key << "missionTime" << YAML::Value << it.missionTime;
+		out << YAML::Key << "value" << YAML::Value << it.valStr();
+		out << YAML::Key << "lowerBound" << YAML::Value << it.lowerBound.str();
+		out << YAML::Key << "upperBound" << YAML::Value << it.upperBound.str();
+		out << YAML::EndMap;
+	}
+	out << YAML::EndSeq;
+	out << YAML::EndMap;
+	return out.c_str();
+}
+
+int DFT::DFTService::serve(std::istream &in, std::ostream &out)
+{
+	std::string line;
+	messageFormatter->notify("Waiting for requests");
+	while (std::getline(in, line)) {
+		if (line.find_first_not_of(" \t\r") == std::string::npos)
+			continue;
+		out << handleRequest(line) << std::endl;
+	}
+	return 0;
+}
+
+#ifndef WIN32
+static bool writeAll(int fd, const std::string &data)
+{
+	size_t done = 0;
+	while (done < data.length()) {
+		ssize_t n = write(fd, data.c_str() + done, data.length() - done);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		done += n;
+	}
+	return true;
+}
+
+int DFT::DFTService::serveSocket(const std::string &path)
+{
+	struct sockaddr_un addr;
+	if (path.length() >= sizeof(addr.sun_path)) {
+		messageFormatter->reportError("Socket path too long: " + path);
+		return 1;
+	}
+	int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock < 0) {
+		messageFormatter->reportError(std::string("Could not create socket: ") + strerror(errno));
+		return 1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path.c_str());
+	unlink(path.c_str());
+	if (bind(sock, (struct sockaddr *)&addr, sizeof(addr))
+	    || listen(sock, 16))
+	{
+		messageFormatter->reportError("Could not listen on " + path + ": " + strerror(errno));
+		close(sock);
+		return 1;
+	}
+	messageFormatter->notify("Waiting for requests on " + path);
+	while (true) {
+		int conn = accept(sock, NULL, NULL);
+		if (conn < 0) {
+			if (errno == EINTR)
+				continue;
+			messageFormatter->reportError(std::string("Could not accept connection: ") + strerror(errno));
+			break;
+		}
+		std::string buffer;
+		char chunk[4096];
+		bool open = true;
+		while (open) {
+			ssize_t n = read(conn, chunk, sizeof(chunk));
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0)
+				break;
+			buffer.append(chunk, n);
+			size_t eol;
+			while ((eol = buffer.find('\n')) != std::string::npos) {
+				std::string line = buffer.substr(0, eol);
+				buffer.erase(0, eol + 1);
+				if (line.find_first_not_of(" \t\r") == std::string::npos)
+					continue;
+				if (!writeAll(conn, handleRequest(line) + "\n")) {
+					open = false;
+					break;
+				}
+			}
+		}
+		close(conn);
+	}
+	close(sock);
+	unlink(path.c_str());
+	return 1;
+}
+#else
+int DFT::DFTService::serveSocket(const std::string &path)
+{
+	messageFormatter->reportError("Serving on a socket is not supported on Windows, use --serve without socket.");
+	return 1;
+}
+#endif
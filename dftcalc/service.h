@@ -0,0 +1,97 @@
+/*
+ * service.h
+ *
+ * Part of dft2lnt library - a library containing read/write operations for DFT
+ * files in Galileo format and translating DFT specifications into Lotos NT.
+ *
+ * @author Enno Ruijters
+ */
+
+#ifndef DFTCALC_SERVICE_H
+#define DFTCALC_SERVICE_H
+
+#include <string>
+#include <vector>
+#include <set>
+#include <iostream>
+#include "MessageFormatter.h"
+#include "dftcalc.h"
+#include "yaml-cpp/yaml.h"
+
+namespace DFT {
+
+/**
+ * Resident mode of dftcalc: reads requests, one JSON object per line, and
+ * writes one JSON object per line with the results of each request. Since
+ * the same DFTCalc is used for all requests, the tools only need to be
+ * located once and cached results are kept between requests.
+ *
+ * A request looks like:
+ *   {"id": 1, "dft": "toplevel \"A\"; ...", "checker": "storm",
+ *    "exact": false, "modular": false, "evidence": ["B"],
+ *    "queries": [{"type": "timebound", "time": "10"}]}
+ * where only "dft" is required. Query types are timebound (with "time"),
+ * interval (with "lower" and "upper"), unbounded, steady, mttf and custom
+ * (with "formula"), each optionally with "min" and "errorBound".
+ */
+class DFTService {
+private:
+	MessageFormatter *messageFormatter;
+	DFTCalc &calc;
+	std::string workDir;
+	Query defaultQuery;
+	enum DFT::checker defaultChecker;
+	std::vector<std::string> defaultEvidence;
+	std::set<std::pair<int, int>> checkedTools;
+
+	int parseQueries(const YAML::Node &node, std::vector<Query> &queries,
+	                 std::string &error);
+	int parseChecker(const std::string &name, enum DFT::checker &ret);
+public:
+	/**
+	 * Creates a service running its calculations in the specified
+	 * working directory.
+	 * @param defaultQuery Query settings (e.g., error bound, min/max)
+	 * 	used unless overridden in the request.
+	 * @param defaultChecker The checker to use unless overridden.
+	 */
+	DFTService(MessageFormatter *mf, DFTCalc &calc,
+	           const std::string &workDir, const Query &defaultQuery,
+	           enum DFT::checker defaultChecker)
+		:messageFormatter(mf), calc(calc), workDir(workDir),
+		 defaultQuery(defaultQuery), defaultChecker(defaultChecker),
+		 defaultEvidence(calc.getEvidence())
+	{}
+
+	/**
+	 * Marks the tools for the specified checker and converter as
+	 * already located, so they are not looked up again.
+	 */
+	void setToolsChecked(enum DFT::checker checker, enum DFT::converter conv) {
+		checkedTools.insert(std::make_pair((int)checker, (int)conv));
+	}
+
+	/**
+	 * Handles a single request.
+	 * @param request The request, a JSON object.
+	 * @return The response, a JSON object on a single line.
+	 */
+	std::string handleRequest(const std::string &request);
+
+	/**
+	 * Handles requests from the input stream until it is closed.
+	 * @return 0 if successful, non-zero otherwise
+	 */
+	int serve(std::istream &in, std::ostream &out);
+
+	/**
+	 * Listens on the specified Unix domain socket, handling the requests
+	 * of one connection at a time.
+	 * @return 0 if successful, non-zero otherwise
+	 */
+	int serveSocket(const std::string &path);
+};
+
+} // Namespace: DFT
+
+#endif
@@ -77,16 +77,23 @@ static std::string getQuery(Query q)
 	return ret;
 }
 
-static int readOutputFile(File file, DFT::DFTCalculationResultItem &it) {
-	if(!FileSystem::exists(file))
-		return -1;
-
-	std::ifstream input(file.getFileRealPath());
+/* Reads the results of the properties in the order they were given,
+ * setting the lower bound (or exact string) of each item. For each item,
+ * the result is 0 for a number, 1 for an exact fraction, or -1 if
+ * missing.
+ */
+static void readOutput(std::istream &input,
+                       std::vector<DFT::DFTCalculationResultItem *> &items,
+                       std::vector<int> &results)
+{
+	results.assign(items.size(), -1);
+	size_t i = 0;
 	std::string line;
 	std::getline(input, line);
-	while (input.good()) {
+	while (input.good() && i < items.size()) {
 		if (line.find(needle) != std::string::npos) {
-			line.erase(0, strlen(needle));
+			DFT::DFTCalculationResultItem &it = *items[i];
+			line.erase(0, line.find(needle) + strlen(needle));
 			size_t appr = line.find(" (approx.");
 			if (appr != std::string::npos) {
 				it.exactBounds = 1;
@@ -96,14 +103,35 @@ static int readOutputFile(File file, DFT::DFTCalculationResultItem &it) {
 			}
 			if (line.find('/') != std::string::npos) {
 				it.exactString = line;
-				return 1;
+				results[i] = 1;
+			} else {
+				it.lowerBound = decnumber<>(line);
+				results[i] = 0;
 			}
-			it.lowerBound = decnumber<>(line);
-			return 0;
+			i++;
 		}
 		std::getline(input, line);
 	}
-	return -1;
+}
+
+static void addMargin(const Query &q, DFT::DFTCalculationResultItem &it)
+{
+	decnumber<> margin = q.errorBound;
+	if (q.errorBoundSet)
+		margin *= 0.5;
+	else /* MRMC default error bound 1e-6 */
+		margin = decnumber<>("1e-6") * 0.5;
+	it.upperBound = it.lowerBound + margin;
+	it.lowerBound = it.lowerBound - margin;
+	if (it.upperBound > decnumber<>(1)
+		&& (q.type == TIMEBOUND
+			|| q.type == STEADY
+			|| q.type == UNBOUNDED))
+	{
+		it.upperBound = (intmax_t)1;
+	}
+	if (it.lowerBound < decnumber<>(0) && q.type != CUSTOM)
+		it.lowerBound = (intmax_t)0;
 }
 
 std::vector<DFT::DFTCalculationResultItem> StormRunner::analyze(std::vector<Query> queries)
@@ -111,50 +139,75 @@ std::vector<DFT::DFTCalculationResultItem> StormRunner::analyze(std::vector<Quer
 	std::vector<DFT::DFTCalculationResultItem> ret;
 	expandRangeQueries(queries);
 	messageFormatter->reportAction("Calculating probability with " + stormExec.getFileName(), DFT::VERBOSITY_FLOW);
-	for (Query q : queries) {
-		std::vector<std::string> arguments;
-		getCommandOptions(q, arguments);
-		arguments.push_back("--prop");
-		arguments.push_back(getQuery(q));
-		arguments.push_back("--jani");
-		arguments.push_back(janiFile.getFileRealPath());
-		DFT::DFTCalculationResultItem it(q);
-		int result;
-		std::string of;
+
+	/* Queries needing the same options are checked in a single run of
+	 * Storm, so that the model is only built once per group. The
+	 * groups themselves are independent and may run concurrently.
+	 */
+	std::vector<std::pair<std::vector<std::string>, std::vector<size_t>>> groups;
+	std::vector<DFT::DFTCalculationResultItem> results;
+	std::vector<char> done(queries.size(), false);
+	for (size_t i = 0; i < queries.size(); i++) {
+		const Query &q = queries[i];
+		results.push_back(DFT::DFTCalculationResultItem(q));
 		if (q.type == TIMEBOUND && q.upperBound == 0) {
 			/* Special case since Storm fails to compute otherwise. */
-			result = 0;
-		} else {
-			of = exec->runCommand(stormExec.getFilePath(), arguments, stormExec.getFileName());
-			if (of == "") {
-				messageFormatter->reportError("Could not calculate.");
-				return ret;
-			}
-			result = readOutputFile(of, it);
+			results[i].exactBounds = 1;
+			results[i].lowerBound = results[i].upperBound = (uintmax_t)0;
+			done[i] = true;
+			continue;
 		}
-		if (result == -1) {
+		std::vector<std::string> options;
+		getCommandOptions(q, options);
+		size_t g = 0;
+		while (g < groups.size() && groups[g].first != options)
+			g++;
+		if (g == groups.size())
+			groups.push_back(std::make_pair(options, std::vector<size_t>()));
+		groups[g].second.push_back(i);
+	}
+
+	runConcurrently(groups.size(), [&](size_t g) {
+		auto &group = groups[g];
+		std::vector<std::string> arguments = group.first;
+		std::string props;
+		std::vector<DFT::DFTCalculationResultItem *> items;
+		for (size_t i : group.second) {
+			if (!props.empty())
+				props += "; ";
+			props += getQuery(queries[i]);
+			items.push_back(&results[i]);
+		}
+		arguments.push_back("--prop");
+		arguments.push_back(props);
+		arguments.push_back("--jani");
+		arguments.push_back(janiFile.getFileRealPath());
+		DFT::CommandOutput output;
+		if (exec->runCommand(stormExec.getFilePath(), arguments,
+		                     stormExec.getFileName(), output))
+		{
 			messageFormatter->reportError("Could not calculate.");
-			return ret;
+			return 1;
 		}
-		if (result == 0 && !it.exactBounds) {
-			decnumber<> margin = q.errorBound;
-			if (q.errorBoundSet)
-				margin *= 0.5;
-			else /* MRMC default error bound 1e-6 */
-				margin = decnumber<>("1e-6") * 0.5;
-			it.upperBound = it.lowerBound + margin;
-			it.lowerBound = it.lowerBound - margin;
-			if (it.upperBound > decnumber<>(1)
-				&& (q.type == TIMEBOUND
-					|| q.type == STEADY
-					|| q.type == UNBOUNDED))
-			{
-				it.upperBound = (intmax_t)1;
+		std::vector<int> codes;
+		readOutput(*output.openOutput(), items, codes);
+		for (size_t j = 0; j < codes.size(); j++) {
+			size_t i = group.second[j];
+			if (codes[j] == -1) {
+				messageFormatter->reportError("Could not calculate.");
+				return 1;
 			}
-			if (it.lowerBound < decnumber<>(0) && q.type != CUSTOM)
-				it.lowerBound = (intmax_t)0;
+			if (codes[j] == 0 && !results[i].exactBounds)
+				addMargin(queries[i], results[i]);
+			done[i] = true;
 		}
-		ret.push_back(it);
-	}
+		return 0;
+	});
+
+	/* On failure, only the results up to the first missing one are
+	 * returned.
+	 */
+	for (size_t i = 0; i < results.size() && done[i]; i++)
+		ret.push_back(results[i]);
 	return ret;
 }
@@ -0,0 +1,44 @@
+#!/bin/sh
+
+# Checks that the fast parser produces the same AST (including the
+# locations of all nodes) as the generated parser, for every DFT in this
+# directory and for a generated DFT large enough to be parsed in parallel.
+
+TMP=$(mktemp -d);
+trap 'rm -rf "$TMP"' EXIT;
+
+awk 'BEGIN {
+	print "toplevel \"G0\";";
+	for (i = 0; i < 100000; i++) {
+		printf "\"G%d\" or \"B%d\" \"G%d\";\n", i, i, i + 1;
+		printf "\"B%d\" lambda=%g dorm=0.5;\n", i, 0.001 * (i % 97 + 1);
+		if (i % 25000 == 0)
+			printf "/* comment\n   over several lines */\n";
+	}
+	print "\"G100000\" prob=0.5;";
+}' > "$TMP/large.dft";
+
+TESTS_FAILED=0
+TESTS_TOTAL=0
+
+for FILE in *.dft "$TMP/large.dft"; do
+	TESTS_TOTAL=$(( $TESTS_TOTAL + 1 ));
+	dft2lntc -q -o "$TMP/out" -a "$TMP/fast.ast" "$FILE" 2>/dev/null;
+	dft2lntc -q -o "$TMP/out" -a "$TMP/generated.ast" --no-fast-parser "$FILE" 2>/dev/null;
+	if [ -s "$TMP/generated.ast" ] && cmp -s "$TMP/fast.ast" "$TMP/generated.ast"; then
+		echo "PASS: $FILE";
+	else
+		echo "FAIL: $FILE, the ASTs differ";
+		TESTS_FAILED=$(( $TESTS_FAILED + 1 ));
+	fi
+	rm -f "$TMP/fast.ast" "$TMP/generated.ast";
+done
+
+printf "\n";
+if [ "$TESTS_FAILED" = "0" ]; then
+	echo "$TESTS_TOTAL tests executed, all passed";
+	exit 0;
+else
+	echo "$TESTS_TOTAL tests executed, $TESTS_FAILED failed";
+	exit 1;
+fi